@@ -0,0 +1,512 @@
+/*
+	Throughput and acquire latency microbenchmark for the *NIX synchronization primitives.
+	This source file is under the MIT license.
+	(C) 2016 CubicleSoft.  All rights reserved.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "php.h"
+
+/* Unnamed objects normally come from the PHP heap.  There is no PHP here. */
+#undef ecalloc
+#undef efree
+#define ecalloc(Num, Size)   calloc((Num), (Size))
+#define efree(Ptr)   free(Ptr)
+
+/* Build the primitives straight from the extension.  The linker drops the PHP glue (see Makefile). */
+#include "../sync.c"
+
+#include <getopt.h>
+#include <sys/wait.h>
+
+#define BENCH_MUTEX       0
+#define BENCH_SEMAPHORE   1
+#define BENCH_EVENT       2
+#define BENCH_RWLOCK      3
+#define BENCH_OPEN        4
+
+static const char *bench_TypeNames[5] = { "mutex", "semaphore", "event", "rwlock", "open" };
+
+typedef struct _bench_Options {
+	int MxType;
+	const char *MxName;
+	int MxFork;
+	int MxFair;
+	uint32_t MxWorkers;
+	uint32_t MxSpinLimit;
+	uint32_t MxUnits;
+	uint32_t MxReadPercent;
+	uint32_t MxReaderSlots;
+	double MxDuration;
+	uint64_t MxCritical;
+	uint64_t MxOutside;
+} bench_Options;
+
+/* Shared by every worker.  Lives in anonymous shared memory so forked workers see it too. */
+typedef struct _bench_Shared {
+	volatile uint32_t MxStart;
+	volatile uint32_t MxStop;
+	char MxPad[SYNC_UNIX_CACHE_LINE_SIZE - sizeof(uint32_t) * 2];
+
+	/* Round barrier for cold starts. */
+	volatile uint32_t MxArrived;
+	volatile uint32_t MxGeneration;
+	volatile uint32_t MxRoundStop;
+	char MxPad2[SYNC_UNIX_CACHE_LINE_SIZE - sizeof(uint32_t) * 3];
+
+	/* Only touched while holding an exclusive lock.  Checks mutual exclusion at the end. */
+	volatile uint64_t MxCounter;
+} bench_Shared;
+
+typedef struct _bench_Result {
+	uint64_t MxReads;
+	uint64_t MxWrites;
+	sync_UnixHistogram MxLatency;
+} bench_Result;
+
+static bench_Options bench_Opts;
+static char *bench_Mem;
+static size_t bench_Pos;
+static bench_Shared *bench_SharedMem;
+static bench_Result *bench_Results;
+
+static void bench_Usage(const char *Prog)
+{
+	fprintf(stderr, "Usage:  %s [options]\n\n", Prog);
+	fprintf(stderr, "  -p type     mutex (default), semaphore, event, rwlock, or open (cold start)\n");
+	fprintf(stderr, "  -w num      Number of workers (default 4)\n");
+	fprintf(stderr, "  -f          Fork worker processes instead of starting threads\n");
+	fprintf(stderr, "  -n name     Use a named object (default unnamed, or 'bench' with -f)\n");
+	fprintf(stderr, "  -d secs     How long to run (default 2)\n");
+	fprintf(stderr, "  -c ns       Critical section length (default 0)\n");
+	fprintf(stderr, "  -o ns       Work between locks (default 0)\n");
+	fprintf(stderr, "  -r pct      Percentage of rwlock operations that are reads (default 90)\n");
+	fprintf(stderr, "  -s slots    Reader slots for rwlock big-reader mode (default 0)\n");
+	fprintf(stderr, "  -u units    Semaphore units (default 2)\n");
+	fprintf(stderr, "  -F          Fair mode (FIFO handoff) for mutex and semaphore\n");
+	fprintf(stderr, "  -l spins    Spin limit (default 100, same as sync.spin_limit)\n");
+}
+
+/* Burns CPU until the monotonic clock reaches a time. */
+static inline void bench_BusyWait(uint64_t Until)
+{
+	while (sync_GetMonotonicTime() < Until)  sync_UnixCpuRelax();
+}
+
+/* Waits until every worker gets here. */
+static void bench_Barrier(void)
+{
+	uint32_t Generation = __atomic_load_n(&bench_SharedMem->MxGeneration, __ATOMIC_ACQUIRE);
+
+	if (__atomic_add_fetch(&bench_SharedMem->MxArrived, 1, __ATOMIC_ACQ_REL) == bench_Opts.MxWorkers)
+	{
+		__atomic_store_n(&bench_SharedMem->MxArrived, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&bench_SharedMem->MxGeneration, Generation + 1, __ATOMIC_RELEASE);
+	}
+	else
+	{
+		while (__atomic_load_n(&bench_SharedMem->MxGeneration, __ATOMIC_ACQUIRE) == Generation)  sched_yield();
+	}
+}
+
+/* Cold start.  Each round, every worker opens the same brand new named semaphore at once, the way a pool of freshly started PHP workers does. */
+/* One worker creates it and the rest wait for it to become ready.  Measures the whole constructor path. */
+static void bench_RunOpen(uint32_t Num)
+{
+	bench_Result *Result = &bench_Results[Num];
+	size_t Size = sync_GetUnixSemaphoreSize(), Pos;
+	char Name[256], Name2[SHM_NAME_MAX];
+	char *Mem;
+	uint32_t Round;
+	uint64_t Start, Curr;
+	int Created;
+
+	while (!__atomic_load_n(&bench_SharedMem->MxStart, __ATOMIC_ACQUIRE))  sync_UnixCpuRelax();
+
+	for (Round = 0; ; Round++)
+	{
+		/* Worker 0 decides whether there is another round so that everyone agrees. */
+		if (!Num && __atomic_load_n(&bench_SharedMem->MxStop, __ATOMIC_RELAXED))  __atomic_store_n(&bench_SharedMem->MxRoundStop, 1, __ATOMIC_RELAXED);
+
+		bench_Barrier();
+
+		if (__atomic_load_n(&bench_SharedMem->MxRoundStop, __ATOMIC_RELAXED))  break;
+
+		snprintf(Name, sizeof(Name), "%s-open-%u", bench_Opts.MxName, Round);
+
+		Start = sync_GetMonotonicTime();
+
+		Created = sync_InitUnixNamedMem(&Mem, &Pos, "/Sync_Bench", Name, Size);
+		if (Created == 0)
+		{
+			sync_UnixSemaphoreWrapper Semaphore;
+
+			sync_GetUnixSemaphore(&Semaphore, Mem + Pos, 0);
+			sync_InitUnixSemaphore(&Semaphore, 1, 1, 1);
+
+			sync_UnixNamedMemReady(Mem);
+		}
+
+		Curr = sync_GetMonotonicTime();
+
+		if (Created < 0)
+		{
+			fprintf(stderr, "Unable to open '%s'.\n", Name);
+
+			__atomic_store_n(&bench_SharedMem->MxStop, 1, __ATOMIC_RELAXED);
+		}
+		else
+		{
+			Result->MxLatency.MxBuckets[sync_GetUnixHistogramBucket(Curr > Start ? Curr - Start : 0)]++;
+
+			/* Creates count as writes and opens of an existing object as reads. */
+			if (Created == 0)  Result->MxWrites++;
+			else  Result->MxReads++;
+		}
+
+		bench_Barrier();
+
+		/* Don't leave a trail of objects behind in /dev/shm. */
+		if (Created >= 0)  sync_UnmapUnixNamedMem(Mem, Size);
+
+		if (!Num)
+		{
+			sync_GetUnixNamedMemName(Name2, "/Sync_Bench", Name, sync_AlignUnixSize(sync_GetUnixNamedMemHeaderSize(1) + Size));
+			shm_unlink(Name2);
+		}
+	}
+}
+
+/* One worker.  Runs in a thread or a forked process. */
+static void bench_Run(uint32_t Num)
+{
+	bench_Result *Result = &bench_Results[Num];
+	sync_UnixSemaphoreWrapper Semaphore;
+	sync_UnixEventWrapper Event;
+	sync_UnixReaderWriterWrapper ReaderWriter;
+	uint64_t Rand = 0x9E3779B97F4A7C15ULL * (uint64_t)(Num + 1), Start, Curr;
+	int Exclusive;
+
+	if (bench_Opts.MxType == BENCH_OPEN)
+	{
+		bench_RunOpen(Num);
+
+		return;
+	}
+
+	/* Each worker gets its own wrapper (and spin state), just like each PHP object does.  Optional parts follow the object in the same memory here. */
+	if (bench_Opts.MxType == BENCH_RWLOCK)
+	{
+		sync_GetUnixReaderWriter(&ReaderWriter, bench_Mem + bench_Pos, bench_Opts.MxSpinLimit);
+		if (bench_Opts.MxReaderSlots)  sync_SetUnixReaderWriterSlots(&ReaderWriter, bench_Mem + bench_Pos + sync_GetUnixReaderWriterSize(), bench_Opts.MxReaderSlots);
+	}
+	else if (bench_Opts.MxType == BENCH_EVENT)  sync_GetUnixEvent(&Event, bench_Mem + bench_Pos, bench_Opts.MxSpinLimit);
+	else
+	{
+		sync_GetUnixSemaphore(&Semaphore, bench_Mem + bench_Pos, bench_Opts.MxSpinLimit);
+		if (bench_Opts.MxFair)  Semaphore.MxFair = sync_GetUnixFairQueue(bench_Mem + bench_Pos + sync_GetUnixSemaphoreSize());
+	}
+
+	while (!__atomic_load_n(&bench_SharedMem->MxStart, __ATOMIC_ACQUIRE))  sync_UnixCpuRelax();
+
+	while (!__atomic_load_n(&bench_SharedMem->MxStop, __ATOMIC_RELAXED))
+	{
+		/* xorshift64 picks reads and writes. */
+		Exclusive = 1;
+		if (bench_Opts.MxType == BENCH_RWLOCK)
+		{
+			Rand ^= Rand << 13;
+			Rand ^= Rand >> 7;
+			Rand ^= Rand << 17;
+
+			Exclusive = (Rand % 100 >= bench_Opts.MxReadPercent);
+		}
+
+		Start = sync_GetMonotonicTime();
+
+		if (bench_Opts.MxType == BENCH_RWLOCK)
+		{
+			if (Exclusive)  sync_WriteLockUnixReaderWriter(&ReaderWriter, SYNC_DEADLINE_INFINITE);
+			else  sync_ReadLockUnixReaderWriter(&ReaderWriter, SYNC_DEADLINE_INFINITE);
+		}
+		else if (bench_Opts.MxType == BENCH_EVENT)
+		{
+			/* A prefired auto-reset event lets exactly one waiter through at a time, so it works as a lock. */
+			sync_WaitForUnixEvent(&Event, SYNC_DEADLINE_INFINITE);
+		}
+		else
+		{
+			sync_WaitForUnixSemaphore(&Semaphore, SYNC_DEADLINE_INFINITE);
+		}
+
+		Curr = sync_GetMonotonicTime();
+		Result->MxLatency.MxBuckets[sync_GetUnixHistogramBucket(Curr > Start ? Curr - Start : 0)]++;
+
+		if (Exclusive)
+		{
+			bench_SharedMem->MxCounter++;
+			Result->MxWrites++;
+		}
+		else
+		{
+			Result->MxReads++;
+		}
+
+		if (bench_Opts.MxCritical)  bench_BusyWait(Curr + bench_Opts.MxCritical);
+
+		if (bench_Opts.MxType == BENCH_RWLOCK)
+		{
+			if (Exclusive)  sync_WriteUnlockUnixReaderWriter(&ReaderWriter);
+			else  sync_ReadUnlockUnixReaderWriter(&ReaderWriter);
+		}
+		else if (bench_Opts.MxType == BENCH_EVENT)
+		{
+			sync_FireUnixEvent(&Event);
+		}
+		else
+		{
+			sync_ReleaseUnixSemaphore(&Semaphore, NULL);
+		}
+
+		if (bench_Opts.MxOutside)  bench_BusyWait(sync_GetMonotonicTime() + bench_Opts.MxOutside);
+	}
+}
+
+static void *bench_Thread(void *Arg)
+{
+	bench_Run((uint32_t)(uintptr_t)Arg);
+
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	size_t Size, SharedSize;
+	int Opt, Result;
+	uint32_t x, y;
+	pthread_t *Threads = NULL;
+	uint64_t Begin, End, Ops = 0, Reads = 0, Writes = 0, WorkerOps, MinOps = 0, MaxOps = 0;
+	sync_UnixHistogram Latency;
+	double Elapsed;
+
+	memset(&bench_Opts, 0, sizeof(bench_Opts));
+	bench_Opts.MxType = BENCH_MUTEX;
+	bench_Opts.MxWorkers = 4;
+	bench_Opts.MxSpinLimit = 100;
+	bench_Opts.MxUnits = 2;
+	bench_Opts.MxReadPercent = 90;
+	bench_Opts.MxDuration = 2.0;
+
+	while ((Opt = getopt(argc, argv, "p:w:fn:d:c:o:r:s:u:l:Fh")) != -1)
+	{
+		switch (Opt)
+		{
+			case 'p':
+			{
+				for (x = 0; x < 5 && strcmp(optarg, bench_TypeNames[x]); x++)
+				{
+				}
+
+				if (x == 5)
+				{
+					bench_Usage(argv[0]);
+
+					return 1;
+				}
+
+				bench_Opts.MxType = (int)x;
+
+				break;
+			}
+			case 'w':  bench_Opts.MxWorkers = (uint32_t)strtoul(optarg, NULL, 10);  break;
+			case 'f':  bench_Opts.MxFork = 1;  break;
+			case 'n':  bench_Opts.MxName = optarg;  break;
+			case 'd':  bench_Opts.MxDuration = strtod(optarg, NULL);  break;
+			case 'c':  bench_Opts.MxCritical = strtoull(optarg, NULL, 10);  break;
+			case 'o':  bench_Opts.MxOutside = strtoull(optarg, NULL, 10);  break;
+			case 'r':  bench_Opts.MxReadPercent = (uint32_t)strtoul(optarg, NULL, 10);  break;
+			case 's':  bench_Opts.MxReaderSlots = (uint32_t)strtoul(optarg, NULL, 10);  break;
+			case 'u':  bench_Opts.MxUnits = (uint32_t)strtoul(optarg, NULL, 10);  break;
+			case 'l':  bench_Opts.MxSpinLimit = (uint32_t)strtoul(optarg, NULL, 10);  break;
+			case 'F':  bench_Opts.MxFair = 1;  break;
+			default:
+			{
+				bench_Usage(argv[0]);
+
+				return (Opt == 'h' ? 0 : 1);
+			}
+		}
+	}
+
+	if (!bench_Opts.MxWorkers || bench_Opts.MxDuration <= 0.0 || bench_Opts.MxReadPercent > 100 || !bench_Opts.MxUnits || (bench_Opts.MxFair && bench_Opts.MxType != BENCH_MUTEX && bench_Opts.MxType != BENCH_SEMAPHORE))
+	{
+		bench_Usage(argv[0]);
+
+		return 1;
+	}
+
+	/* Forked workers only share named memory.  Cold starts only make sense for named objects. */
+	if ((bench_Opts.MxFork || bench_Opts.MxType == BENCH_OPEN) && bench_Opts.MxName == NULL)  bench_Opts.MxName = "bench";
+
+	/* Create the object the same way the extension's constructors do.  Cold start workers create their own. */
+	if (bench_Opts.MxType == BENCH_OPEN)  Size = 0;
+	else if (bench_Opts.MxType == BENCH_RWLOCK)  Size = sync_GetUnixReaderWriterSize() + sync_GetUnixReaderWriterSlotsSize(bench_Opts.MxReaderSlots);
+	else if (bench_Opts.MxType == BENCH_EVENT)  Size = sync_GetUnixEventSize();
+	else  Size = sync_GetUnixSemaphoreSize() + sync_GetUnixFairQueueSize(bench_Opts.MxFair);
+
+	Result = (bench_Opts.MxType == BENCH_OPEN ? 1 : sync_InitUnixNamedMem(&bench_Mem, &bench_Pos, "/Sync_Bench", bench_Opts.MxName, Size));
+	if (Result < 0)
+	{
+		fprintf(stderr, "Unable to create the %s object.\n", bench_TypeNames[bench_Opts.MxType]);
+
+		return 1;
+	}
+
+	if (Result == 0)
+	{
+		if (bench_Opts.MxType == BENCH_RWLOCK)
+		{
+			sync_UnixReaderWriterWrapper ReaderWriter;
+
+			sync_GetUnixReaderWriter(&ReaderWriter, bench_Mem + bench_Pos, 0);
+			sync_InitUnixReaderWriter(&ReaderWriter, (bench_Opts.MxName != NULL));
+		}
+		else if (bench_Opts.MxType == BENCH_EVENT)
+		{
+			sync_UnixEventWrapper Event;
+
+			sync_GetUnixEvent(&Event, bench_Mem + bench_Pos, 0);
+			sync_InitUnixEvent(&Event, (bench_Opts.MxName != NULL), 0, 1);
+		}
+		else
+		{
+			sync_UnixSemaphoreWrapper Semaphore;
+			uint32_t Units = (bench_Opts.MxType == BENCH_MUTEX ? 1 : bench_Opts.MxUnits);
+
+			sync_GetUnixSemaphore(&Semaphore, bench_Mem + bench_Pos, 0);
+			sync_InitUnixSemaphore(&Semaphore, (bench_Opts.MxName != NULL), Units, Units);
+			if (bench_Opts.MxFair)  memset(sync_GetUnixFairQueue(bench_Mem + bench_Pos + sync_GetUnixSemaphoreSize()), 0, sizeof(sync_UnixFairQueue));
+		}
+
+		if (bench_Opts.MxName != NULL)  sync_UnixNamedMemReady(bench_Mem);
+	}
+
+	SharedSize = sizeof(bench_Shared) + sizeof(bench_Result) * bench_Opts.MxWorkers;
+	bench_SharedMem = (bench_Shared *)mmap(NULL, SharedSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (bench_SharedMem == MAP_FAILED)
+	{
+		fprintf(stderr, "Unable to map shared memory for the results.\n");
+
+		return 1;
+	}
+
+	bench_Results = (bench_Result *)(bench_SharedMem + 1);
+
+	/* Start the workers.  They spin until everyone is ready. */
+	if (bench_Opts.MxFork)
+	{
+		for (x = 0; x < bench_Opts.MxWorkers; x++)
+		{
+			pid_t Pid = fork();
+
+			if (Pid < 0)
+			{
+				fprintf(stderr, "Unable to fork worker %u.\n", x);
+
+				return 1;
+			}
+
+			if (!Pid)
+			{
+				bench_Run(x);
+
+				_exit(0);
+			}
+		}
+	}
+	else
+	{
+		Threads = (pthread_t *)calloc(bench_Opts.MxWorkers, sizeof(pthread_t));
+
+		for (x = 0; x < bench_Opts.MxWorkers; x++)
+		{
+			if (pthread_create(&Threads[x], NULL, bench_Thread, (void *)(uintptr_t)x) != 0)
+			{
+				fprintf(stderr, "Unable to start worker %u.\n", x);
+
+				return 1;
+			}
+		}
+	}
+
+	usleep(100000);
+
+	Begin = sync_GetMonotonicTime();
+	__atomic_store_n(&bench_SharedMem->MxStart, 1, __ATOMIC_RELEASE);
+
+	usleep((useconds_t)(bench_Opts.MxDuration * 1000000.0));
+
+	__atomic_store_n(&bench_SharedMem->MxStop, 1, __ATOMIC_RELAXED);
+	End = sync_GetMonotonicTime();
+
+	if (bench_Opts.MxFork)
+	{
+		while (wait(NULL) > 0)
+		{
+		}
+	}
+	else
+	{
+		for (x = 0; x < bench_Opts.MxWorkers; x++)  pthread_join(Threads[x], NULL);
+
+		free(Threads);
+	}
+
+	/* Merge the results. */
+	memset(&Latency, 0, sizeof(Latency));
+	for (x = 0; x < bench_Opts.MxWorkers; x++)
+	{
+		Reads += bench_Results[x].MxReads;
+		Writes += bench_Results[x].MxWrites;
+
+		/* The spread between the busiest and the least busy worker shows starvation. */
+		WorkerOps = bench_Results[x].MxReads + bench_Results[x].MxWrites;
+		if (!x || WorkerOps < MinOps)  MinOps = WorkerOps;
+		if (!x || WorkerOps > MaxOps)  MaxOps = WorkerOps;
+
+		for (y = 0; y < SYNC_UNIX_HISTOGRAM_BUCKETS; y++)  Latency.MxBuckets[y] += bench_Results[x].MxLatency.MxBuckets[y];
+	}
+
+	Ops = Reads + Writes;
+	Elapsed = (double)(End - Begin) / 1000000000.0;
+
+	printf("type=%s mode=%s workers=%u critical_ns=%llu outside_ns=%llu spin_limit=%u", bench_TypeNames[bench_Opts.MxType], (bench_Opts.MxFork ? "fork" : "threads"), bench_Opts.MxWorkers, (unsigned long long)bench_Opts.MxCritical, (unsigned long long)bench_Opts.MxOutside, bench_Opts.MxSpinLimit);
+	if (bench_Opts.MxType == BENCH_SEMAPHORE)  printf(" units=%u", bench_Opts.MxUnits);
+	if (bench_Opts.MxType == BENCH_MUTEX || bench_Opts.MxType == BENCH_SEMAPHORE)  printf(" fair=%d", bench_Opts.MxFair);
+	if (bench_Opts.MxType == BENCH_RWLOCK)  printf(" read_pct=%u reader_slots=%u reads=%llu writes=%llu", bench_Opts.MxReadPercent, bench_Opts.MxReaderSlots, (unsigned long long)Reads, (unsigned long long)Writes);
+	if (bench_Opts.MxType == BENCH_OPEN)  printf(" rounds=%llu", (unsigned long long)Writes);
+	if (bench_Opts.MxType != BENCH_OPEN)  printf(" worker_min_ops=%llu worker_max_ops=%llu", (unsigned long long)MinOps, (unsigned long long)MaxOps);
+	printf(" ops=%llu ops_per_sec=%.0f p50_ns=%llu p99_ns=%llu p999_ns=%llu max_ns=%llu\n", (unsigned long long)Ops, (double)Ops / Elapsed, (unsigned long long)sync_GetUnixHistogramPercentile(&Latency, 50.0), (unsigned long long)sync_GetUnixHistogramPercentile(&Latency, 99.0), (unsigned long long)sync_GetUnixHistogramPercentile(&Latency, 99.9), (unsigned long long)sync_GetUnixHistogramPercentile(&Latency, 100.0));
+
+	/* Every exclusive operation incremented the counter under the lock.  A lost update means two workers were inside at once. */
+	Result = 0;
+	if (bench_Opts.MxType != BENCH_OPEN && (bench_Opts.MxType != BENCH_SEMAPHORE || bench_Opts.MxUnits == 1) && bench_SharedMem->MxCounter != Writes)
+	{
+		fprintf(stderr, "Mutual exclusion check failed:  %llu exclusive operations, counter is %llu.\n", (unsigned long long)Writes, (unsigned long long)bench_SharedMem->MxCounter);
+
+		Result = 1;
+	}
+
+	munmap((void *)bench_SharedMem, SharedSize);
+
+	if (bench_Opts.MxType != BENCH_OPEN)
+	{
+		if (bench_Opts.MxName != NULL)  sync_UnmapUnixNamedMem(bench_Mem, Size);
+		else  free(bench_Mem);
+	}
+
+	return Result;
+}
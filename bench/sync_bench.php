@@ -0,0 +1,282 @@
+<?php
+	// Multi-process contention benchmark for the PHP-level API.
+	// Measures what scripts actually pay per call, including parameter parsing and object lookups.
+	// Requires the sync and pcntl extensions and PHP 7.3 or later (hrtime()).
+
+	function SyncBench_Usage()
+	{
+		echo "Usage:  php sync_bench.php [options]\n\n";
+		echo "  --type=TYPE      mutex, mutex-fair, semaphore, semaphore-fair, event, rwlock, shm, or all (default all)\n";
+		echo "  --workers=NUM    Number of forked workers (default 4)\n";
+		echo "  --ops=NUM        Operations per worker (default 50000)\n";
+		echo "  --critical=US    Microseconds to hold each lock (default 0)\n";
+		echo "  --read-pct=PCT   Percentage of rwlock and shm operations that are reads (default 90)\n";
+		echo "  --units=NUM      Semaphore units (default 2)\n";
+		echo "  --json           Output JSON instead of a table\n";
+	}
+
+	function SyncBench_Spin($until)
+	{
+		while (hrtime(true) < $until)
+		{
+		}
+	}
+
+	// Returns the value below which $percent percent of the sorted samples fall.
+	function SyncBench_Percentile($samples, $percent)
+	{
+		$num = count($samples);
+		if (!$num)  return 0;
+
+		$pos = (int)ceil($num * $percent / 100) - 1;
+
+		return $samples[max(0, min($num - 1, $pos))];
+	}
+
+	// Opens the object under test.  Every worker opens the same name, just like separate FPM workers would.
+	function SyncBench_Open($type, $name, $options)
+	{
+		switch ($type)
+		{
+			case "mutex":  return new SyncMutex($name);
+			case "mutex-fair":  return new SyncMutex($name, false, true);
+			case "semaphore":  return new SyncSemaphore($name, $options["units"]);
+			case "semaphore-fair":  return new SyncSemaphore($name, $options["units"], true, false, false, true);
+			case "event":  return new SyncEvent($name, false, true);
+			case "rwlock":  return new SyncReaderWriter($name);
+			case "shm":  return new SyncSharedMemory($name, 4096, true);
+		}
+
+		return false;
+	}
+
+	// Runs one worker and writes the start time, end time, and per-operation latencies to a file.
+	function SyncBench_Worker($type, $name, $options, $filename)
+	{
+		$obj = SyncBench_Open($type, $name, $options);
+		$start = new SyncEvent($name . "_start", true);
+		$ops = $options["ops"];
+		$critical = $options["critical"] * 1000;
+		$readpct = $options["read-pct"];
+		$data = str_repeat("x", 64);
+		$latencies = array();
+
+		mt_srand(getmypid());
+
+		$start->wait();
+
+		$starttime = hrtime(true);
+
+		for ($x = 0; $x < $ops; $x++)
+		{
+			$read = (($type === "rwlock" || $type === "shm") && mt_rand(0, 99) < $readpct);
+
+			$ts = hrtime(true);
+
+			switch ($type)
+			{
+				case "mutex":
+				case "mutex-fair":
+				case "semaphore":
+				case "semaphore-fair":
+				{
+					$obj->lock();
+					$latencies[] = hrtime(true) - $ts;
+					if ($critical)  SyncBench_Spin(hrtime(true) + $critical);
+					$obj->unlock();
+
+					break;
+				}
+				case "event":
+				{
+					// A prefired auto-reset event lets one waiter through at a time, so it works as a lock.
+					$obj->wait();
+					$latencies[] = hrtime(true) - $ts;
+					if ($critical)  SyncBench_Spin(hrtime(true) + $critical);
+					$obj->fire();
+
+					break;
+				}
+				case "rwlock":
+				{
+					if ($read)  $obj->readlock();
+					else  $obj->writelock();
+
+					$latencies[] = hrtime(true) - $ts;
+					if ($critical)  SyncBench_Spin(hrtime(true) + $critical);
+
+					if ($read)  $obj->readunlock();
+					else  $obj->writeunlock();
+
+					break;
+				}
+				case "shm":
+				{
+					// Sequence lock reads and writes are complete operations on their own.
+					if ($read)  $obj->read(0, 64);
+					else  $obj->write($data, 0);
+
+					$latencies[] = hrtime(true) - $ts;
+
+					break;
+				}
+			}
+		}
+
+		$endtime = hrtime(true);
+
+		file_put_contents($filename, pack("J2", $starttime, $endtime) . pack("J*", ...$latencies));
+	}
+
+	// Forks the workers for one object type and merges their results.
+	function SyncBench_Run($type, $options)
+	{
+		$name = "SyncBench_" . getmypid() . "_" . $type;
+
+		// Don't hold any objects while forking.  Children would release inherited objects at exit without ever having opened them.
+		$pids = array();
+		$filenames = array();
+		for ($x = 0; $x < $options["workers"]; $x++)
+		{
+			$filenames[$x] = tempnam(sys_get_temp_dir(), "sync_bench");
+
+			$pid = pcntl_fork();
+			if ($pid < 0)
+			{
+				fwrite(STDERR, "Unable to fork worker " . $x . ".\n");
+
+				exit(1);
+			}
+
+			if (!$pid)
+			{
+				SyncBench_Worker($type, $name, $options, $filenames[$x]);
+
+				exit(0);
+			}
+
+			$pids[] = $pid;
+		}
+
+		// Give the workers a moment to open the objects, then start them all at once.
+		$start = new SyncEvent($name . "_start", true);
+		usleep(100000);
+		$start->fire();
+
+		foreach ($pids as $pid)  pcntl_waitpid($pid, $status);
+
+		$starttime = false;
+		$endtime = false;
+		$latencies = array();
+		foreach ($filenames as $filename)
+		{
+			$data = file_get_contents($filename);
+			@unlink($filename);
+
+			if (strlen($data) < 16)
+			{
+				fwrite(STDERR, "A " . $type . " worker didn't finish.\n");
+
+				exit(1);
+			}
+
+			$times = unpack("J2", substr($data, 0, 16));
+			if ($starttime === false || $times[1] < $starttime)  $starttime = $times[1];
+			if ($endtime === false || $times[2] > $endtime)  $endtime = $times[2];
+
+			if (strlen($data) > 16)  $latencies = array_merge($latencies, array_values(unpack("J*", substr($data, 16))));
+		}
+
+		sort($latencies);
+
+		$seconds = ($endtime - $starttime) / 1000000000;
+		$ops = count($latencies);
+
+		return array(
+			"type" => $type,
+			"workers" => $options["workers"],
+			"ops" => $ops,
+			"seconds" => round($seconds, 6),
+			"ops_per_sec" => ($seconds > 0 ? (int)round($ops / $seconds) : 0),
+			"p50_ns" => SyncBench_Percentile($latencies, 50),
+			"p90_ns" => SyncBench_Percentile($latencies, 90),
+			"p99_ns" => SyncBench_Percentile($latencies, 99),
+			"p99.9_ns" => SyncBench_Percentile($latencies, 99.9),
+			"max_ns" => ($ops ? $latencies[$ops - 1] : 0)
+		);
+	}
+
+	if (!extension_loaded("sync") || !function_exists("pcntl_fork") || !function_exists("hrtime"))
+	{
+		fwrite(STDERR, "The sync and pcntl extensions and PHP 7.3 or later are required.\n");
+
+		exit(1);
+	}
+
+	$args = getopt("", array("type:", "workers:", "ops:", "critical:", "read-pct:", "units:", "json", "help"));
+	if (isset($args["help"]))
+	{
+		SyncBench_Usage();
+
+		exit(0);
+	}
+
+	$options = array(
+		"type" => (isset($args["type"]) ? $args["type"] : "all"),
+		"workers" => (isset($args["workers"]) ? (int)$args["workers"] : 4),
+		"ops" => (isset($args["ops"]) ? (int)$args["ops"] : 50000),
+		"critical" => (isset($args["critical"]) ? (float)$args["critical"] : 0),
+		"read-pct" => (isset($args["read-pct"]) ? (int)$args["read-pct"] : 90),
+		"units" => (isset($args["units"]) ? (int)$args["units"] : 2),
+		"json" => isset($args["json"])
+	);
+
+	// The fair variants run right after the default mode so that throughput and tail latency can be compared.
+	$types = array("mutex", "mutex-fair", "semaphore", "semaphore-fair", "event", "rwlock", "shm");
+	if ($options["type"] !== "all")
+	{
+		if (!in_array($options["type"], $types, true))
+		{
+			SyncBench_Usage();
+
+			exit(1);
+		}
+
+		$types = array($options["type"]);
+	}
+
+	if ($options["workers"] < 1 || $options["ops"] < 1 || $options["units"] < 1 || $options["read-pct"] < 0 || $options["read-pct"] > 100)
+	{
+		SyncBench_Usage();
+
+		exit(1);
+	}
+
+	$results = array();
+	foreach ($types as $type)  $results[] = SyncBench_Run($type, $options);
+
+	if ($options["json"])
+	{
+		echo json_encode(array(
+			"php" => PHP_VERSION,
+			"sync" => phpversion("sync"),
+			"os" => PHP_OS,
+			"workers" => $options["workers"],
+			"ops_per_worker" => $options["ops"],
+			"critical_us" => $options["critical"],
+			"read_pct" => $options["read-pct"],
+			"units" => $options["units"],
+			"results" => $results
+		), JSON_PRETTY_PRINT) . "\n";
+	}
+	else
+	{
+		echo "PHP " . PHP_VERSION . ", sync " . phpversion("sync") . ", " . $options["workers"] . " workers, " . $options["ops"] . " operations each, " . $options["critical"] . " us critical section\n\n";
+
+		printf("%-15s %12s %10s %10s %10s %10s %10s\n", "type", "ops/sec", "p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "max ns");
+		foreach ($results as $result)
+		{
+			printf("%-15s %12d %10d %10d %10d %10d %10d\n", $result["type"], $result["ops_per_sec"], $result["p50_ns"], $result["p90_ns"], $result["p99_ns"], $result["p99.9_ns"], $result["max_ns"]);
+		}
+	}
+?>
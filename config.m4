@@ -43,6 +43,35 @@ if test "$PHP_SYNC" != "no"; then
     ])
   ])
 
+  dnl # Linux futexes allow for lock-free uncontended semaphore operations.
+  AC_CHECK_HEADERS([linux/futex.h])
+
+  dnl # Condition variables that time out against CLOCK_MONOTONIC.
+  AC_CHECK_FUNCS([pthread_condattr_setclock])
+
+  dnl # Robust process-shared mutexes recover when their owner dies.
+  AC_CHECK_FUNCS([pthread_mutexattr_setrobust])
+
+  dnl # Priority inheritance mutexes boost the owner to the priority of the highest waiter.  Timed locks against CLOCK_MONOTONIC are used when available.
+  AC_CHECK_FUNCS([pthread_mutexattr_setprotocol pthread_mutex_timedlock pthread_mutex_clocklock])
+
+  dnl # Picks the reader slot for big-reader Reader-Writer objects.
+  AC_CHECK_FUNCS([sched_getcpu])
+
+  dnl # USDT probes for bpftrace/SystemTap (systemtap-sdt-dev).  Each probe is a nop until a tracer attaches.
+  AC_MSG_CHECKING([for sys/sdt.h probes])
+
+  AC_TRY_COMPILE([
+    #include <sys/sdt.h>
+  ], [
+    STAP_PROBE1(php_sync, test, 1);
+  ], [
+    AC_MSG_RESULT([yes])
+    AC_DEFINE(HAVE_SYNC_SDT, 1, [Whether sys/sdt.h probes are available])
+  ], [
+    AC_MSG_RESULT([no])
+  ])
+
   dnl # Finish defining the basic extension support.
   AC_DEFINE(HAVE_SYNC, 1, [Whether you have synchronization object support])
   PHP_NEW_EXTENSION(sync, sync.c, $ext_shared)
@@ -37,11 +37,28 @@ extern zend_module_entry sync_module_entry;
 #include <unistd.h>
 #include <errno.h>
 #include <pthread.h>
+#include <sched.h>
+#include <signal.h>
 #include <limits.h>
 
+#if defined(__linux__) && defined(HAVE_LINUX_FUTEX_H) && defined(__GNUC__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#	define SYNC_UNIX_FUTEX
+#endif
+
+#ifdef HAVE_SYNC_SDT
+#include <sys/sdt.h>
+#endif
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#	define MAP_ANONYMOUS   MAP_ANON
+#endif
+
 #ifdef __APPLE__
 #include <mach/clock.h>
 #include <mach/mach.h>
+#include <mach/mach_time.h>
 #ifndef SHM_NAME_MAX
 #	define SHM_NAME_MAX 31
 #endif
@@ -57,6 +74,27 @@ PHP_MINIT_FUNCTION(sync);
 PHP_MSHUTDOWN_FUNCTION(sync);
 PHP_MINFO_FUNCTION(sync);
 
+#if PHP_MAJOR_VERSION >= 7
+typedef zend_long   sync_INI_long;
+#else
+typedef long   sync_INI_long;
+#endif
+
+ZEND_BEGIN_MODULE_GLOBALS(sync)
+	sync_INI_long spin_limit;
+	sync_INI_long cache_size;
+	sync_INI_long cache_ttl;
+	zend_bool shared_unnamed;
+ZEND_END_MODULE_GLOBALS(sync)
+
+#if PHP_MAJOR_VERSION >= 7
+#define SYNC_G(v)   ZEND_MODULE_GLOBALS_ACCESSOR(sync, v)
+#elif defined(ZTS)
+#define SYNC_G(v)   TSRMG(sync_globals_id, zend_sync_globals *, v)
+#else
+#define SYNC_G(v)   (sync_globals.v)
+#endif
+
 #if defined(PHP_WIN32)
 typedef DWORD sync_ThreadIDType;
 #else
@@ -78,15 +116,67 @@ typedef pthread_t sync_ThreadIDType;
 
 #else
 
+/* Lock contention statistics.  Named memory headers hold one of these per CPU slot, each on its own cache line. */
+typedef struct _sync_UnixStatsSlot {
+	uint64_t MxAcquired;
+	uint64_t MxContended;
+	uint64_t MxTimeouts;
+	uint64_t MxWaitTime;
+	uint64_t MxMaxWaitTime;
+	uint64_t MxMaxHoldTime;
+} sync_UnixStatsSlot;
+
+/* Optional wait and hold time histograms.  Log-linear buckets of nanoseconds. */
+#define SYNC_UNIX_HISTOGRAM_BUCKETS   320
+
+typedef struct _sync_UnixHistogram {
+	uint64_t MxBuckets[SYNC_UNIX_HISTOGRAM_BUCKETS];
+} sync_UnixHistogram;
+
+/* Optional FIFO handoff queue for semaphores in fair mode.  Waiters take slots in arrival order and releases hand units straight to the oldest one. */
+#define SYNC_UNIX_FAIR_SLOTS   256
+
+typedef struct _sync_UnixFairSlot {
+	uint32_t MxState;
+	uint32_t MxCount;
+	uint64_t MxOwner;
+} sync_UnixFairSlot;
+
+typedef struct _sync_UnixFairQueue {
+	uint32_t MxHead, MxTail;
+	uint64_t MxLastCheck;
+	sync_UnixFairSlot MxSlots[SYNC_UNIX_FAIR_SLOTS];
+} sync_UnixFairQueue;
+
 /* Some platforms are broken even for unnamed semaphores (e.g. Mac OSX). */
 /* This allows for implementing all semaphores directly, bypassing POSIX semaphores. */
+/* Semaphores used as locks also record the process holding them, so a lock held by a process that died can be taken over. */
 typedef struct _sync_UnixSemaphoreWrapper {
 	pthread_mutex_t *MxMutex;
 	volatile uint32_t *MxCount;
 	volatile uint32_t *MxMax;
+	volatile uint32_t *MxDebt;
+	volatile uint64_t *MxOwner;
+	volatile uint32_t *MxWaiters;
+	volatile uint32_t *MxBatchWaiters;
 	pthread_cond_t *MxCond;
+
+	/* Process-local adaptive spin state. */
+	uint32_t MxSpinLimit, MxSpin;
+
+	/* Fair mode.  The queue follows the object in shared memory.  MxFairSlot is the slot of a wait in progress or -1. */
+	sync_UnixFairQueue *MxFair;
+	int32_t MxFairSlot;
 } sync_UnixSemaphoreWrapper;
 
+/* AIMD controller for semaphores used as adaptive concurrency limits.  Lives in shared memory, so every process that has the semaphore open feeds it. */
+typedef struct _sync_UnixSemaphoreLimiter {
+	uint64_t MxTarget;
+	uint64_t MxLastDecrease;
+	uint32_t MxMin, MxMax;
+	uint32_t MxFast;
+} sync_UnixSemaphoreLimiter;
+
 /* Implements a more efficient (and portable) event object interface than trying to use semaphores. */
 typedef struct _sync_UnixEventWrapper {
 	pthread_mutex_t *MxMutex;
@@ -94,8 +184,45 @@ typedef struct _sync_UnixEventWrapper {
 	volatile char *MxSignaled;
 	volatile uint32_t *MxWaiting;
 	pthread_cond_t *MxCond;
+
+	/* Process-local adaptive spin state. */
+	uint32_t MxSpinLimit, MxSpin;
 } sync_UnixEventWrapper;
 
+/* Wakes processes waiting on several events at once.  Seq changes whenever an event fires while Waiters is non-zero. */
+typedef struct _sync_UnixEventBellWrapper {
+#ifndef SYNC_UNIX_FUTEX
+	pthread_mutex_t *MxMutex;
+	pthread_cond_t *MxCond;
+#endif
+	volatile uint32_t *MxSeq;
+	volatile uint32_t *MxWaiters;
+} sync_UnixEventBellWrapper;
+
+/* Reader-writer lock.  With futexes, a single atomic state word tracks readers and the writer. */
+/* Otherwise, a reader count is protected by a semaphore and paired with an event that fires when readers reach zero. */
+typedef struct _sync_UnixReaderWriterWrapper {
+#ifdef SYNC_UNIX_FUTEX
+	volatile uint32_t *MxState;
+	volatile uint32_t *MxGate;
+	volatile uint32_t *MxDrain;
+
+	/* Big-reader mode.  Each slot is a reader counter on its own cache line. */
+	uint32_t MxSlots;
+	char *MxSlotMem;
+
+	/* Process-local adaptive spin state. */
+	uint32_t MxSpinLimit, MxSpin;
+#else
+	sync_UnixSemaphoreWrapper MxRCountMutex;
+	volatile uint32_t *MxRCount;
+	sync_UnixEventWrapper MxRWaitEvent;
+#endif
+
+	/* Serializes writers.  Guarantees that readers can't starve the writer. */
+	sync_UnixSemaphoreWrapper MxWWaitMutex;
+} sync_UnixReaderWriterWrapper;
+
 #endif
 
 
@@ -110,29 +237,106 @@ typedef struct _sync_Mutex_object {
 #else
 	pthread_mutex_t MxPthreadCritSection;
 
-	int MxNamed;
+	int MxMemType;
 	char *MxMem;
 	sync_UnixSemaphoreWrapper MxPthreadMutex;
+	int MxPrioInherit;
+	char *MxFairMem;
+
+	char *MxStats;
+	uint32_t MxNameHash;
+	uint64_t MxHoldStart;
+	char *MxHistMem;
+	sync_UnixHistogram *MxHistograms;
 
+	/* Process-local lock state is only valid in the process that acquired the locks. */
+	uint32_t MxForkGen;
 #endif
 
 	volatile sync_ThreadIDType MxOwnerID;
 	volatile unsigned int MxCount;
+	int MxAbandoned;
 
 	PHP_SYNC_PHP_7_zend_object_std
 } sync_Mutex_object;
 
 
+/* Striped mutex */
+#define SYNC_STRIPED_MUTEX_MAX_STRIPES   65536
+
+typedef struct _sync_StripedMutexStripe {
+#if defined(PHP_WIN32)
+	HANDLE MxWinMutex;
+#else
+	sync_UnixSemaphoreWrapper MxPthreadMutex;
+	uint64_t MxHoldStart;
+#endif
+
+	volatile sync_ThreadIDType MxOwnerID;
+	volatile unsigned int MxCount;
+} sync_StripedMutexStripe;
+
+typedef struct _sync_StripedMutex_object {
+	PHP_SYNC_PHP_5_zend_object_std
+
+#if defined(PHP_WIN32)
+	CRITICAL_SECTION MxWinCritSection;
+
+	/* Stripes are separate Windows mutexes, created the first time each one is used. */
+	char *MxWinName;
+#else
+	pthread_mutex_t MxPthreadCritSection;
+
+	int MxMemType;
+	char *MxMem;
+	char *MxStripesMem;
+
+	char *MxStats;
+	uint32_t MxNameHash;
+
+	/* Process-local lock state is only valid in the process that acquired the locks. */
+	uint32_t MxForkGen;
+#endif
+
+	uint32_t MxNumStripes;
+	sync_StripedMutexStripe *MxStripes;
+	int MxAbandoned;
+
+	PHP_SYNC_PHP_7_zend_object_std
+} sync_StripedMutex_object;
+
+
 /* Semaphore */
+#define SYNC_SEMAPHORE_MAX_HOLDERS   65536
+
 typedef struct _sync_Semaphore_object {
 	PHP_SYNC_PHP_5_zend_object_std
 
 #if defined(PHP_WIN32)
 	HANDLE MxWinSemaphore;
 #else
-	int MxNamed;
+	int MxMemType;
 	char *MxMem;
 	sync_UnixSemaphoreWrapper MxPthreadSemaphore;
+
+	/* Optional holder table and fair mode queue.  Each lives in its own segment.  One holder slot per unit records the process holding it. */
+	uint32_t MxNumHolders;
+	char *MxHoldersMem;
+	volatile uint64_t *MxHolders;
+	char *MxFairMem;
+
+	/* Adaptive capacity.  Holds are timed with the precise clock while the controller is on. */
+	sync_UnixSemaphoreLimiter *MxLimiter;
+	uint64_t MxLimitStart;
+
+	char *MxStats;
+	uint32_t MxNameHash;
+	uint64_t MxHoldStart;
+	char *MxHistMem;
+	sync_UnixHistogram *MxHistograms;
+
+	/* Process-local lock state is only valid in the process that acquired the locks. */
+	uint32_t MxForkGen;
 #endif
 
 	int MxAutoUnlock;
@@ -149,9 +353,12 @@ typedef struct _sync_Event_object {
 #if defined(PHP_WIN32)
 	HANDLE MxWinWaitEvent;
 #else
-	int MxNamed;
+	int MxMemType;
 	char *MxMem;
 	sync_UnixEventWrapper MxPthreadEvent;
+
+	char *MxStats;
+	uint32_t MxNameHash;
 #endif
 
 	PHP_SYNC_PHP_7_zend_object_std
@@ -165,22 +372,31 @@ typedef struct _sync_ReaderWriter_object {
 #if defined(PHP_WIN32)
 	HANDLE MxWinRSemMutex, MxWinRSemaphore, MxWinRWaitEvent, MxWinWWaitMutex;
 #else
-	int MxNamed;
+	int MxMemType;
 	char *MxMem;
-	sync_UnixSemaphoreWrapper MxPthreadRCountMutex;
-	volatile uint32_t *MxRCount;
-	sync_UnixEventWrapper MxPthreadRWaitEvent;
-	sync_UnixSemaphoreWrapper MxPthreadWWaitMutex;
+	uint32_t MxReaderSlots;
+	char *MxSlotsMem;
+	sync_UnixReaderWriterWrapper MxPthreadReaderWriter;
+
+	char *MxStats;
+	uint32_t MxNameHash;
+	uint64_t MxHoldStart;
+	char *MxHistMem;
+	sync_UnixHistogram *MxHistograms;
+
+	/* Process-local lock state is only valid in the process that acquired the locks. */
+	uint32_t MxForkGen;
 #endif
 
 	int MxAutoUnlock;
-	volatile unsigned int MxReadLocks, MxWriteLock;
+	volatile unsigned int MxReadLocks, MxWriteLock, MxUpgradeLock;
+	int MxAbandoned;
 
 	PHP_SYNC_PHP_7_zend_object_std
 } sync_ReaderWriter_object;
 
 
-/* Named shared memory */
+/* Named and unnamed shared memory */
 typedef struct _sync_SharedMemory_object {
 	PHP_SYNC_PHP_5_zend_object_std
 
@@ -188,9 +404,19 @@ typedef struct _sync_SharedMemory_object {
 	size_t MxSize;
 	char *MxMem;
 
+	/* Sequence lock mode.  The sequence word lives in a header in front of the data.  On *NIX, the header also identifies the writer. */
+	/* MxRecoveries is the header's count of writes ended for a writer that died, as of the last read() or write(). */
+	uint32_t MxRecoveries;
+	int MxAbandoned;
+
 #if defined(PHP_WIN32)
+	volatile uint32_t *MxSeq;
+
 	HANDLE MxFile;
 #else
+	volatile uint64_t *MxSeq;
+
+	int MxMemType;
 	char *MxMemInternal;
 #endif
 
@@ -66,10 +66,44 @@ zend_module_entry sync_module_entry = {
 ZEND_GET_MODULE(sync)
 #endif
 
+ZEND_DECLARE_MODULE_GLOBALS(sync)
+
+/* {{{ PHP_INI
+ */
+PHP_INI_BEGIN()
+	STD_PHP_INI_ENTRY("sync.spin_limit", "100", PHP_INI_ALL, OnUpdateLong, spin_limit, zend_sync_globals, sync_globals)
+	STD_PHP_INI_ENTRY("sync.cache_size", "0", PHP_INI_SYSTEM, OnUpdateLong, cache_size, zend_sync_globals, sync_globals)
+	STD_PHP_INI_ENTRY("sync.cache_ttl", "0", PHP_INI_SYSTEM, OnUpdateLong, cache_ttl, zend_sync_globals, sync_globals)
+	STD_PHP_INI_BOOLEAN("sync.shared_unnamed", "0", PHP_INI_ALL, OnUpdateBool, shared_unnamed, zend_sync_globals, sync_globals)
+PHP_INI_END()
+/* }}} */
+
 #ifndef INFINITE
 #	define INFINITE   0xFFFFFFFF
 #endif
 
+/* Deadlines are absolute monotonic clock times in nanoseconds (the same clock as hrtime()).  Immune to wall clock adjustments. */
+#define SYNC_DEADLINE_NOWAIT     ((uint64_t)0)
+#define SYNC_DEADLINE_INFINITE   ((uint64_t)0xFFFFFFFFFFFFFFFFULL)
+
+/* USDT probes (provider php_sync).  Each probe is a single nop until a tracer attaches to it. */
+#ifdef HAVE_SYNC_SDT
+#	define SYNC_PROBE1(Name, A)         STAP_PROBE1(php_sync, Name, A)
+#	define SYNC_PROBE2(Name, A, B)      STAP_PROBE2(php_sync, Name, A, B)
+#	define SYNC_PROBE3(Name, A, B, C)   STAP_PROBE3(php_sync, Name, A, B, C)
+#else
+#	define SYNC_PROBE1(Name, A)
+#	define SYNC_PROBE2(Name, A, B)
+#	define SYNC_PROBE3(Name, A, B, C)
+#endif
+
+/* Object types passed to probes. */
+#define SYNC_PROBE_MUTEX       1
+#define SYNC_PROBE_SEMAPHORE   2
+#define SYNC_PROBE_EVENT       3
+#define SYNC_PROBE_READLOCK    4
+#define SYNC_PROBE_WRITELOCK   5
+
 
 /* Define some generic functions used several places. */
 #if defined(PHP_WIN32)
@@ -80,20 +114,31 @@ sync_ThreadIDType sync_GetCurrentThreadID()
 	return GetCurrentThreadId();
 }
 
-uint64_t sync_GetUnixMicrosecondTime()
+uint64_t sync_GetMonotonicTime()
 {
-	FILETIME TempTime;
-	ULARGE_INTEGER TempTime2;
-	uint64_t Result;
+	static LARGE_INTEGER Freq = { 0 };
+	LARGE_INTEGER Counter;
 
-	GetSystemTimeAsFileTime(&TempTime);
-	TempTime2.HighPart = TempTime.dwHighDateTime;
-	TempTime2.LowPart = TempTime.dwLowDateTime;
-	Result = TempTime2.QuadPart;
+	if (!Freq.QuadPart && !QueryPerformanceFrequency(&Freq))  return 0;
+	if (!QueryPerformanceCounter(&Counter))  return 0;
 
-	Result = (Result / 10) - (uint64_t)11644473600000000ULL;
+	return (uint64_t)(Counter.QuadPart / Freq.QuadPart) * (uint64_t)1000000000 + (uint64_t)(Counter.QuadPart % Freq.QuadPart) * (uint64_t)1000000000 / (uint64_t)Freq.QuadPart;
+}
 
-	return Result;
+/* Converts a deadline into a relative wait in milliseconds (rounded up) for WaitForSingleObject(). */
+DWORD sync_GetWinWaitAmt(uint64_t Deadline)
+{
+	uint64_t CurrTime;
+
+	if (Deadline == SYNC_DEADLINE_NOWAIT)  return 0;
+	if (Deadline == SYNC_DEADLINE_INFINITE)  return INFINITE;
+
+	CurrTime = sync_GetMonotonicTime();
+	if (CurrTime >= Deadline)  return 0;
+
+	CurrTime = (Deadline - CurrTime + 999999) / 1000000;
+
+	return (CurrTime < INFINITE ? (DWORD)CurrTime : INFINITE - 1);
 }
 
 #else
@@ -104,15 +149,6 @@ sync_ThreadIDType sync_GetCurrentThreadID()
 	return pthread_self();
 }
 
-uint64_t sync_GetUnixMicrosecondTime()
-{
-	struct timeval TempTime;
-
-	if (gettimeofday(&TempTime, NULL))  return 0;
-
-	return (uint64_t)((uint64_t)TempTime.tv_sec * (uint64_t)1000000 + (uint64_t)TempTime.tv_usec);
-}
-
 /* Dear Apple:  You hire plenty of developers, so please fix your OS. */
 int sync_CSGX__ClockGetTimeRealtime(struct timespec *ts)
 {
@@ -133,6 +169,115 @@ int sync_CSGX__ClockGetTimeRealtime(struct timespec *ts)
 #endif
 }
 
+uint64_t sync_GetMonotonicTime()
+{
+#ifdef __APPLE__
+	static mach_timebase_info_data_t TimebaseInfo = { 0, 0 };
+
+	if (!TimebaseInfo.denom && mach_timebase_info(&TimebaseInfo) != KERN_SUCCESS)  return 0;
+
+	return (uint64_t)((double)mach_absolute_time() * (double)TimebaseInfo.numer / (double)TimebaseInfo.denom);
+#else
+	struct timespec TempTime;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &TempTime) == -1)  return 0;
+
+	return (uint64_t)TempTime.tv_sec * (uint64_t)1000000000 + (uint64_t)TempTime.tv_nsec;
+#endif
+}
+
+/* A cheaper monotonic clock with tick resolution where available.  Good enough for spotting long lock hold times. */
+uint64_t sync_GetCoarseMonotonicTime()
+{
+#if defined(CLOCK_MONOTONIC_COARSE)
+	struct timespec TempTime;
+
+	if (clock_gettime(CLOCK_MONOTONIC_COARSE, &TempTime) == -1)  return 0;
+
+	return (uint64_t)TempTime.tv_sec * (uint64_t)1000000000 + (uint64_t)TempTime.tv_nsec;
+#else
+	return sync_GetMonotonicTime();
+#endif
+}
+
+void sync_GetUnixDeadlineTimespec(struct timespec *ts, uint64_t Deadline)
+{
+	ts->tv_sec = (time_t)(Deadline / 1000000000);
+	ts->tv_nsec = (long)(Deadline % 1000000000);
+}
+
+/* Waits on a condition variable until a deadline.  Returns ETIMEDOUT once the deadline passes. */
+int sync_UnixCondTimedWait(pthread_cond_t *Cond, pthread_mutex_t *Mutex, uint64_t Deadline)
+{
+	struct timespec TempTime;
+
+#if defined(__APPLE__)
+	/* Mac OSX doesn't support monotonic condition variables but does have relative waits. */
+	uint64_t CurrTime = sync_GetMonotonicTime();
+	if (CurrTime >= Deadline)  return ETIMEDOUT;
+
+	sync_GetUnixDeadlineTimespec(&TempTime, Deadline - CurrTime);
+
+	return pthread_cond_timedwait_relative_np(Cond, Mutex, &TempTime);
+#elif defined(HAVE_PTHREAD_CONDATTR_SETCLOCK)
+	sync_GetUnixDeadlineTimespec(&TempTime, Deadline);
+
+	return pthread_cond_timedwait(Cond, Mutex, &TempTime);
+#else
+	/* Fall back to the realtime clock, translating the remaining time on each call. */
+	struct timespec TempTime2;
+	uint64_t CurrTime = sync_GetMonotonicTime();
+	if (CurrTime >= Deadline)  return ETIMEDOUT;
+	if (sync_CSGX__ClockGetTimeRealtime(&TempTime2) == -1)  return EINVAL;
+
+	sync_GetUnixDeadlineTimespec(&TempTime, (uint64_t)TempTime2.tv_sec * (uint64_t)1000000000 + (uint64_t)TempTime2.tv_nsec + (Deadline - CurrTime));
+
+	return pthread_cond_timedwait(Cond, Mutex, &TempTime);
+#endif
+}
+
+void sync_InitUnixCondAttr(pthread_condattr_t *CondAttr, int Shared)
+{
+	pthread_condattr_init(CondAttr);
+
+	if (Shared)  pthread_condattr_setpshared(CondAttr, PTHREAD_PROCESS_SHARED);
+
+#if defined(HAVE_PTHREAD_CONDATTR_SETCLOCK) && !defined(__APPLE__)
+	pthread_condattr_setclock(CondAttr, CLOCK_MONOTONIC);
+#endif
+}
+
+/* Process-shared mutexes are robust where supported.  When the process holding one dies, the next locker gets it with EOWNERDEAD instead of hanging forever. */
+void sync_InitUnixMutexAttr(pthread_mutexattr_t *MutexAttr, int Shared)
+{
+	pthread_mutexattr_init(MutexAttr);
+
+	if (Shared)
+	{
+		pthread_mutexattr_setpshared(MutexAttr, PTHREAD_PROCESS_SHARED);
+
+#ifdef HAVE_PTHREAD_MUTEXATTR_SETROBUST
+		pthread_mutexattr_setrobust(MutexAttr, PTHREAD_MUTEX_ROBUST);
+#endif
+	}
+}
+
+/* Filters the result of locking a robust mutex (including waiting on a condition variable).  A mutex inherited from a dead process is locked and just has to be marked consistent. */
+/* The mutexes only guard counts and flags that are valid after every store, so there is nothing to repair. */
+int sync_RecoverUnixMutex(pthread_mutex_t *Mutex, int Result)
+{
+#ifdef HAVE_PTHREAD_MUTEXATTR_SETROBUST
+	if (Result == EOWNERDEAD)
+	{
+		pthread_mutex_consistent(Mutex);
+
+		Result = 0;
+	}
+#endif
+
+	return Result;
+}
+
 size_t sync_GetUnixSystemAlignmentSize()
 {
 	struct {
@@ -156,95 +301,223 @@ size_t sync_AlignUnixSize(size_t Size)
 	return Size;
 }
 
-int sync_InitUnixNamedMem(char **ResultMem, size_t *StartPos, const char *Prefix, const char *Name, size_t Size)
+#ifdef SYNC_UNIX_FUTEX
+/* Linux futexes.  Not private since the words live in shared memory that may be mapped by other processes. */
+int sync_UnixFutexWait(volatile uint32_t *Addr, uint32_t Val, const struct timespec *AbsTime)
 {
-	int Result = -1;
-	*ResultMem = NULL;
-	*StartPos = (Name != NULL ? sync_AlignUnixSize(1) + sync_AlignUnixSize(sizeof(pthread_mutex_t)) + sync_AlignUnixSize(sizeof(uint32_t)) : 0);
+	/* FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC timeout, which survives retries without recalculation. */
+	int Result;
 
-	/* First byte indicates initialization status (0 = completely uninitialized, 1 = first mutex initialized, 2 = ready). */
-	/* Next few bytes are a shared mutex object. */
-	/* Size bytes follow for whatever. */
-	Size += *StartPos;
+	SYNC_PROBE1(sleep, (uintptr_t)Addr);
+	Result = (int)syscall(SYS_futex, (uint32_t *)Addr, FUTEX_WAIT_BITSET, Val, AbsTime, NULL, FUTEX_BITSET_MATCH_ANY);
+	SYNC_PROBE1(wakeup, (uintptr_t)Addr);
+
+	return Result;
+}
+
+int sync_UnixFutexWake(volatile uint32_t *Addr, int Num)
+{
+	return (int)syscall(SYS_futex, (uint32_t *)Addr, FUTEX_WAKE, Num, NULL, NULL, 0);
+}
+
+/* Largest futex semaphore count. */
+#define SYNC_UNIX_FUTEX_COUNT     0x3FFFFFFFU
+#endif
+
+#define SYNC_UNIX_CACHE_LINE_SIZE      64
+
+/* Shared state that is written independently goes on separate cache lines so unrelated operations don't invalidate each other's lines. */
+/* Defining SYNC_UNIX_FIELD_ALIGN as 1 packs everything together again, which is only useful for measuring false sharing. */
+#ifndef SYNC_UNIX_FIELD_ALIGN
+#	define SYNC_UNIX_FIELD_ALIGN        SYNC_UNIX_CACHE_LINE_SIZE
+#endif
+
+/* Bump whenever the shared memory layout changes.  It is part of every segment name so that builds with different layouts never share memory. */
+#define SYNC_UNIX_LAYOUT_VERSION       9
+
+size_t sync_AlignUnixField(size_t Size)
+{
 	Size = sync_AlignUnixSize(Size);
+	if (Size % SYNC_UNIX_FIELD_ALIGN)  Size += SYNC_UNIX_FIELD_ALIGN - (Size % SYNC_UNIX_FIELD_ALIGN);
 
-	if (Name == NULL)
-	{
-		*ResultMem = (char *)ecalloc(1, Size);
+	return Size;
+}
 
-		Result = 0;
+/* Unnamed memory comes from the PHP heap, which doesn't align to cache lines.  Layouts that care reserve SYNC_UNIX_FIELD_ALIGN extra bytes for this. */
+char *sync_AlignUnixFieldPtr(char *Mem)
+{
+	return (char *)(((uintptr_t)Mem + SYNC_UNIX_FIELD_ALIGN - 1) & ~(uintptr_t)(SYNC_UNIX_FIELD_ALIGN - 1));
+}
+
+/* Returns a small number that spreads threads across per-CPU data.  Falls back to the thread ID. */
+static inline uint32_t sync_GetUnixCpuSlot()
+{
+	int Slot = -1;
+
+#ifdef HAVE_SCHED_GETCPU
+	Slot = sched_getcpu();
+#endif
+	if (Slot < 0)  Slot = (int)((uintptr_t)sync_GetCurrentThreadID() >> 4);
+
+	return (uint32_t)Slot;
+}
+
+/* Contention statistics live in per-CPU slots at the end of the header so that counting doesn't bounce one cache line between CPUs. */
+#define SYNC_UNIX_STATS_SLOTS          16
+#define SYNC_UNIX_STATS_SIZE           (SYNC_UNIX_STATS_SLOTS * SYNC_UNIX_CACHE_LINE_SIZE)
+
+size_t sync_GetUnixNamedMemHeaderSize(int Named)
+{
+	size_t Result = 0;
+
+	if (Named)
+	{
+		Result = sync_AlignUnixSize(1) + sync_AlignUnixSize(sizeof(pthread_mutex_t)) + sync_AlignUnixSize(sizeof(uint32_t)) + sync_AlignUnixSize(sizeof(uint64_t));
+		Result = (Result + SYNC_UNIX_CACHE_LINE_SIZE - 1) & ~((size_t)SYNC_UNIX_CACHE_LINE_SIZE - 1);
 	}
-	else
+
+	return Result + SYNC_UNIX_STATS_SIZE;
+}
+
+/* The first byte of named memory is 0 until its creator initializes the header.  It shares an aligned word with padding, so futexes can wait on the whole word. */
+static void sync_SetUnixNamedMemInit(char *MemPtr)
+{
+	__atomic_store_n(MemPtr, '\x01', __ATOMIC_RELEASE);
+
+#ifdef SYNC_UNIX_FUTEX
+	if (sync_AlignUnixSize(1) >= sizeof(uint32_t))  sync_UnixFutexWake((volatile uint32_t *)MemPtr, INT_MAX);
+#endif
+}
+
+static void sync_WaitUnixNamedMemInit(char *MemPtr)
+{
+	useconds_t Delay = 0;
+
+#ifdef SYNC_UNIX_FUTEX
+	if (sync_AlignUnixSize(1) >= sizeof(uint32_t))
 	{
-		/* Deal with really small name limits with a pseudo-hash. */
-		char Name2[SHM_NAME_MAX], Nums[50];
-		size_t x, x2 = 0, y = strlen(Prefix), z = 0;
+		while (__atomic_load_n(MemPtr, __ATOMIC_ACQUIRE) == '\x00')  sync_UnixFutexWait((volatile uint32_t *)MemPtr, 0, NULL);
+
+		return;
+	}
+#endif
 
-		memset(Name2, 0, sizeof(Name2));
+	/* Yield first, then back off up to 2 ms. */
+	while (__atomic_load_n(MemPtr, __ATOMIC_ACQUIRE) == '\x00')
+	{
+		if (!Delay)
+		{
+			sched_yield();
 
-		for (x = 0; x < y; x++)
+			Delay = 50;
+		}
+		else
 		{
-			Name2[x2] = (char)(((unsigned int)(unsigned char)Name2[x2]) * 37 + ((unsigned int)(unsigned char)Prefix[x]));
-			x2++;
+			usleep(Delay);
 
-			if (x2 == sizeof(Name2) - 1)
-			{
-				x2 = 1;
-				z++;
-			}
+			if (Delay < 2000)  Delay *= 2;
 		}
+	}
+}
 
-		sprintf(Nums, "-%u-%u-", (unsigned int)sync_GetUnixSystemAlignmentSize(), (unsigned int)Size);
+/* Deal with really small name limits with a pseudo-hash.  Size is the full size of the memory, header included.  Name2 must hold SHM_NAME_MAX bytes. */
+void sync_GetUnixNamedMemName(char *Name2, const char *Prefix, const char *Name, size_t Size)
+{
+	char Nums[50];
+	size_t x, x2 = 0, y = strlen(Prefix), z = 0;
 
-		y = strlen(Nums);
-		for (x = 0; x < y; x++)
-		{
-			Name2[x2] = (char)(((unsigned int)(unsigned char)Name2[x2]) * 37 + ((unsigned int)(unsigned char)Nums[x]));
-			x2++;
+	memset(Name2, 0, SHM_NAME_MAX);
 
-			if (x2 == sizeof(Name2) - 1)
-			{
-				x2 = 1;
-				z++;
-			}
-		}
+	for (x = 0; x < y; x++)
+	{
+		Name2[x2] = (char)(((unsigned int)(unsigned char)Name2[x2]) * 37 + ((unsigned int)(unsigned char)Prefix[x]));
+		x2++;
 
-		y = strlen(Name);
-		for (x = 0; x < y; x++)
+		if (x2 == SHM_NAME_MAX - 1)
 		{
-			Name2[x2] = (char)(((unsigned int)(unsigned char)Name2[x2]) * 37 + ((unsigned int)(unsigned char)Name[x]));
-			x2++;
-
-			if (x2 == sizeof(Name2) - 1)
-			{
-				x2 = 1;
-				z++;
-			}
+			x2 = 1;
+			z++;
 		}
+	}
+
+	sprintf(Nums, "-%u-v%u.%u-%u-", (unsigned int)sync_GetUnixSystemAlignmentSize(), (unsigned int)SYNC_UNIX_LAYOUT_VERSION, (unsigned int)SYNC_UNIX_FIELD_ALIGN, (unsigned int)Size);
+
+	y = strlen(Nums);
+	for (x = 0; x < y; x++)
+	{
+		Name2[x2] = (char)(((unsigned int)(unsigned char)Name2[x2]) * 37 + ((unsigned int)(unsigned char)Nums[x]));
+		x2++;
 
-		/* Normalize the alphabet if it looped. */
-		if (z)
+		if (x2 == SHM_NAME_MAX - 1)
 		{
-			unsigned char TempChr;
-			y = (z > 1 ? sizeof(Name2) - 1 : x2);
-			for (x = 1; x < y; x++)
-			{
-				TempChr = ((unsigned char)Name2[x]) & 0x3F;
+			x2 = 1;
+			z++;
+		}
+	}
 
-				if (TempChr < 10)  TempChr += '0';
-				else if (TempChr < 36)  TempChr = TempChr - 10 + 'A';
-				else if (TempChr < 62)  TempChr = TempChr - 36 + 'a';
-				else if (TempChr == 62)  TempChr = '_';
-				else  TempChr = '-';
+	y = strlen(Name);
+	for (x = 0; x < y; x++)
+	{
+		Name2[x2] = (char)(((unsigned int)(unsigned char)Name2[x2]) * 37 + ((unsigned int)(unsigned char)Name[x]));
+		x2++;
 
-				Name2[x] = (char)TempChr;
-			}
+		if (x2 == SHM_NAME_MAX - 1)
+		{
+			x2 = 1;
+			z++;
 		}
+	}
 
-		for (x = 1; x < sizeof(Name2) && Name2[x]; x++)
+	/* Normalize the alphabet if it looped. */
+	if (z)
+	{
+		unsigned char TempChr;
+		y = (z > 1 ? SHM_NAME_MAX - 1 : x2);
+		for (x = 1; x < y; x++)
 		{
-			if (Name2[x] == '\\' || Name2[x] == '/')  Name2[x] = '_';
+			TempChr = ((unsigned char)Name2[x]) & 0x3F;
+
+			if (TempChr < 10)  TempChr += '0';
+			else if (TempChr < 36)  TempChr = TempChr - 10 + 'A';
+			else if (TempChr < 62)  TempChr = TempChr - 36 + 'a';
+			else if (TempChr == 62)  TempChr = '_';
+			else  TempChr = '-';
+
+			Name2[x] = (char)TempChr;
 		}
+	}
+
+	for (x = 1; x < SHM_NAME_MAX && Name2[x]; x++)
+	{
+		if (Name2[x] == '\\' || Name2[x] == '/')  Name2[x] = '_';
+	}
+}
+
+int sync_InitUnixNamedMem(char **ResultMem, size_t *StartPos, const char *Prefix, const char *Name, size_t Size)
+{
+	int Result = -1;
+	*ResultMem = NULL;
+	*StartPos = sync_GetUnixNamedMemHeaderSize(Name != NULL);
+
+	/* First byte indicates initialization status (0 = completely uninitialized, 1 = first mutex initialized, 2 = ready). */
+	/* A creator that dies before the memory is ready leaves it at 1 and the next process to open it starts over. */
+	/* Next few bytes are a shared mutex object, a reference count, and the options the object was created with, padded to a cache line. */
+	/* Contention statistics come next (unnamed memory only has these). */
+	/* Size bytes follow for whatever. */
+	Size += *StartPos;
+	Size = sync_AlignUnixSize(Size);
+
+	if (Name == NULL)
+	{
+		*ResultMem = (char *)ecalloc(1, Size);
+
+		Result = 0;
+	}
+	else
+	{
+		char Name2[SHM_NAME_MAX];
+
+		sync_GetUnixNamedMemName(Name2, Prefix, Name, Size);
 
 		pthread_mutex_t *MutexPtr;
 		uint32_t *RefCountPtr;
@@ -265,8 +538,7 @@ int sync_InitUnixNamedMem(char **ResultMem, size_t *StartPos, const char *Prefix
 			{
 				pthread_mutexattr_t MutexAttr;
 
-				pthread_mutexattr_init(&MutexAttr);
-				pthread_mutexattr_setpshared(&MutexAttr, PTHREAD_PROCESS_SHARED);
+				sync_InitUnixMutexAttr(&MutexAttr, 1);
 
 				MutexPtr = (pthread_mutex_t *)((*ResultMem) + sync_AlignUnixSize(1));
 				RefCountPtr = (uint32_t *)((*ResultMem) + sync_AlignUnixSize(1) + sync_AlignUnixSize(sizeof(pthread_mutex_t)));
@@ -274,8 +546,8 @@ int sync_InitUnixNamedMem(char **ResultMem, size_t *StartPos, const char *Prefix
 				pthread_mutex_init(MutexPtr, &MutexAttr);
 				pthread_mutex_lock(MutexPtr);
 
-				(*ResultMem)[0] = '\x01';
 				RefCountPtr[0] = 1;
+				sync_SetUnixNamedMemInit(*ResultMem);
 
 				Result = 0;
 			}
@@ -298,13 +570,7 @@ int sync_InitUnixNamedMem(char **ResultMem, size_t *StartPos, const char *Prefix
 				else
 				{
 					/* Wait until the space is fully initialized. */
-					if ((*ResultMem)[0] == '\x00')
-					{
-						while ((*ResultMem)[0] == '\x00')
-						{
-							usleep(2000);
-						}
-					}
+					sync_WaitUnixNamedMemInit(*ResultMem);
 
 					char *MemPtr = (*ResultMem) + sync_AlignUnixSize(1);
 					MutexPtr = (pthread_mutex_t *)(MemPtr);
@@ -313,13 +579,23 @@ int sync_InitUnixNamedMem(char **ResultMem, size_t *StartPos, const char *Prefix
 					RefCountPtr = (uint32_t *)(MemPtr);
 					MemPtr += sync_AlignUnixSize(sizeof(uint32_t));
 
+#ifdef HAVE_PTHREAD_MUTEXATTR_SETROBUST
+					/* The previous holder of the mutex died.  If it was the creator, the memory was never initialized and its reference doesn't count. */
+					if (pthread_mutex_lock(MutexPtr) == EOWNERDEAD)
+					{
+						sync_RecoverUnixMutex(MutexPtr, EOWNERDEAD);
+
+						if ((*ResultMem)[0] != '\x02')  RefCountPtr[0] = 0;
+					}
+#else
 					pthread_mutex_lock(MutexPtr);
+#endif
 
 					if (RefCountPtr[0])  Result = 1;
 					else
 					{
 						/* If this is the first reference, reset the RAM to 0's for platform consistency to force a rebuild of the object. */
-						memset(MemPtr, 0, Size);
+						memset(MemPtr, 0, Size - (size_t)(MemPtr - (*ResultMem)));
 
 						Result = 0;
 					}
@@ -341,6 +617,8 @@ int sync_InitUnixNamedMem(char **ResultMem, size_t *StartPos, const char *Prefix
 
 void sync_UnixNamedMemReady(char *MemPtr)
 {
+	MemPtr[0] = '\x02';
+
 	pthread_mutex_unlock((pthread_mutex_t *)(MemPtr + sync_AlignUnixSize(1)));
 }
 
@@ -355,486 +633,3661 @@ void sync_UnmapUnixNamedMem(char *MemPtr, size_t Size)
 
 	RefCountPtr = (uint32_t *)(MemPtr2);
 
-	pthread_mutex_lock(MutexPtr);
+	sync_RecoverUnixMutex(MutexPtr, pthread_mutex_lock(MutexPtr));
 	if (RefCountPtr[0])  RefCountPtr[0]--;
 	pthread_mutex_unlock(MutexPtr);
 
-	munmap(MemPtr, sync_AlignUnixSize(1) + sync_AlignUnixSize(sizeof(pthread_mutex_t)) + sync_AlignUnixSize(sizeof(uint32_t)) + Size);
+	munmap(MemPtr, sync_AlignUnixSize(sync_GetUnixNamedMemHeaderSize(1) + Size));
 }
 
-/* Basic *NIX Semaphore functions. */
-size_t sync_GetUnixSemaphoreSize()
+/* Names are identified in traces and the named memory cache by their FNV-1a hash.  Unnamed objects are 0. */
+uint32_t sync_GetUnixNameHash(const char *Name)
 {
-	return sync_AlignUnixSize(sizeof(pthread_mutex_t)) + sync_AlignUnixSize(sizeof(uint32_t)) + sync_AlignUnixSize(sizeof(uint32_t)) + sync_AlignUnixSize(sizeof(pthread_cond_t));
+	uint32_t Result = 2166136261U;
+
+	if (Name == NULL)  return 0;
+
+	for (; *Name; Name++)  Result = (Result ^ (uint32_t)(unsigned char)*Name) * 16777619U;
+
+	return Result;
 }
 
-void sync_GetUnixSemaphore(sync_UnixSemaphoreWrapper *Result, char *Mem)
+/* Process-wide cache of named memory (sync.cache_size).  Keeps mappings and their reference alive between requests so reopening a name skips shm_open(), mmap(), and munmap(). */
+typedef struct _sync_UnixNamedMemCacheEntry {
+	char *MxKey;
+	uint32_t MxHash;
+	size_t MxSize;
+	char *MxMem;
+	size_t MxPos;
+	uint32_t MxUsers;
+	uint64_t MxLastUsed;
+} sync_UnixNamedMemCacheEntry;
+
+static pthread_mutex_t sync_UnixNamedMemCacheMutex = PTHREAD_MUTEX_INITIALIZER;
+static sync_UnixNamedMemCacheEntry *sync_UnixNamedMemCache = NULL;
+static uint32_t sync_UnixNamedMemCacheNum = 0, sync_UnixNamedMemCacheMax = 0;
+static uint64_t sync_UnixNamedMemCacheTTL = 0;
+
+/* Drops an entry and its reference to the named memory.  The cache mutex must be held. */
+static void sync_RemoveUnixNamedMemCacheEntry(uint32_t Num)
 {
-	Result->MxMutex = (pthread_mutex_t *)(Mem);
-	Mem += sync_AlignUnixSize(sizeof(pthread_mutex_t));
-
-	Result->MxCount = (uint32_t *)(Mem);
-	Mem += sync_AlignUnixSize(sizeof(uint32_t));
+	sync_UnixNamedMemCacheEntry *Entry = &sync_UnixNamedMemCache[Num];
 
-	Result->MxMax = (uint32_t *)(Mem);
-	Mem += sync_AlignUnixSize(sizeof(uint32_t));
+	sync_UnmapUnixNamedMem(Entry->MxMem, Entry->MxSize);
+	pefree(Entry->MxKey, 1);
 
-	Result->MxCond = (pthread_cond_t *)(Mem);
+	sync_UnixNamedMemCacheNum--;
+	if (Num < sync_UnixNamedMemCacheNum)  *Entry = sync_UnixNamedMemCache[sync_UnixNamedMemCacheNum];
 }
 
-void sync_InitUnixSemaphore(sync_UnixSemaphoreWrapper *UnixSemaphore, int Shared, uint32_t Start, uint32_t Max)
+/* Drops unused entries that have been idle longer than sync.cache_ttl.  The cache mutex must be held. */
+static void sync_ExpireUnixNamedMemCache(uint64_t CurrTime)
 {
-	pthread_mutexattr_t MutexAttr;
-	pthread_condattr_t CondAttr;
+	uint32_t x = 0;
 
-	pthread_mutexattr_init(&MutexAttr);
-	pthread_condattr_init(&CondAttr);
+	if (!sync_UnixNamedMemCacheTTL)  return;
 
-	if (Shared)
+	while (x < sync_UnixNamedMemCacheNum)
 	{
-		pthread_mutexattr_setpshared(&MutexAttr, PTHREAD_PROCESS_SHARED);
-		pthread_condattr_setpshared(&CondAttr, PTHREAD_PROCESS_SHARED);
+		if (!sync_UnixNamedMemCache[x].MxUsers && CurrTime - sync_UnixNamedMemCache[x].MxLastUsed > sync_UnixNamedMemCacheTTL)  sync_RemoveUnixNamedMemCacheEntry(x);
+		else  x++;
 	}
-
-	pthread_mutex_init(UnixSemaphore->MxMutex, &MutexAttr);
-	if (Start > Max)  Start = Max;
-	UnixSemaphore->MxCount[0] = Start;
-	UnixSemaphore->MxMax[0] = Max;
-	pthread_cond_init(UnixSemaphore->MxCond, &CondAttr);
-
-	pthread_condattr_destroy(&CondAttr);
-	pthread_mutexattr_destroy(&MutexAttr);
 }
 
-int sync_WaitForUnixSemaphore(sync_UnixSemaphoreWrapper *UnixSemaphore, uint32_t Wait)
+/* Same as sync_InitUnixNamedMem() but named memory comes from the cache when possible.  Release with sync_CloseUnixNamedMem(). */
+int sync_OpenUnixNamedMem(char **ResultMem, size_t *StartPos, const char *Prefix, const char *Name, size_t Size)
 {
-	if (Wait == 0)
-	{
-		/* Avoid the scenario of deadlock on the semaphore itself for 0 wait. */
-		if (pthread_mutex_trylock(UnixSemaphore->MxMutex) != 0)  return 0;
-	}
-	else
-	{
-		if (pthread_mutex_lock(UnixSemaphore->MxMutex) != 0)  return 0;
-	}
+	sync_UnixNamedMemCacheEntry *Entry;
+	uint32_t Hash, x, y;
+	uint64_t CurrTime;
+	size_t PrefixLen;
+	int Result;
 
-	int Result = 0;
+	if (Name == NULL || !sync_UnixNamedMemCacheMax)  return sync_InitUnixNamedMem(ResultMem, StartPos, Prefix, Name, Size);
 
-	if (UnixSemaphore->MxCount[0])
-	{
-		UnixSemaphore->MxCount[0]--;
+	Hash = sync_GetUnixNameHash(Name);
+	PrefixLen = strlen(Prefix);
+	CurrTime = sync_GetCoarseMonotonicTime();
 
-		Result = 1;
-	}
-	else if (Wait == INFINITE)
+	pthread_mutex_lock(&sync_UnixNamedMemCacheMutex);
+
+	sync_ExpireUnixNamedMemCache(CurrTime);
+
+	for (x = 0; x < sync_UnixNamedMemCacheNum; x++)
 	{
-		int Result2;
-		do
-		{
-			Result2 = pthread_cond_wait(UnixSemaphore->MxCond, UnixSemaphore->MxMutex);
-			if (Result2 != 0)  break;
-		} while (!UnixSemaphore->MxCount[0]);
+		Entry = &sync_UnixNamedMemCache[x];
 
-		if (Result2 == 0)
+		if (Entry->MxHash == Hash && Entry->MxSize == Size && !strcmp(Entry->MxKey, Prefix) && !strcmp(Entry->MxKey + PrefixLen + 1, Name))
 		{
-			UnixSemaphore->MxCount[0]--;
+			Entry->MxUsers++;
+			Entry->MxLastUsed = CurrTime;
 
-			Result = 1;
+			*ResultMem = Entry->MxMem;
+			*StartPos = Entry->MxPos;
+
+			pthread_mutex_unlock(&sync_UnixNamedMemCacheMutex);
+
+			/* Another thread may still be initializing the object.  The initialization mutex is held until it is ready. */
+			sync_RecoverUnixMutex((pthread_mutex_t *)((*ResultMem) + sync_AlignUnixSize(1)), pthread_mutex_lock((pthread_mutex_t *)((*ResultMem) + sync_AlignUnixSize(1))));
+			pthread_mutex_unlock((pthread_mutex_t *)((*ResultMem) + sync_AlignUnixSize(1)));
+
+			return 1;
 		}
 	}
-	else if (Wait == 0)
+
+	pthread_mutex_unlock(&sync_UnixNamedMemCacheMutex);
+
+	/* Opening may wait on another process, so don't hold the cache mutex. */
+	Result = sync_InitUnixNamedMem(ResultMem, StartPos, Prefix, Name, Size);
+	if (Result < 0)  return Result;
+
+	pthread_mutex_lock(&sync_UnixNamedMemCacheMutex);
+
+	/* Make room by dropping the least recently used entry that nothing is using.  If everything is in use, the memory just isn't cached. */
+	if (sync_UnixNamedMemCacheNum == sync_UnixNamedMemCacheMax)
 	{
-		/* Failed to obtain lock.  Nothing to do. */
+		y = sync_UnixNamedMemCacheNum;
+		for (x = 0; x < sync_UnixNamedMemCacheNum; x++)
+		{
+			if (!sync_UnixNamedMemCache[x].MxUsers && (y == sync_UnixNamedMemCacheNum || sync_UnixNamedMemCache[x].MxLastUsed < sync_UnixNamedMemCache[y].MxLastUsed))  y = x;
+		}
+
+		if (y < sync_UnixNamedMemCacheNum)  sync_RemoveUnixNamedMemCacheEntry(y);
 	}
-	else
+
+	if (sync_UnixNamedMemCacheNum < sync_UnixNamedMemCacheMax)
 	{
-		struct timespec TempTime;
+		Entry = &sync_UnixNamedMemCache[sync_UnixNamedMemCacheNum];
 
-		if (sync_CSGX__ClockGetTimeRealtime(&TempTime) == -1)  return 0;
-		TempTime.tv_sec += Wait / 1000;
-		TempTime.tv_nsec += (Wait % 1000) * 1000000;
-		TempTime.tv_sec += TempTime.tv_nsec / 1000000000;
-		TempTime.tv_nsec = TempTime.tv_nsec % 1000000000;
+		Entry->MxKey = (char *)pemalloc(PrefixLen + 1 + strlen(Name) + 1, 1);
+		strcpy(Entry->MxKey, Prefix);
+		strcpy(Entry->MxKey + PrefixLen + 1, Name);
 
-		int Result2;
-		do
-		{
-			/* Some platforms have pthread_cond_timedwait() but not pthread_mutex_timedlock() or sem_timedwait() (e.g. Mac OSX). */
-			Result2 = pthread_cond_timedwait(UnixSemaphore->MxCond, UnixSemaphore->MxMutex, &TempTime);
-			if (Result2 != 0)  break;
-		} while (!UnixSemaphore->MxCount[0]);
-
-		if (Result2 == 0)
-		{
-			UnixSemaphore->MxCount[0]--;
+		Entry->MxHash = Hash;
+		Entry->MxSize = Size;
+		Entry->MxMem = *ResultMem;
+		Entry->MxPos = *StartPos;
+		Entry->MxUsers = 1;
+		Entry->MxLastUsed = CurrTime;
 
-			Result = 1;
-		}
+		sync_UnixNamedMemCacheNum++;
 	}
 
-	pthread_mutex_unlock(UnixSemaphore->MxMutex);
+	pthread_mutex_unlock(&sync_UnixNamedMemCacheMutex);
 
 	return Result;
 }
 
-int sync_ReleaseUnixSemaphore(sync_UnixSemaphoreWrapper *UnixSemaphore, uint32_t *PrevVal)
+/* Releases named memory from sync_OpenUnixNamedMem().  Cached memory stays mapped. */
+void sync_CloseUnixNamedMem(char *MemPtr, size_t Size)
 {
-	if (pthread_mutex_lock(UnixSemaphore->MxMutex) != 0)  return 0;
+	uint32_t x;
 
-	if (PrevVal != NULL)  *PrevVal = UnixSemaphore->MxCount[0];
-	UnixSemaphore->MxCount[0]++;
-	if (UnixSemaphore->MxCount[0] > UnixSemaphore->MxMax[0])  UnixSemaphore->MxCount[0] = UnixSemaphore->MxMax[0];
+	if (sync_UnixNamedMemCacheMax)
+	{
+		pthread_mutex_lock(&sync_UnixNamedMemCacheMutex);
 
-	/* Let a waiting thread have at it. */
-	pthread_cond_signal(UnixSemaphore->MxCond);
+		for (x = 0; x < sync_UnixNamedMemCacheNum && sync_UnixNamedMemCache[x].MxMem != MemPtr; x++)
+		{
+		}
 
-	pthread_mutex_unlock(UnixSemaphore->MxMutex);
+		if (x < sync_UnixNamedMemCacheNum)
+		{
+			if (sync_UnixNamedMemCache[x].MxUsers)  sync_UnixNamedMemCache[x].MxUsers--;
+			sync_UnixNamedMemCache[x].MxLastUsed = sync_GetCoarseMonotonicTime();
 
-	return 1;
+			sync_ExpireUnixNamedMemCache(sync_UnixNamedMemCache[x].MxLastUsed);
+
+			pthread_mutex_unlock(&sync_UnixNamedMemCacheMutex);
+
+			return;
+		}
+
+		pthread_mutex_unlock(&sync_UnixNamedMemCacheMutex);
+	}
+
+	sync_UnmapUnixNamedMem(MemPtr, Size);
 }
 
-void sync_FreeUnixSemaphore(sync_UnixSemaphoreWrapper *UnixSemaphore)
+/* A forked child inherits the cached mappings but not references to them.  Take one per entry so the child can drop them later. */
+static void sync_UnixNamedMemCacheAtForkPrepare()
 {
-	pthread_mutex_destroy(UnixSemaphore->MxMutex);
-	pthread_cond_destroy(UnixSemaphore->MxCond);
+	pthread_mutex_lock(&sync_UnixNamedMemCacheMutex);
 }
 
-/* Basic *NIX Event functions. */
-size_t sync_GetUnixEventSize()
+static void sync_UnixNamedMemCacheAtForkParent()
 {
-	return sync_AlignUnixSize(sizeof(pthread_mutex_t)) + sync_AlignUnixSize(2) + sync_AlignUnixSize(sizeof(uint32_t)) + sync_AlignUnixSize(sizeof(pthread_cond_t));
+	pthread_mutex_unlock(&sync_UnixNamedMemCacheMutex);
 }
 
-void sync_GetUnixEvent(sync_UnixEventWrapper *Result, char *Mem)
+static void sync_UnixNamedMemCacheAtForkChild()
 {
-	Result->MxMutex = (pthread_mutex_t *)(Mem);
-	Mem += sync_AlignUnixSize(sizeof(pthread_mutex_t));
+	pthread_mutex_t *MutexPtr;
+	uint32_t x;
 
-	Result->MxManual = Mem;
-	Result->MxSignaled = Mem + 1;
-	Mem += sync_AlignUnixSize(2);
+	for (x = 0; x < sync_UnixNamedMemCacheNum; x++)
+	{
+		MutexPtr = (pthread_mutex_t *)(sync_UnixNamedMemCache[x].MxMem + sync_AlignUnixSize(1));
 
-	Result->MxWaiting = (uint32_t *)(Mem);
-	Mem += sync_AlignUnixSize(sizeof(uint32_t));
+		sync_RecoverUnixMutex(MutexPtr, pthread_mutex_lock(MutexPtr));
+		((uint32_t *)(sync_UnixNamedMemCache[x].MxMem + sync_AlignUnixSize(1) + sync_AlignUnixSize(sizeof(pthread_mutex_t))))[0]++;
+		pthread_mutex_unlock(MutexPtr);
+	}
 
-	Result->MxCond = (pthread_cond_t *)(Mem);
+	pthread_mutex_unlock(&sync_UnixNamedMemCacheMutex);
 }
 
-void sync_InitUnixEvent(sync_UnixEventWrapper *UnixEvent, int Shared, int Manual, int Signaled)
+void sync_InitUnixNamedMemCache(uint32_t MaxEntries, uint64_t TTL)
 {
-	pthread_mutexattr_t MutexAttr;
-	pthread_condattr_t CondAttr;
+	static int AtFork = 0;
 
-	pthread_mutexattr_init(&MutexAttr);
-	pthread_condattr_init(&CondAttr);
+	sync_UnixNamedMemCacheMax = MaxEntries;
+	sync_UnixNamedMemCacheTTL = TTL;
 
-	if (Shared)
+	if (!MaxEntries)  return;
+
+	sync_UnixNamedMemCache = (sync_UnixNamedMemCacheEntry *)pemalloc(sizeof(sync_UnixNamedMemCacheEntry) * MaxEntries, 1);
+
+	/* Module startup can run more than once per process (e.g. Apache restarts). */
+	if (!AtFork)
 	{
-		pthread_mutexattr_setpshared(&MutexAttr, PTHREAD_PROCESS_SHARED);
-		pthread_condattr_setpshared(&CondAttr, PTHREAD_PROCESS_SHARED);
+		pthread_atfork(sync_UnixNamedMemCacheAtForkPrepare, sync_UnixNamedMemCacheAtForkParent, sync_UnixNamedMemCacheAtForkChild);
+
+		AtFork = 1;
 	}
+}
 
-	pthread_mutex_init(UnixEvent->MxMutex, &MutexAttr);
-	UnixEvent->MxManual[0] = (Manual ? '\x01' : '\x00');
-	UnixEvent->MxSignaled[0] = (Signaled ? '\x01' : '\x00');
-	UnixEvent->MxWaiting[0] = 0;
-	pthread_cond_init(UnixEvent->MxCond, &CondAttr);
+void sync_FreeUnixNamedMemCache()
+{
+	pthread_mutex_lock(&sync_UnixNamedMemCacheMutex);
 
-	pthread_condattr_destroy(&CondAttr);
-	pthread_mutexattr_destroy(&MutexAttr);
+	while (sync_UnixNamedMemCacheNum)  sync_RemoveUnixNamedMemCacheEntry(sync_UnixNamedMemCacheNum - 1);
+
+	if (sync_UnixNamedMemCache != NULL)  pefree(sync_UnixNamedMemCache, 1);
+	sync_UnixNamedMemCache = NULL;
+	sync_UnixNamedMemCacheMax = 0;
+
+	pthread_mutex_unlock(&sync_UnixNamedMemCacheMutex);
 }
 
-int sync_WaitForUnixEvent(sync_UnixEventWrapper *UnixEvent, uint32_t Wait)
+/* Unnamed shared memory is an anonymous shared mapping.  Forked children inherit it, so it synchronizes a process and its children without a name. */
+/* It has the same layout as unnamed memory (no init mutex or reference count) and the kernel frees it when the last process unmaps it. */
+int sync_InitUnixSharedMem(char **ResultMem, size_t *StartPos, size_t Size)
 {
-	if (Wait == 0)
-	{
-		/* Avoid the scenario of deadlock on the semaphore itself for 0 wait. */
-		if (pthread_mutex_trylock(UnixEvent->MxMutex) != 0)  return 0;
-	}
-	else
+	*StartPos = sync_GetUnixNamedMemHeaderSize(0);
+
+	*ResultMem = (char *)mmap(NULL, sync_AlignUnixSize(*StartPos + Size), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (*ResultMem == MAP_FAILED)
 	{
-		if (pthread_mutex_lock(UnixEvent->MxMutex) != 0)  return 0;
+		*ResultMem = NULL;
+
+		return -1;
 	}
 
-	int Result = 0;
+	return 0;
+}
 
-	/* Avoid a potential starvation issue by only allowing signaled manual events OR if there are no other waiting threads. */
-	if (UnixEvent->MxSignaled[0] != '\x00' && (UnixEvent->MxManual[0] != '\x00' || !UnixEvent->MxWaiting[0]))
+void sync_FreeUnixSharedMem(char *MemPtr, size_t Size)
+{
+	munmap(MemPtr, sync_AlignUnixSize(sync_GetUnixNamedMemHeaderSize(0) + Size));
+}
+
+/* Where an object's memory came from. */
+#define SYNC_UNIX_MEM_PRIVATE          0
+#define SYNC_UNIX_MEM_NAMED            1
+#define SYNC_UNIX_MEM_SHARED           2
+
+/* Opens the memory for a named or unnamed object.  Unnamed objects get shared memory when Shared is set. */
+int sync_OpenUnixObjectMem(char **ResultMem, size_t *StartPos, int *MemType, const char *Prefix, const char *Name, int Shared, size_t Size)
+{
+	if (Name == NULL && Shared)
 	{
-		/* Reset auto events. */
-		if (UnixEvent->MxManual[0] == '\x00')  UnixEvent->MxSignaled[0] = '\x00';
+		*MemType = SYNC_UNIX_MEM_SHARED;
 
-		Result = 1;
+		return sync_InitUnixSharedMem(ResultMem, StartPos, Size);
 	}
-	else if (Wait == INFINITE)
-	{
-		UnixEvent->MxWaiting[0]++;
 
-		int Result2;
-		do
-		{
-			Result2 = pthread_cond_wait(UnixEvent->MxCond, UnixEvent->MxMutex);
-			if (Result2 != 0)  break;
-		} while (UnixEvent->MxSignaled[0] == '\x00');
+	*MemType = (Name != NULL ? SYNC_UNIX_MEM_NAMED : SYNC_UNIX_MEM_PRIVATE);
 
-		UnixEvent->MxWaiting[0]--;
+	return sync_OpenUnixNamedMem(ResultMem, StartPos, Prefix, Name, Size);
+}
 
-		if (Result2 == 0)
-		{
-			/* Reset auto events. */
-			if (UnixEvent->MxManual[0] == '\x00')  UnixEvent->MxSignaled[0] = '\x00';
+/* Options that change how an object's memory is used (e.g. fair mode) are recorded by its creator, since they aren't part of the name.  Returns 0 if the object exists with different options. */
+int sync_CheckUnixObjectOptions(char *MemPtr, int MemType, int Created, uint64_t Options)
+{
+	uint64_t *OptionsPtr;
 
-			Result = 1;
-		}
-	}
-	else if (Wait == 0)
-	{
-		/* Failed to obtain lock.  Nothing to do. */
-	}
-	else
+	if (MemType != SYNC_UNIX_MEM_NAMED)  return 1;
+
+	OptionsPtr = (uint64_t *)(MemPtr + sync_AlignUnixSize(1) + sync_AlignUnixSize(sizeof(pthread_mutex_t)) + sync_AlignUnixSize(sizeof(uint32_t)));
+
+	if (Created)
 	{
-		struct timespec TempTime;
+		OptionsPtr[0] = Options;
 
-		if (sync_CSGX__ClockGetTimeRealtime(&TempTime) == -1)
-		{
-			pthread_mutex_unlock(UnixEvent->MxMutex);
+		return 1;
+	}
 
-			return 0;
-		}
+	return (OptionsPtr[0] == Options);
+}
 
-		TempTime.tv_sec += Wait / 1000;
-		TempTime.tv_nsec += (Wait % 1000) * 1000000;
-		TempTime.tv_sec += TempTime.tv_nsec / 1000000000;
-		TempTime.tv_nsec = TempTime.tv_nsec % 1000000000;
+/* Returns 0 for private memory, which the caller frees after destroying the objects in it. */
+/* Objects in shared memory are never destroyed since other processes may still be using them. */
+int sync_CloseUnixObjectMem(char *MemPtr, int MemType, size_t Size)
+{
+	if (MemType == SYNC_UNIX_MEM_NAMED)  sync_CloseUnixNamedMem(MemPtr, Size);
+	else if (MemType == SYNC_UNIX_MEM_SHARED)  sync_FreeUnixSharedMem(MemPtr, Size);
+	else  return 0;
 
-		UnixEvent->MxWaiting[0]++;
+	return 1;
+}
 
-		int Result2;
-		do
-		{
-			/* Some platforms have pthread_cond_timedwait() but not pthread_mutex_timedlock() or sem_timedwait() (e.g. Mac OSX). */
-			Result2 = pthread_cond_timedwait(UnixEvent->MxCond, UnixEvent->MxMutex, &TempTime);
-			if (Result2 != 0)  break;
-		} while (UnixEvent->MxSignaled[0] == '\x00');
+/* Bumped in every forked child.  Objects compare it against their own copy to notice that their lock state was inherited from the parent. */
+static volatile uint32_t sync_UnixForkGeneration = 0;
 
-		UnixEvent->MxWaiting[0]--;
+/* Identifies this process as a lock owner.  Calculated on first use. */
+static uint64_t sync_UnixProcessOwner = 0;
 
-		if (Result2 == 0)
-		{
-			/* Reset auto events. */
-			if (UnixEvent->MxManual[0] == '\x00')  UnixEvent->MxSignaled[0] = '\x00';
+static void sync_UnixAtForkChild()
+{
+	sync_UnixForkGeneration++;
+	sync_UnixProcessOwner = 0;
+}
 
-			Result = 1;
-		}
-	}
+void sync_InitUnixForkGeneration()
+{
+	static int AtFork = 0;
 
-	pthread_mutex_unlock(UnixEvent->MxMutex);
+	/* Module startup can run more than once per process (e.g. Apache restarts). */
+	if (!AtFork)
+	{
+		pthread_atfork(NULL, NULL, sync_UnixAtForkChild);
 
-	return Result;
+		AtFork = 1;
+	}
 }
 
-int sync_FireUnixEvent(sync_UnixEventWrapper *UnixEvent)
+/* Returns whether process-local lock state was inherited through fork() and updates the copy.  Only the parent can release inherited locks. */
+static inline int sync_IsUnixForkedState(uint32_t *ForkGen)
 {
-	if (pthread_mutex_lock(UnixEvent->MxMutex) != 0)  return 0;
-
-	UnixEvent->MxSignaled[0] = '\x01';
+	uint32_t CurrGen = sync_UnixForkGeneration;
 
-	/* Let all waiting threads through for manual events, otherwise just one waiting thread (if any). */
-	if (UnixEvent->MxManual[0] != '\x00')  pthread_cond_broadcast(UnixEvent->MxCond);
-	else  pthread_cond_signal(UnixEvent->MxCond);
+	if (*ForkGen == CurrGen)  return 0;
 
-	pthread_mutex_unlock(UnixEvent->MxMutex);
+	*ForkGen = CurrGen;
 
 	return 1;
 }
 
-/* Only call for manual events. */
-int sync_ResetUnixEvent(sync_UnixEventWrapper *UnixEvent)
+/* Returns the low 32 bits of a process' start time or 0 if the platform doesn't say.  Sets Zombie for processes that have exited but haven't been reaped. */
+static uint32_t sync_GetUnixProcessStartTime(pid_t Pid, int *Zombie)
 {
-	if (UnixEvent->MxManual[0] == '\x00')  return 0;
-	if (pthread_mutex_lock(UnixEvent->MxMutex) != 0)  return 0;
+#ifdef __linux__
+	char Filename[64], Buffer[1024], *Pos;
+	ssize_t Len;
+	int fp, x;
 
-	UnixEvent->MxSignaled[0] = '\x00';
+	sprintf(Filename, "/proc/%u/stat", (unsigned int)Pid);
+	fp = open(Filename, O_RDONLY);
+	if (fp < 0)  return 0;
 
-	pthread_mutex_unlock(UnixEvent->MxMutex);
+	Len = read(fp, Buffer, sizeof(Buffer) - 1);
+	close(fp);
+	if (Len <= 0)  return 0;
+	Buffer[Len] = '\0';
 
-	return 1;
+	/* The command name can contain anything, so start after the last parenthesis.  The state is next and the start time is 19 fields after it. */
+	Pos = strrchr(Buffer, ')');
+	if (Pos == NULL || Pos[1] != ' ')  return 0;
+	Pos += 2;
+
+	if (Zombie != NULL)  *Zombie = (Pos[0] == 'Z' || Pos[0] == 'X');
+
+	for (x = 0; x < 19 && Pos != NULL; x++)
+	{
+		Pos = strchr(Pos, ' ');
+		if (Pos != NULL)  Pos++;
+	}
+
+	if (Pos == NULL)  return 0;
+
+	return (uint32_t)strtoull(Pos, NULL, 10);
+#else
+	return 0;
+#endif
 }
 
-void sync_FreeUnixEvent(sync_UnixEventWrapper *UnixEvent)
+/* Lock owners are the process ID in the high 32 bits and part of the process' start time in the low 32 bits, so a reused process ID doesn't look like the owner. */
+uint64_t sync_GetUnixProcessOwner()
 {
-	pthread_mutex_destroy(UnixEvent->MxMutex);
-	pthread_cond_destroy(UnixEvent->MxCond);
+	pid_t Pid;
+
+	if (!sync_UnixProcessOwner)
+	{
+		Pid = getpid();
+		sync_UnixProcessOwner = ((uint64_t)(uint32_t)Pid << 32) | (uint64_t)sync_GetUnixProcessStartTime(Pid, NULL);
+	}
+
+	return sync_UnixProcessOwner;
 }
 
-#endif
+/* Processes owned by another user still count as alive. */
+int sync_IsUnixOwnerAlive(uint64_t Owner)
+{
+	pid_t Pid = (pid_t)(uint32_t)(Owner >> 32);
+	uint32_t StartTime;
+	int Zombie = 0;
 
+	if (kill(Pid, 0) == -1 && errno == ESRCH)  return 0;
 
-/* {{{ PHP 5 and 7 crossover compatibility defines and functions */
-#if PHP_MAJOR_VERSION >= 7
+	StartTime = sync_GetUnixProcessStartTime(Pid, &Zombie);
+	if (Zombie)  return 0;
+	if ((uint32_t)Owner && StartTime && StartTime != (uint32_t)Owner)  return 0;
 
-#define PORTABLE_new_zend_object_func(funcname)   zend_object *funcname(zend_class_entry *ce)
-#define PORTABLE_new_zend_object_return_var
-#define PORTABLE_new_zend_object_return_var_ref   NULL
-#define PORTABLE_allocate_zend_object(size, ce)   ecalloc(1, (size) + zend_object_properties_size(ce));
-#define PORTABLE_new_zend_object_return(std)   return (std)
+	return 1;
+}
 
-void PORTABLE_InitZendObject(void *obj, zend_object *std, void *unused1, void *FreeFunc, zend_object_handlers *Handlers, zend_class_entry *ce TSRMLS_DC)
+/* Returns the contention statistics in front of the memory at StartPos. */
+char *sync_GetUnixNamedMemStats(char *MemPtr, size_t StartPos)
 {
-	/* Initialize Zend. */
-	zend_object_std_init(std, ce TSRMLS_CC);
-	object_properties_init(std, ce);
-
-	/* Initialize destructor callback. */
-	std->handlers = Handlers;
+	return MemPtr + StartPos - SYNC_UNIX_STATS_SIZE;
 }
 
-typedef zend_long   PORTABLE_ZPP_ARG_long;
-typedef size_t   PORTABLE_ZPP_ARG_size;
-typedef zval *   PORTABLE_ZPP_ARG_zval_ref;
-#define PORTABLE_ZPP_ARG_zval_ref_deref(var)   var
+static inline sync_UnixStatsSlot *sync_GetUnixStatsSlot(char *Stats)
+{
+	return (sync_UnixStatsSlot *)(Stats + (sync_GetUnixCpuSlot() % SYNC_UNIX_STATS_SLOTS) * SYNC_UNIX_CACHE_LINE_SIZE);
+}
 
-static inline void *PHP_7_zend_object_to_object(zend_object *std)
+static inline void sync_UpdateUnixStatsMax(volatile uint64_t *Max, uint64_t Val)
 {
-	return (void *)((char *)std - std->handlers->offset);
+	uint64_t CurrVal = __atomic_load_n(Max, __ATOMIC_RELAXED);
+
+	while (Val > CurrVal && !__atomic_compare_exchange_n(Max, &CurrVal, Val, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	{
+	}
 }
 
-#define PORTABLE_zend_object_store_get_object()   PHP_7_zend_object_to_object(Z_OBJ_P(getThis()))
+/* Optional log-linear (HDR-style) histograms.  Each power of two is split into 8 buckets, so values are accurate to within 12.5%. */
+#define SYNC_UNIX_HISTOGRAM_SUB_BITS   3
 
-#define PORTABLE_free_zend_object_func(funcname)   void funcname(zend_object *object)
-#define PORTABLE_free_zend_object_get_object(object)   PHP_7_zend_object_to_object(object)
-#define PORTABLE_free_zend_object_free_object(obj)   zend_object_std_dtor(&obj->std);
+static inline uint32_t sync_GetUnixHistogramBucket(uint64_t Val)
+{
+	uint32_t Exp, Bucket;
 
-#define PORTABLE_RETURN_STRINGL(str, len)   RETURN_STRINGL(str, len)
+	if (Val < (1 << SYNC_UNIX_HISTOGRAM_SUB_BITS))  return (uint32_t)Val;
 
-#else
+	Exp = 63 - (uint32_t)__builtin_clzll(Val);
+	Bucket = ((Exp - SYNC_UNIX_HISTOGRAM_SUB_BITS + 1) << SYNC_UNIX_HISTOGRAM_SUB_BITS) + (uint32_t)((Val >> (Exp - SYNC_UNIX_HISTOGRAM_SUB_BITS)) & ((1 << SYNC_UNIX_HISTOGRAM_SUB_BITS) - 1));
 
-#define PORTABLE_new_zend_object_func(funcname)   zend_object_value funcname(zend_class_entry *ce TSRMLS_DC)
-#define PORTABLE_new_zend_object_return_var   zend_object_value retval
-#define PORTABLE_new_zend_object_return_var_ref   &retval
-#define PORTABLE_new_zend_object_return(std)   return retval
-#define PORTABLE_allocate_zend_object(size, ce)   ecalloc(1, (size));
+	return (Bucket < SYNC_UNIX_HISTOGRAM_BUCKETS ? Bucket : SYNC_UNIX_HISTOGRAM_BUCKETS - 1);
+}
 
-void PORTABLE_InitZendObject(void *obj, zend_object *std, zend_object_value *retval, zend_objects_free_object_storage_t FreeFunc, zend_object_handlers *Handlers, zend_class_entry *ce TSRMLS_DC)
+/* Returns the highest value that lands in a bucket. */
+uint64_t sync_GetUnixHistogramBucketMax(uint32_t Bucket)
 {
-#if PHP_VERSION_ID < 50399
-	zval *tmp;
-#endif
+	uint32_t Shift;
 
-	/* Initialize Zend. */
-	zend_object_std_init(std, ce TSRMLS_CC);
-#if PHP_VERSION_ID < 50399
-	zend_hash_copy(std->properties, &ce->default_properties, (copy_ctor_func_t)zval_add_ref, (void *)&tmp, sizeof(zval *));
-#else
-	object_properties_init(std, ce);
-#endif
+	if (Bucket < (1 << SYNC_UNIX_HISTOGRAM_SUB_BITS))  return (uint64_t)Bucket;
 
-	/* Initialize destructor callback. */
-	retval->handle = zend_objects_store_put(obj, (zend_objects_store_dtor_t)zend_objects_destroy_object, FreeFunc, NULL TSRMLS_CC);
-	retval->handlers = Handlers;
+	Shift = (Bucket >> SYNC_UNIX_HISTOGRAM_SUB_BITS) - 1;
+
+	return ((uint64_t)((Bucket & ((1 << SYNC_UNIX_HISTOGRAM_SUB_BITS) - 1)) + (1 << SYNC_UNIX_HISTOGRAM_SUB_BITS) + 1) << Shift) - 1;
 }
 
-typedef long   PORTABLE_ZPP_ARG_long;
-typedef int   PORTABLE_ZPP_ARG_size;
-typedef zval **   PORTABLE_ZPP_ARG_zval_ref;
-#define PORTABLE_ZPP_ARG_zval_ref_deref(var)   *var
+static inline void sync_AddUnixHistogram(sync_UnixHistogram *Histogram, uint64_t Val)
+{
+	__atomic_fetch_add(&Histogram->MxBuckets[sync_GetUnixHistogramBucket(Val)], 1, __ATOMIC_RELAXED);
+}
 
-#define PORTABLE_zend_object_store_get_object()   zend_object_store_get_object(getThis() TSRMLS_CC)
+/* Returns the value below which Percent percent of the samples fall (rounded up to the bucket edge).  Returns 0 if there are no samples. */
+uint64_t sync_GetUnixHistogramPercentile(sync_UnixHistogram *Histogram, double Percent)
+{
+	uint64_t Counts[SYNC_UNIX_HISTOGRAM_BUCKETS], Total = 0, Target, Sum = 0;
+	uint32_t x;
 
-#define PORTABLE_free_zend_object_func(funcname)   void funcname(void *object TSRMLS_DC)
-#define PORTABLE_free_zend_object_get_object(object)   object;
-#define PORTABLE_free_zend_object_free_object(obj)   zend_object_std_dtor(&obj->std TSRMLS_CC);  efree(obj);
+	for (x = 0; x < SYNC_UNIX_HISTOGRAM_BUCKETS; x++)
+	{
+		Counts[x] = __atomic_load_n(&Histogram->MxBuckets[x], __ATOMIC_RELAXED);
+		Total += Counts[x];
+	}
 
-#define PORTABLE_RETURN_STRINGL(str, len)   RETURN_STRINGL(str, len, 1)
+	if (!Total)  return 0;
 
-#endif
-/* }}} */
+	Target = (uint64_t)((double)Total * Percent / 100.0 + 0.999999);
+	if (Target < 1)  Target = 1;
 
+	for (x = 0; x < SYNC_UNIX_HISTOGRAM_BUCKETS; x++)
+	{
+		Sum += Counts[x];
+		if (Sum >= Target)  return sync_GetUnixHistogramBucketMax(x);
+	}
 
-/* Mutex */
-PHP_SYNC_API zend_class_entry *sync_Mutex_ce;
-static zend_object_handlers sync_Mutex_object_handlers;
+	return sync_GetUnixHistogramBucketMax(SYNC_UNIX_HISTOGRAM_BUCKETS - 1);
+}
 
-PORTABLE_free_zend_object_func(sync_Mutex_free_object);
+uint64_t sync_GetUnixHistogramCount(sync_UnixHistogram *Histogram)
+{
+	uint64_t Result = 0;
+	uint32_t x;
 
-/* {{{ Initialize internal Mutex structure. */
-PORTABLE_new_zend_object_func(sync_Mutex_create_object)
+	for (x = 0; x < SYNC_UNIX_HISTOGRAM_BUCKETS; x++)  Result += __atomic_load_n(&Histogram->MxBuckets[x], __ATOMIC_RELAXED);
+
+	return Result;
+}
+
+/* Optional parts of an object (e.g. histograms) get their own segment so the object's own segment is the same with or without them.  Returns the zeroed memory or NULL. */
+char *sync_OpenUnixSideMem(char **ResultMem, const char *Prefix, const char *Name, int Shared, size_t Size)
 {
-	PORTABLE_new_zend_object_return_var;
-	sync_Mutex_object *obj;
+	size_t Pos;
+	int MemType;
+	int Result = sync_OpenUnixObjectMem(ResultMem, &Pos, &MemType, Prefix, Name, Shared, Size);
 
-	/* Create the object. */
-	obj = (sync_Mutex_object *)PORTABLE_allocate_zend_object(sizeof(sync_Mutex_object), ce);
+	if (Result < 0)
+	{
+		*ResultMem = NULL;
 
-	PORTABLE_InitZendObject(obj, &obj->std, PORTABLE_new_zend_object_return_var_ref, sync_Mutex_free_object, &sync_Mutex_object_handlers, ce TSRMLS_CC);
+		return NULL;
+	}
 
-	/* Initialize Mutex information. */
-#if defined(PHP_WIN32)
+	/* Fresh memory is already zeroed. */
+	if (Result == 0 && MemType == SYNC_UNIX_MEM_NAMED)  sync_UnixNamedMemReady(*ResultMem);
+
+	return (*ResultMem) + Pos;
+}
+
+void sync_CloseUnixSideMem(char *Mem, int MemType, size_t Size)
+{
+	if (!sync_CloseUnixObjectMem(Mem, MemType, Size))  efree(Mem);
+}
+
+/* Opens the wait and hold histograms for an object. */
+sync_UnixHistogram *sync_InitUnixHistograms(char **ResultMem, const char *Prefix, const char *Name, int Shared)
+{
+	return (sync_UnixHistogram *)sync_OpenUnixSideMem(ResultMem, Prefix, Name, Shared, sizeof(sync_UnixHistogram) * 2);
+}
+
+void sync_FreeUnixHistograms(char *Mem, int MemType)
+{
+	sync_CloseUnixSideMem(Mem, MemType, sizeof(sync_UnixHistogram) * 2);
+}
+
+/* Records an acquisition. */
+static inline void sync_AddUnixStatsAcquire(char *Stats, sync_UnixHistogram *Histograms, int Contended, uint64_t WaitTime)
+{
+	sync_UnixStatsSlot *Slot = sync_GetUnixStatsSlot(Stats);
+
+	__atomic_fetch_add(&Slot->MxAcquired, 1, __ATOMIC_RELAXED);
+
+	if (Contended)
+	{
+		__atomic_fetch_add(&Slot->MxContended, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&Slot->MxWaitTime, WaitTime, __ATOMIC_RELAXED);
+		sync_UpdateUnixStatsMax(&Slot->MxMaxWaitTime, WaitTime);
+	}
+
+	if (Histograms != NULL)  sync_AddUnixHistogram(&Histograms[0], WaitTime);
+}
+
+/* Records a failed acquisition. */
+static inline void sync_AddUnixStatsTimeout(char *Stats, sync_UnixHistogram *Histograms, uint64_t WaitTime)
+{
+	sync_UnixStatsSlot *Slot = sync_GetUnixStatsSlot(Stats);
+
+	__atomic_fetch_add(&Slot->MxTimeouts, 1, __ATOMIC_RELAXED);
+
+	if (WaitTime)
+	{
+		__atomic_fetch_add(&Slot->MxWaitTime, WaitTime, __ATOMIC_RELAXED);
+		sync_UpdateUnixStatsMax(&Slot->MxMaxWaitTime, WaitTime);
+	}
+
+	if (Histograms != NULL)  sync_AddUnixHistogram(&Histograms[0], WaitTime);
+}
+
+/* Returns the start of a hold time.  Only objects with histograms pay for the precise clock. */
+uint64_t sync_GetUnixHoldStart(sync_UnixHistogram *Histograms)
+{
+	return (Histograms != NULL ? sync_GetMonotonicTime() : sync_GetCoarseMonotonicTime());
+}
+
+/* Called when the first attempt to acquire a lock fails and the caller is about to wait.  Returns the start of the wait. */
+uint64_t sync_StartUnixLockWait(uint32_t NameHash, int Type)
+{
+	SYNC_PROBE2(wait__start, NameHash, Type);
+
+	return sync_GetMonotonicTime();
+}
+
+/* Records the outcome of acquiring a lock.  WaitStart is 0 if the first attempt succeeded.  Returns Result. */
+int sync_EndUnixLockWait(char *Stats, sync_UnixHistogram *Histograms, uint32_t NameHash, int Type, uint64_t WaitStart, int Result)
+{
+	uint64_t WaitTime = 0;
+
+	if (WaitStart)
+	{
+		WaitTime = sync_GetMonotonicTime();
+		WaitTime = (WaitTime > WaitStart ? WaitTime - WaitStart : 0);
+	}
+
+	if (Result)
+	{
+		sync_AddUnixStatsAcquire(Stats, Histograms, (WaitStart != 0), WaitTime);
+
+		SYNC_PROBE3(acquired, NameHash, Type, WaitTime);
+	}
+	else
+	{
+		sync_AddUnixStatsTimeout(Stats, Histograms, WaitTime);
+
+		SYNC_PROBE3(timed__out, NameHash, Type, WaitTime);
+	}
+
+	return Result;
+}
+
+/* Records a release.  HoldStart comes from sync_GetUnixHoldStart() with the same histograms, or 0 if the hold isn't over. */
+void sync_AddUnixLockRelease(char *Stats, sync_UnixHistogram *Histograms, uint32_t NameHash, int Type, uint64_t HoldStart)
+{
+	uint64_t HoldTime = 0;
+
+	if (HoldStart)
+	{
+		HoldTime = sync_GetUnixHoldStart(Histograms);
+		HoldTime = (HoldTime > HoldStart ? HoldTime - HoldStart : 0);
+
+		sync_UpdateUnixStatsMax(&sync_GetUnixStatsSlot(Stats)->MxMaxHoldTime, HoldTime);
+
+		if (Histograms != NULL)  sync_AddUnixHistogram(&Histograms[1], HoldTime);
+	}
+
+	SYNC_PROBE3(released, NameHash, Type, HoldTime);
+}
+
+/* Sums the per-CPU slots. */
+void sync_GetUnixStats(char *Stats, sync_UnixStatsSlot *Result)
+{
+	sync_UnixStatsSlot *Slot;
+	uint64_t Val;
+	uint32_t x;
+
+	memset(Result, 0, sizeof(sync_UnixStatsSlot));
+
+	for (x = 0; x < SYNC_UNIX_STATS_SLOTS; x++)
+	{
+		Slot = (sync_UnixStatsSlot *)(Stats + x * SYNC_UNIX_CACHE_LINE_SIZE);
+
+		Result->MxAcquired += __atomic_load_n(&Slot->MxAcquired, __ATOMIC_RELAXED);
+		Result->MxContended += __atomic_load_n(&Slot->MxContended, __ATOMIC_RELAXED);
+		Result->MxTimeouts += __atomic_load_n(&Slot->MxTimeouts, __ATOMIC_RELAXED);
+		Result->MxWaitTime += __atomic_load_n(&Slot->MxWaitTime, __ATOMIC_RELAXED);
+
+		Val = __atomic_load_n(&Slot->MxMaxWaitTime, __ATOMIC_RELAXED);
+		if (Result->MxMaxWaitTime < Val)  Result->MxMaxWaitTime = Val;
+
+		Val = __atomic_load_n(&Slot->MxMaxHoldTime, __ATOMIC_RELAXED);
+		if (Result->MxMaxHoldTime < Val)  Result->MxMaxHoldTime = Val;
+	}
+}
+
+/* Adaptive spinning before sleeping.  Most locks are held very briefly, so a short spin avoids a sleep and wakeup. */
+/* The spin count tracks recent wait times (similar to glibc adaptive mutexes) and is bounded by the spin limit. */
+static inline void sync_UnixCpuRelax()
+{
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	__asm__ __volatile__("pause");
+#elif defined(__GNUC__) && (defined(__aarch64__) || defined(__arm__))
+	__asm__ __volatile__("yield");
+#endif
+}
+
+uint32_t sync_GetUnixSpinBudget(uint32_t Spin, uint32_t SpinLimit)
+{
+	uint32_t Result = Spin * 2 + 10;
+
+	return (Result < SpinLimit ? Result : SpinLimit);
+}
+
+void sync_UpdateUnixSpin(uint32_t *Spin, uint32_t Spun)
+{
+	*Spin = (uint32_t)((int32_t)*Spin + ((int32_t)Spun - (int32_t)*Spin) / 8);
+}
+
+/* Basic *NIX Semaphore functions. */
+size_t sync_GetUnixSemaphoreSize()
+{
+	return sync_AlignUnixSize(sizeof(pthread_mutex_t)) + sync_AlignUnixSize(sizeof(uint32_t)) + sync_AlignUnixSize(sizeof(uint32_t)) + sync_AlignUnixSize(sizeof(uint32_t)) + sync_AlignUnixSize(sizeof(uint64_t)) + sync_AlignUnixSize(sizeof(uint32_t)) + sync_AlignUnixSize(sizeof(uint32_t)) + sync_AlignUnixSize(sizeof(pthread_cond_t));
+}
+
+void sync_GetUnixSemaphore(sync_UnixSemaphoreWrapper *Result, char *Mem, uint32_t SpinLimit)
+{
+	Result->MxSpinLimit = SpinLimit;
+	Result->MxSpin = 0;
+	Result->MxFair = NULL;
+	Result->MxFairSlot = -1;
+
+	Result->MxMutex = (pthread_mutex_t *)(Mem);
+	Mem += sync_AlignUnixSize(sizeof(pthread_mutex_t));
+
+	Result->MxCount = (uint32_t *)(Mem);
+	Mem += sync_AlignUnixSize(sizeof(uint32_t));
+
+	Result->MxMax = (uint32_t *)(Mem);
+	Mem += sync_AlignUnixSize(sizeof(uint32_t));
+
+	Result->MxDebt = (uint32_t *)(Mem);
+	Mem += sync_AlignUnixSize(sizeof(uint32_t));
+
+	Result->MxOwner = (uint64_t *)(Mem);
+	Mem += sync_AlignUnixSize(sizeof(uint64_t));
+
+	Result->MxWaiters = (uint32_t *)(Mem);
+	Mem += sync_AlignUnixSize(sizeof(uint32_t));
+
+	Result->MxBatchWaiters = (uint32_t *)(Mem);
+	Mem += sync_AlignUnixSize(sizeof(uint32_t));
+
+	Result->MxCond = (pthread_cond_t *)(Mem);
+}
+
+void sync_InitUnixSemaphore(sync_UnixSemaphoreWrapper *UnixSemaphore, int Shared, uint32_t Start, uint32_t Max)
+{
+	pthread_mutexattr_t MutexAttr;
+	pthread_condattr_t CondAttr;
+
+	sync_InitUnixMutexAttr(&MutexAttr, Shared);
+	sync_InitUnixCondAttr(&CondAttr, Shared);
+
+	pthread_mutex_init(UnixSemaphore->MxMutex, &MutexAttr);
+#ifdef SYNC_UNIX_FUTEX
+	if (Max > SYNC_UNIX_FUTEX_COUNT)  Max = SYNC_UNIX_FUTEX_COUNT;
+#endif
+	if (Start > Max)  Start = Max;
+	UnixSemaphore->MxCount[0] = Start;
+	UnixSemaphore->MxMax[0] = Max;
+	UnixSemaphore->MxDebt[0] = 0;
+	UnixSemaphore->MxOwner[0] = 0;
+	UnixSemaphore->MxWaiters[0] = 0;
+	UnixSemaphore->MxBatchWaiters[0] = 0;
+	pthread_cond_init(UnixSemaphore->MxCond, &CondAttr);
+
+	pthread_condattr_destroy(&CondAttr);
+	pthread_mutexattr_destroy(&MutexAttr);
+}
+
+/* Waiters that might be stuck behind a process that died check on it this often. */
+#define SYNC_UNIX_OWNER_CHECK_INTERVAL ((uint64_t)100000000)
+
+/* Shortens a wait so that holders and queued waiters get checked on now and then. */
+static inline uint64_t sync_GetUnixOwnerCheckDeadline(uint64_t Deadline)
+{
+	uint64_t CurrTime;
+
+	if (Deadline == SYNC_DEADLINE_NOWAIT)  return Deadline;
+
+	CurrTime = sync_GetMonotonicTime();
+	if (Deadline > CurrTime && Deadline - CurrTime > SYNC_UNIX_OWNER_CHECK_INTERVAL)  return CurrTime + SYNC_UNIX_OWNER_CHECK_INTERVAL;
+
+	return Deadline;
+}
+
+/* Fair mode.  Waiters queue up in arrival order and a release hands its units straight to the oldest waiter, so a process that releases and locks again can't barge ahead. */
+/* Everything goes through the mutex.  Waiters sleep on their own slot (a futex) or on the condition variable.  The count never carries futex flags in this mode. */
+#define SYNC_UNIX_FAIR_FREE            0
+#define SYNC_UNIX_FAIR_WAITING         1
+#define SYNC_UNIX_FAIR_GRANTED         2
+#define SYNC_UNIX_FAIR_CANCELLED       3
+
+size_t sync_GetUnixFairQueueSize(int Fair)
+{
+	if (!Fair)  return 0;
+
+	return SYNC_UNIX_FIELD_ALIGN + sizeof(sync_UnixFairQueue);
+}
+
+sync_UnixFairQueue *sync_GetUnixFairQueue(char *Mem)
+{
+	return (sync_UnixFairQueue *)sync_AlignUnixFieldPtr(Mem);
+}
+
+static inline void sync_WakeUnixSemaphoreFair(sync_UnixSemaphoreWrapper *UnixSemaphore, sync_UnixFairSlot *Slot)
+{
+#ifdef SYNC_UNIX_FUTEX
+	sync_UnixFutexWake(&Slot->MxState, 1);
+#else
+	pthread_cond_broadcast(UnixSemaphore->MxCond);
+#endif
+}
+
+/* Hands free units to the front of the queue for as long as they fit.  A waiter that wants more units than are free holds up everyone behind it.  The mutex must be held. */
+static void sync_GrantUnixSemaphoreFair(sync_UnixSemaphoreWrapper *UnixSemaphore)
+{
+	sync_UnixFairQueue *Queue = UnixSemaphore->MxFair;
+	sync_UnixFairSlot *Slot;
+
+	while (Queue->MxHead != Queue->MxTail)
+	{
+		Slot = &Queue->MxSlots[Queue->MxHead % SYNC_UNIX_FAIR_SLOTS];
+		if (Slot->MxState == SYNC_UNIX_FAIR_CANCELLED)  Slot->MxState = SYNC_UNIX_FAIR_FREE;
+		else
+		{
+			if (Slot->MxCount > UnixSemaphore->MxCount[0])  break;
+
+			UnixSemaphore->MxCount[0] -= Slot->MxCount;
+			__atomic_store_n(&Slot->MxState, SYNC_UNIX_FAIR_GRANTED, __ATOMIC_RELEASE);
+			sync_WakeUnixSemaphoreFair(UnixSemaphore, Slot);
+		}
+
+		Queue->MxHead++;
+	}
+}
+
+/* Gives up the places of queued waiters that died and takes back units handed to waiters that died before picking them up. */
+/* Only one waiter per check interval does the scan. */
+static void sync_RecoverUnixSemaphoreFair(sync_UnixSemaphoreWrapper *UnixSemaphore)
+{
+	sync_UnixFairQueue *Queue = UnixSemaphore->MxFair;
+	sync_UnixFairSlot *Slot;
+	uint64_t CurrTime = sync_GetMonotonicTime(), Last = __atomic_load_n(&Queue->MxLastCheck, __ATOMIC_RELAXED);
+	uint32_t x;
+
+	if (CurrTime - Last < SYNC_UNIX_OWNER_CHECK_INTERVAL || !__atomic_compare_exchange_n(&Queue->MxLastCheck, &Last, CurrTime, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))  return;
+
+	if (sync_RecoverUnixMutex(UnixSemaphore->MxMutex, pthread_mutex_lock(UnixSemaphore->MxMutex)) != 0)  return;
+
+	for (x = 0; x < SYNC_UNIX_FAIR_SLOTS; x++)
+	{
+		Slot = &Queue->MxSlots[x];
+		if ((Slot->MxState != SYNC_UNIX_FAIR_WAITING && Slot->MxState != SYNC_UNIX_FAIR_GRANTED) || sync_IsUnixOwnerAlive(Slot->MxOwner))  continue;
+
+		if (Slot->MxState == SYNC_UNIX_FAIR_GRANTED)
+		{
+			if (Slot->MxCount > UnixSemaphore->MxMax[0] - UnixSemaphore->MxCount[0])  UnixSemaphore->MxCount[0] = UnixSemaphore->MxMax[0];
+			else  UnixSemaphore->MxCount[0] += Slot->MxCount;
+
+			Slot->MxState = SYNC_UNIX_FAIR_FREE;
+		}
+		else
+		{
+			Slot->MxState = SYNC_UNIX_FAIR_CANCELLED;
+		}
+	}
+
+	sync_GrantUnixSemaphoreFair(UnixSemaphore);
+
+	pthread_mutex_unlock(UnixSemaphore->MxMutex);
+}
+
+/* Sleeps until the slot is granted or the deadline passes.  Returns whether the slot was granted. */
+#ifdef SYNC_UNIX_FUTEX
+static int sync_SleepUnixSemaphoreFair(sync_UnixSemaphoreWrapper *UnixSemaphore, sync_UnixFairSlot *Slot, uint64_t Deadline)
+{
+	struct timespec TempTime;
+
+	if (Deadline != SYNC_DEADLINE_INFINITE)  sync_GetUnixDeadlineTimespec(&TempTime, Deadline);
+
+	while (__atomic_load_n(&Slot->MxState, __ATOMIC_ACQUIRE) == SYNC_UNIX_FAIR_WAITING)
+	{
+		if (sync_UnixFutexWait(&Slot->MxState, SYNC_UNIX_FAIR_WAITING, (Deadline != SYNC_DEADLINE_INFINITE ? &TempTime : NULL)) == -1 && errno == ETIMEDOUT)  break;
+	}
+
+	return (__atomic_load_n(&Slot->MxState, __ATOMIC_ACQUIRE) == SYNC_UNIX_FAIR_GRANTED);
+}
+#else
+static int sync_SleepUnixSemaphoreFair(sync_UnixSemaphoreWrapper *UnixSemaphore, sync_UnixFairSlot *Slot, uint64_t Deadline)
+{
+	int Result;
+
+	if (sync_RecoverUnixMutex(UnixSemaphore->MxMutex, pthread_mutex_lock(UnixSemaphore->MxMutex)) != 0)  return 0;
+
+	while (Slot->MxState == SYNC_UNIX_FAIR_WAITING)
+	{
+		if (Deadline == SYNC_DEADLINE_INFINITE)  Result = sync_RecoverUnixMutex(UnixSemaphore->MxMutex, pthread_cond_wait(UnixSemaphore->MxCond, UnixSemaphore->MxMutex));
+		else  Result = sync_RecoverUnixMutex(UnixSemaphore->MxMutex, sync_UnixCondTimedWait(UnixSemaphore->MxCond, UnixSemaphore->MxMutex, Deadline));
+		if (Result != 0)  break;
+	}
+
+	Result = (Slot->MxState == SYNC_UNIX_FAIR_GRANTED);
+
+	pthread_mutex_unlock(UnixSemaphore->MxMutex);
+
+	return Result;
+}
+#endif
+
+/* Waits in the queue.  A timeout keeps the slot so that callers waiting in slices don't lose their place.  sync_CancelUnixSemaphoreFair() gives it up. */
+/* A zero wait never queues. */
+int sync_WaitForUnixSemaphoreFair(sync_UnixSemaphoreWrapper *UnixSemaphore, uint32_t Count, uint64_t Deadline)
+{
+	sync_UnixFairQueue *Queue = UnixSemaphore->MxFair;
+	sync_UnixFairSlot *Slot;
+	uint64_t Deadline2;
+
+	if (UnixSemaphore->MxFairSlot < 0)
+	{
+		/* Never going to happen. */
+		if (Count > UnixSemaphore->MxMax[0])  return 0;
+
+		for (;;)
+		{
+			if (Deadline == SYNC_DEADLINE_NOWAIT)
+			{
+				if (sync_RecoverUnixMutex(UnixSemaphore->MxMutex, pthread_mutex_trylock(UnixSemaphore->MxMutex)) != 0)  return 0;
+			}
+			else
+			{
+				if (sync_RecoverUnixMutex(UnixSemaphore->MxMutex, pthread_mutex_lock(UnixSemaphore->MxMutex)) != 0)  return 0;
+			}
+
+			/* Newcomers only take units directly when nobody is queued ahead of them. */
+			if (Queue->MxHead == Queue->MxTail && UnixSemaphore->MxCount[0] >= Count)
+			{
+				UnixSemaphore->MxCount[0] -= Count;
+
+				pthread_mutex_unlock(UnixSemaphore->MxMutex);
+
+				return 1;
+			}
+
+			if (Deadline == SYNC_DEADLINE_NOWAIT)
+			{
+				pthread_mutex_unlock(UnixSemaphore->MxMutex);
+
+				return 0;
+			}
+
+			Slot = &Queue->MxSlots[Queue->MxTail % SYNC_UNIX_FAIR_SLOTS];
+			if (Queue->MxTail - Queue->MxHead < SYNC_UNIX_FAIR_SLOTS && __atomic_load_n(&Slot->MxState, __ATOMIC_ACQUIRE) == SYNC_UNIX_FAIR_FREE)  break;
+
+			pthread_mutex_unlock(UnixSemaphore->MxMutex);
+
+			/* The queue is full.  Rare enough to just poll for a free slot. */
+			if (sync_GetMonotonicTime() >= Deadline)  return 0;
+
+			usleep(1000);
+		}
+
+		Slot->MxCount = Count;
+		Slot->MxOwner = sync_GetUnixProcessOwner();
+		Slot->MxState = SYNC_UNIX_FAIR_WAITING;
+		UnixSemaphore->MxFairSlot = (int32_t)(Queue->MxTail % SYNC_UNIX_FAIR_SLOTS);
+		Queue->MxTail++;
+
+		pthread_mutex_unlock(UnixSemaphore->MxMutex);
+	}
+
+	Slot = &Queue->MxSlots[UnixSemaphore->MxFairSlot];
+
+	for (;;)
+	{
+		Deadline2 = sync_GetUnixOwnerCheckDeadline(Deadline);
+
+		if (sync_SleepUnixSemaphoreFair(UnixSemaphore, Slot, Deadline2))  break;
+
+		if (Deadline2 == Deadline)  return 0;
+
+		sync_RecoverUnixSemaphoreFair(UnixSemaphore);
+	}
+
+	/* The units were taken on this waiter's behalf.  The slot can be reused. */
+	__atomic_store_n(&Slot->MxState, SYNC_UNIX_FAIR_FREE, __ATOMIC_RELEASE);
+	UnixSemaphore->MxFairSlot = -1;
+
+	return 1;
+}
+
+/* Leaves the queue.  Returns 1 when the slot was granted in the meantime, in which case the caller holds the units after all. */
+int sync_CancelUnixSemaphoreFair(sync_UnixSemaphoreWrapper *UnixSemaphore)
+{
+	sync_UnixFairSlot *Slot;
+	int Result = 0;
+
+	if (UnixSemaphore->MxFairSlot < 0)  return 0;
+
+	Slot = &UnixSemaphore->MxFair->MxSlots[UnixSemaphore->MxFairSlot];
+	UnixSemaphore->MxFairSlot = -1;
+
+	if (sync_RecoverUnixMutex(UnixSemaphore->MxMutex, pthread_mutex_lock(UnixSemaphore->MxMutex)) != 0)  return 0;
+
+	if (Slot->MxState == SYNC_UNIX_FAIR_GRANTED)
+	{
+		Slot->MxState = SYNC_UNIX_FAIR_FREE;
+
+		Result = 1;
+	}
+	else
+	{
+		Slot->MxState = SYNC_UNIX_FAIR_CANCELLED;
+
+		/* A waiter at the front that gives up may have been holding up the ones behind it. */
+		sync_GrantUnixSemaphoreFair(UnixSemaphore);
+	}
+
+	pthread_mutex_unlock(UnixSemaphore->MxMutex);
+
+	return Result;
+}
+
+int sync_ReleaseUnixSemaphoreFair(sync_UnixSemaphoreWrapper *UnixSemaphore, uint32_t Count, uint32_t *PrevVal)
+{
+	uint32_t x;
+
+	if (sync_RecoverUnixMutex(UnixSemaphore->MxMutex, pthread_mutex_lock(UnixSemaphore->MxMutex)) != 0)  return 0;
+
+	if (PrevVal != NULL)  *PrevVal = UnixSemaphore->MxCount[0];
+
+	/* Units taken away by a lower maximum while they were in use get paid off instead of released. */
+	x = (UnixSemaphore->MxDebt[0] < Count ? UnixSemaphore->MxDebt[0] : Count);
+	UnixSemaphore->MxDebt[0] -= x;
+	Count -= x;
+
+	if (Count > UnixSemaphore->MxMax[0] - UnixSemaphore->MxCount[0])  UnixSemaphore->MxCount[0] = UnixSemaphore->MxMax[0];
+	else  UnixSemaphore->MxCount[0] += Count;
+
+	sync_GrantUnixSemaphoreFair(UnixSemaphore);
+
+	pthread_mutex_unlock(UnixSemaphore->MxMutex);
+
+	return 1;
+}
+
+#ifdef SYNC_UNIX_FUTEX
+
+/* Uncontended operations are a single atomic compare-and-swap on the count.  The mutex and condition variable are not used. */
+/* Count units are taken all at once or not at all.  Sleeping waiters are counted next to the count so that every release while any of them sleep wakes some. */
+int sync_WaitForUnixSemaphoreCount(sync_UnixSemaphoreWrapper *UnixSemaphore, uint32_t Count, uint64_t Deadline)
+{
+	struct timespec TempTime;
+	uint32_t Val, x, y;
+	int Spun = 0, Result;
+
+	if (UnixSemaphore->MxFair != NULL)  return (sync_WaitForUnixSemaphoreFair(UnixSemaphore, Count, Deadline) || sync_CancelUnixSemaphoreFair(UnixSemaphore));
+
+	/* Never going to happen. */
+	if (Count > UnixSemaphore->MxMax[0])  return 0;
+
+	Val = __atomic_load_n(UnixSemaphore->MxCount, __ATOMIC_RELAXED);
+	for (;;)
+	{
+		if (Val >= Count)
+		{
+			if (__atomic_compare_exchange_n(UnixSemaphore->MxCount, &Val, Val - Count, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))  return 1;
+
+			continue;
+		}
+
+		if (Deadline == SYNC_DEADLINE_NOWAIT)  return 0;
+
+		if (!Spun && UnixSemaphore->MxSpinLimit)
+		{
+			y = sync_GetUnixSpinBudget(UnixSemaphore->MxSpin, UnixSemaphore->MxSpinLimit);
+			for (x = 0; x < y && UnixSemaphore->MxCount[0] < Count; x++)  sync_UnixCpuRelax();
+			sync_UpdateUnixSpin(&UnixSemaphore->MxSpin, x);
+
+			Spun = 1;
+			Val = __atomic_load_n(UnixSemaphore->MxCount, __ATOMIC_RELAXED);
+
+			continue;
+		}
+
+		/* Register before the last look at the count.  A release either sees the registration or changes the count, which makes the sleep return right away. */
+		/* A release can't tell how many units each waiter wants, so batch waiters get everyone woken. */
+		__atomic_fetch_add(UnixSemaphore->MxWaiters, 1, __ATOMIC_SEQ_CST);
+		if (Count > 1)  __atomic_fetch_add(UnixSemaphore->MxBatchWaiters, 1, __ATOMIC_SEQ_CST);
+
+		Result = 0;
+		Val = __atomic_load_n(UnixSemaphore->MxCount, __ATOMIC_SEQ_CST);
+		if (Val < Count)
+		{
+			if (Deadline != SYNC_DEADLINE_INFINITE)  sync_GetUnixDeadlineTimespec(&TempTime, Deadline);
+
+			Result = sync_UnixFutexWait(UnixSemaphore->MxCount, Val, (Deadline != SYNC_DEADLINE_INFINITE ? &TempTime : NULL));
+		}
+
+		if (Count > 1)  __atomic_fetch_sub(UnixSemaphore->MxBatchWaiters, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_sub(UnixSemaphore->MxWaiters, 1, __ATOMIC_RELAXED);
+
+		/* Make one last attempt after timing out.  Units released just as the deadline passed may have been meant for this waiter. */
+		if (Result == -1 && errno == ETIMEDOUT)  Deadline = SYNC_DEADLINE_NOWAIT;
+
+		Val = __atomic_load_n(UnixSemaphore->MxCount, __ATOMIC_RELAXED);
+	}
+}
+
+int sync_ReleaseUnixSemaphoreCount(sync_UnixSemaphoreWrapper *UnixSemaphore, uint32_t Count, uint32_t *PrevVal)
+{
+	uint32_t Val, NewVal, Max, Paid;
+	int Wake;
+
+	if (UnixSemaphore->MxFair != NULL)  return sync_ReleaseUnixSemaphoreFair(UnixSemaphore, Count, PrevVal);
+
+	/* Units taken away by a lower maximum while they were in use get paid off instead of released. */
+	Val = __atomic_load_n(UnixSemaphore->MxDebt, __ATOMIC_RELAXED);
+	while (Val)
+	{
+		Paid = (Val < Count ? Val : Count);
+		if (__atomic_compare_exchange_n(UnixSemaphore->MxDebt, &Val, Val - Paid, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		{
+			Count -= Paid;
+
+			break;
+		}
+	}
+
+	if (!Count)
+	{
+		if (PrevVal != NULL)  *PrevVal = __atomic_load_n(UnixSemaphore->MxCount, __ATOMIC_RELAXED);
+
+		return 1;
+	}
+
+	Max = __atomic_load_n(UnixSemaphore->MxMax, __ATOMIC_RELAXED);
+	Val = __atomic_load_n(UnixSemaphore->MxCount, __ATOMIC_RELAXED);
+	do
+	{
+		NewVal = (Count > Max - Val ? Max : Val + Count);
+	} while (!__atomic_compare_exchange_n(UnixSemaphore->MxCount, &Val, NewVal, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+
+	if (PrevVal != NULL)  *PrevVal = Val;
+
+	/* Pairs with the waiter registering before its last look at the count.  Waiters stay registered until they run again, so back to back releases all see them. */
+	/* Wake as many waiters as the released units can satisfy.  Waking one waiter per unit is only right when every waiter wants a single unit. */
+	if (__atomic_load_n(UnixSemaphore->MxWaiters, __ATOMIC_SEQ_CST))
+	{
+		if (__atomic_load_n(UnixSemaphore->MxBatchWaiters, __ATOMIC_RELAXED))  sync_UnixFutexWake(UnixSemaphore->MxCount, INT_MAX);
+		else
+		{
+			Wake = (int)(NewVal - Val);
+
+			sync_UnixFutexWake(UnixSemaphore->MxCount, (Wake > 0 ? Wake : 1));
+		}
+	}
+
+	return 1;
+}
+
+/* Changes the maximum in place.  A lower maximum takes free units away right away and the rest as they are released. */
+/* Changes are serialized by the mutex, which nothing else uses. */
+int sync_SetUnixSemaphoreMax(sync_UnixSemaphoreWrapper *UnixSemaphore, uint32_t Max)
+{
+	uint32_t OldMax, Val, Diff, Taken, Added = 0;
+
+	if (!Max || Max > SYNC_UNIX_FUTEX_COUNT)  return 0;
+
+	if (sync_RecoverUnixMutex(UnixSemaphore->MxMutex, pthread_mutex_lock(UnixSemaphore->MxMutex)) != 0)  return 0;
+
+	OldMax = UnixSemaphore->MxMax[0];
+	if (Max > OldMax)
+	{
+		/* Raise the maximum first so that the new units fit. */
+		__atomic_store_n(UnixSemaphore->MxMax, Max, __ATOMIC_RELAXED);
+
+		/* Forgive debt before adding units. */
+		Diff = Max - OldMax;
+		Val = __atomic_load_n(UnixSemaphore->MxDebt, __ATOMIC_RELAXED);
+		do
+		{
+			Taken = (Val < Diff ? Val : Diff);
+		} while (Taken && !__atomic_compare_exchange_n(UnixSemaphore->MxDebt, &Val, Val - Taken, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+		Added = Diff - Taken;
+	}
+	else if (Max < OldMax)
+	{
+		Diff = OldMax - Max;
+		Val = __atomic_load_n(UnixSemaphore->MxCount, __ATOMIC_RELAXED);
+		do
+		{
+			Taken = (Val > Diff ? Diff : Val);
+		} while (Taken && !__atomic_compare_exchange_n(UnixSemaphore->MxCount, &Val, Val - Taken, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+		if (Diff > Taken)  __atomic_add_fetch(UnixSemaphore->MxDebt, Diff - Taken, __ATOMIC_RELAXED);
+
+		/* Lower the maximum last so that releases in the meantime aren't cut off by it. */
+		__atomic_store_n(UnixSemaphore->MxMax, Max, __ATOMIC_RELAXED);
+	}
+
+	pthread_mutex_unlock(UnixSemaphore->MxMutex);
+
+	/* Fair mode releases through the mutex too. */
+	if (Added)  sync_ReleaseUnixSemaphoreCount(UnixSemaphore, Added, NULL);
+
+	return 1;
+}
+
+uint32_t sync_GetUnixSemaphoreValue(sync_UnixSemaphoreWrapper *UnixSemaphore)
+{
+	return __atomic_load_n(UnixSemaphore->MxCount, __ATOMIC_RELAXED);
+}
+
+#else
+
+/* Count units are taken all at once or not at all.  Waiters are counted so that a release knows how many of them to wake. */
+int sync_WaitForUnixSemaphoreCount(sync_UnixSemaphoreWrapper *UnixSemaphore, uint32_t Count, uint64_t Deadline)
+{
+	if (UnixSemaphore->MxFair != NULL)  return (sync_WaitForUnixSemaphoreFair(UnixSemaphore, Count, Deadline) || sync_CancelUnixSemaphoreFair(UnixSemaphore));
+
+	/* Never going to happen. */
+	if (Count > UnixSemaphore->MxMax[0])  return 0;
+
+	if (Deadline == SYNC_DEADLINE_NOWAIT)
+	{
+		/* Avoid the scenario of deadlock on the semaphore itself for 0 wait. */
+		if (sync_RecoverUnixMutex(UnixSemaphore->MxMutex, pthread_mutex_trylock(UnixSemaphore->MxMutex)) != 0)  return 0;
+	}
+	else
+	{
+		if (UnixSemaphore->MxCount[0] < Count && UnixSemaphore->MxSpinLimit)
+		{
+			uint32_t x, y = sync_GetUnixSpinBudget(UnixSemaphore->MxSpin, UnixSemaphore->MxSpinLimit);
+
+			for (x = 0; x < y && UnixSemaphore->MxCount[0] < Count; x++)  sync_UnixCpuRelax();
+			sync_UpdateUnixSpin(&UnixSemaphore->MxSpin, x);
+		}
+
+		if (sync_RecoverUnixMutex(UnixSemaphore->MxMutex, pthread_mutex_lock(UnixSemaphore->MxMutex)) != 0)  return 0;
+	}
+
+	int Result = 0;
+
+	if (UnixSemaphore->MxCount[0] >= Count)
+	{
+		UnixSemaphore->MxCount[0] -= Count;
+
+		Result = 1;
+	}
+	else if (Deadline != SYNC_DEADLINE_NOWAIT)
+	{
+		int Result2;
+
+		UnixSemaphore->MxWaiters[0]++;
+		if (Count > 1)  UnixSemaphore->MxBatchWaiters[0]++;
+
+		do
+		{
+			/* Some platforms have pthread_cond_timedwait() but not pthread_mutex_timedlock() or sem_timedwait() (e.g. Mac OSX). */
+			SYNC_PROBE1(sleep, (uintptr_t)UnixSemaphore->MxCond);
+			if (Deadline == SYNC_DEADLINE_INFINITE)  Result2 = sync_RecoverUnixMutex(UnixSemaphore->MxMutex, pthread_cond_wait(UnixSemaphore->MxCond, UnixSemaphore->MxMutex));
+			else  Result2 = sync_RecoverUnixMutex(UnixSemaphore->MxMutex, sync_UnixCondTimedWait(UnixSemaphore->MxCond, UnixSemaphore->MxMutex, Deadline));
+			SYNC_PROBE1(wakeup, (uintptr_t)UnixSemaphore->MxCond);
+			if (Result2 != 0)  break;
+		} while (UnixSemaphore->MxCount[0] < Count);
+
+		UnixSemaphore->MxWaiters[0]--;
+		if (Count > 1)  UnixSemaphore->MxBatchWaiters[0]--;
+
+		if (Result2 == 0)
+		{
+			UnixSemaphore->MxCount[0] -= Count;
+
+			Result = 1;
+		}
+	}
+
+	pthread_mutex_unlock(UnixSemaphore->MxMutex);
+
+	return Result;
+}
+
+int sync_ReleaseUnixSemaphoreCount(sync_UnixSemaphoreWrapper *UnixSemaphore, uint32_t Count, uint32_t *PrevVal)
+{
+	uint32_t x;
+
+	if (UnixSemaphore->MxFair != NULL)  return sync_ReleaseUnixSemaphoreFair(UnixSemaphore, Count, PrevVal);
+
+	if (sync_RecoverUnixMutex(UnixSemaphore->MxMutex, pthread_mutex_lock(UnixSemaphore->MxMutex)) != 0)  return 0;
+
+	if (PrevVal != NULL)  *PrevVal = UnixSemaphore->MxCount[0];
+
+	/* Units taken away by a lower maximum while they were in use get paid off instead of released. */
+	x = (UnixSemaphore->MxDebt[0] < Count ? UnixSemaphore->MxDebt[0] : Count);
+	UnixSemaphore->MxDebt[0] -= x;
+	Count -= x;
+
+	if (Count > UnixSemaphore->MxMax[0] - UnixSemaphore->MxCount[0])  UnixSemaphore->MxCount[0] = UnixSemaphore->MxMax[0];
+	else  UnixSemaphore->MxCount[0] += Count;
+
+	/* Wake as many waiters as the released units can satisfy.  Waking one waiter per unit is only right when every waiter wants a single unit. */
+	if (UnixSemaphore->MxBatchWaiters[0] || Count >= UnixSemaphore->MxWaiters[0])
+	{
+		if (Count)  pthread_cond_broadcast(UnixSemaphore->MxCond);
+	}
+	else
+	{
+		for (x = 0; x < Count; x++)  pthread_cond_signal(UnixSemaphore->MxCond);
+	}
+
+	pthread_mutex_unlock(UnixSemaphore->MxMutex);
+
+	return 1;
+}
+
+/* Changes the maximum in place.  A lower maximum takes free units away right away and the rest as they are released. */
+int sync_SetUnixSemaphoreMax(sync_UnixSemaphoreWrapper *UnixSemaphore, uint32_t Max)
+{
+	uint32_t OldMax, Diff, Taken;
+
+	if (!Max)  return 0;
+
+	if (sync_RecoverUnixMutex(UnixSemaphore->MxMutex, pthread_mutex_lock(UnixSemaphore->MxMutex)) != 0)  return 0;
+
+	OldMax = UnixSemaphore->MxMax[0];
+	if (Max > OldMax)
+	{
+		/* Forgive debt before adding units. */
+		Diff = Max - OldMax;
+		Taken = (UnixSemaphore->MxDebt[0] < Diff ? UnixSemaphore->MxDebt[0] : Diff);
+		UnixSemaphore->MxDebt[0] -= Taken;
+		UnixSemaphore->MxCount[0] += Diff - Taken;
+
+		if (UnixSemaphore->MxFair != NULL)  sync_GrantUnixSemaphoreFair(UnixSemaphore);
+		else if (Diff > Taken)  pthread_cond_broadcast(UnixSemaphore->MxCond);
+	}
+	else if (Max < OldMax)
+	{
+		Diff = OldMax - Max;
+		Taken = (UnixSemaphore->MxCount[0] < Diff ? UnixSemaphore->MxCount[0] : Diff);
+		UnixSemaphore->MxCount[0] -= Taken;
+		UnixSemaphore->MxDebt[0] += Diff - Taken;
+	}
+
+	UnixSemaphore->MxMax[0] = Max;
+
+	pthread_mutex_unlock(UnixSemaphore->MxMutex);
+
+	return 1;
+}
+
+uint32_t sync_GetUnixSemaphoreValue(sync_UnixSemaphoreWrapper *UnixSemaphore)
+{
+	return UnixSemaphore->MxCount[0];
+}
+
+#endif
+
+int sync_WaitForUnixSemaphore(sync_UnixSemaphoreWrapper *UnixSemaphore, uint64_t Deadline)
+{
+	return sync_WaitForUnixSemaphoreCount(UnixSemaphore, 1, Deadline);
+}
+
+int sync_ReleaseUnixSemaphore(sync_UnixSemaphoreWrapper *UnixSemaphore, uint32_t *PrevVal)
+{
+	return sync_ReleaseUnixSemaphoreCount(UnixSemaphore, 1, PrevVal);
+}
+
+/* Robust ownership for semaphores used as locks (a maximum of 1).  The holder records its process next to the count. */
+/* Waiters check on the holder now and then and the first one to notice that it died takes the lock over. */
+#define SYNC_UNIX_LOCK_ABANDONED       2
+
+int sync_TakeOverUnixSemaphore(sync_UnixSemaphoreWrapper *UnixSemaphore)
+{
+	uint64_t Owner = __atomic_load_n(UnixSemaphore->MxOwner, __ATOMIC_ACQUIRE);
+
+	if (!Owner || sync_IsUnixOwnerAlive(Owner))  return 0;
+
+	return __atomic_compare_exchange_n(UnixSemaphore->MxOwner, &Owner, sync_GetUnixProcessOwner(), 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/* Waits for one slice.  Unlike sync_WaitForUnixSemaphoreCount(), a fair waiter keeps its place in the queue when the slice times out. */
+static inline int sync_WaitForUnixSemaphoreSlice(sync_UnixSemaphoreWrapper *UnixSemaphore, uint32_t Count, uint64_t Deadline)
+{
+	if (UnixSemaphore->MxFair != NULL)  return sync_WaitForUnixSemaphoreFair(UnixSemaphore, Count, Deadline);
+
+	return sync_WaitForUnixSemaphoreCount(UnixSemaphore, Count, Deadline);
+}
+
+/* Returns SYNC_UNIX_LOCK_ABANDONED instead of 1 when the lock was taken over from a dead process.  A zero wait never checks on the holder. */
+int sync_WaitForUnixSemaphoreOwner(sync_UnixSemaphoreWrapper *UnixSemaphore, uint64_t Deadline)
+{
+	uint64_t Deadline2;
+
+	for (;;)
+	{
+		Deadline2 = sync_GetUnixOwnerCheckDeadline(Deadline);
+
+		if (sync_WaitForUnixSemaphoreSlice(UnixSemaphore, 1, Deadline2))  break;
+
+		if (Deadline == SYNC_DEADLINE_NOWAIT)  return 0;
+
+		/* A fair waiter whose slot was granted in the meantime got the lock the normal way. */
+		if (sync_TakeOverUnixSemaphore(UnixSemaphore))  return (sync_CancelUnixSemaphoreFair(UnixSemaphore) ? 1 : SYNC_UNIX_LOCK_ABANDONED);
+
+		if (Deadline2 == Deadline)
+		{
+			if (!sync_CancelUnixSemaphoreFair(UnixSemaphore))  return 0;
+
+			break;
+		}
+	}
+
+	__atomic_store_n(UnixSemaphore->MxOwner, sync_GetUnixProcessOwner(), __ATOMIC_RELAXED);
+
+	return 1;
+}
+
+int sync_ReleaseUnixSemaphoreOwner(sync_UnixSemaphoreWrapper *UnixSemaphore)
+{
+	/* The next holder records itself after the release, so this has to come first. */
+	__atomic_store_n(UnixSemaphore->MxOwner, 0, __ATOMIC_RELEASE);
+
+	return sync_ReleaseUnixSemaphore(UnixSemaphore, NULL);
+}
+
+/* Priority inheritance needs a lock that the kernel knows the owner of, so those mutexes are locked through the pthread mutex itself.  Timed locks are required. */
+#if defined(HAVE_PTHREAD_MUTEXATTR_SETPROTOCOL) && defined(HAVE_PTHREAD_MUTEX_TIMEDLOCK) && defined(_POSIX_THREAD_PRIO_INHERIT) && _POSIX_THREAD_PRIO_INHERIT > 0
+#define SYNC_UNIX_PRIO_INHERIT
+#endif
+
+#ifdef SYNC_UNIX_PRIO_INHERIT
+/* Replaces an initialized mutex with one that boosts its owner to the priority of the highest waiter.  Shared ones are robust like the rest. */
+void sync_InitUnixPrioInheritMutex(pthread_mutex_t *Mutex, int Shared)
+{
+	pthread_mutexattr_t MutexAttr;
+
+	sync_InitUnixMutexAttr(&MutexAttr, Shared);
+	pthread_mutexattr_setprotocol(&MutexAttr, PTHREAD_PRIO_INHERIT);
+
+	pthread_mutex_destroy(Mutex);
+	pthread_mutex_init(Mutex, &MutexAttr);
+
+	pthread_mutexattr_destroy(&MutexAttr);
+}
+
+/* Locks a priority inheritance mutex.  Returns 1 on success, SYNC_UNIX_LOCK_ABANDONED when the previous owner died holding it, and 0 otherwise. */
+int sync_WaitForUnixPrioInheritMutex(pthread_mutex_t *Mutex, uint64_t Deadline)
+{
+	struct timespec TempTime, TempTime2;
+	uint64_t CurrTime;
+	int Result;
+
+	if (Deadline == SYNC_DEADLINE_NOWAIT)  Result = pthread_mutex_trylock(Mutex);
+	else if (Deadline == SYNC_DEADLINE_INFINITE)  Result = pthread_mutex_lock(Mutex);
+	else
+	{
+		Result = EINVAL;
+
+#ifdef HAVE_PTHREAD_MUTEX_CLOCKLOCK
+		sync_GetUnixDeadlineTimespec(&TempTime, Deadline);
+		Result = pthread_mutex_clocklock(Mutex, CLOCK_MONOTONIC, &TempTime);
+#endif
+
+		/* Kernels before Linux 5.14 only time out PI futexes against the realtime clock.  Translate the remaining time and try again if the clock was stepped. */
+		while (Result == EINVAL || Result == ETIMEDOUT)
+		{
+			CurrTime = sync_GetMonotonicTime();
+			if (CurrTime >= Deadline || sync_CSGX__ClockGetTimeRealtime(&TempTime2) == -1)
+			{
+				Result = ETIMEDOUT;
+
+				break;
+			}
+
+			sync_GetUnixDeadlineTimespec(&TempTime, (uint64_t)TempTime2.tv_sec * (uint64_t)1000000000 + (uint64_t)TempTime2.tv_nsec + (Deadline - CurrTime));
+			Result = pthread_mutex_timedlock(Mutex, &TempTime);
+		}
+	}
+
+#ifdef HAVE_PTHREAD_MUTEXATTR_SETROBUST
+	if (Result == EOWNERDEAD)
+	{
+		pthread_mutex_consistent(Mutex);
+
+		return SYNC_UNIX_LOCK_ABANDONED;
+	}
+#endif
+
+	return (Result == 0);
+}
+#endif
+
+/* Adaptive capacity for semaphores used as concurrency limits (AIMD).  The controller state follows the semaphore on its own cache line. */
+size_t sync_GetUnixSemaphoreLimiterSize()
+{
+	return SYNC_UNIX_FIELD_ALIGN + sizeof(sync_UnixSemaphoreLimiter);
+}
+
+sync_UnixSemaphoreLimiter *sync_GetUnixSemaphoreLimiter(char *Mem)
+{
+	return (sync_UnixSemaphoreLimiter *)sync_AlignUnixFieldPtr(Mem);
+}
+
+/* Called on every release while the controller is on.  A hold over the target cuts the maximum by a tenth, at most once per target interval so that a burst of slow holds doesn't collapse it. */
+/* A maximum's worth of holds under the target raises it by one. */
+void sync_UpdateUnixSemaphoreLimiter(sync_UnixSemaphoreWrapper *UnixSemaphore, sync_UnixSemaphoreLimiter *Limiter, uint64_t HoldTime, uint64_t CurrTime)
+{
+	uint64_t Target = __atomic_load_n(&Limiter->MxTarget, __ATOMIC_RELAXED), Last;
+	uint32_t Max = __atomic_load_n(UnixSemaphore->MxMax, __ATOMIC_RELAXED), NewMax, Fast;
+
+	if (!Target)  return;
+
+	if (HoldTime > Target)
+	{
+		Last = __atomic_load_n(&Limiter->MxLastDecrease, __ATOMIC_RELAXED);
+		if (CurrTime - Last < Target || Max <= Limiter->MxMin)  return;
+
+		/* Only one process makes the cut. */
+		if (!__atomic_compare_exchange_n(&Limiter->MxLastDecrease, &Last, CurrTime, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))  return;
+
+		__atomic_store_n(&Limiter->MxFast, 0, __ATOMIC_RELAXED);
+
+		NewMax = Max - (Max / 10 > 1 ? Max / 10 : 1);
+		if (NewMax < Limiter->MxMin)  NewMax = Limiter->MxMin;
+
+		sync_SetUnixSemaphoreMax(UnixSemaphore, NewMax);
+	}
+	else if (Max < Limiter->MxMax)
+	{
+		Fast = __atomic_add_fetch(&Limiter->MxFast, 1, __ATOMIC_RELAXED);
+		if (Fast < Max || !__atomic_compare_exchange_n(&Limiter->MxFast, &Fast, 0, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))  return;
+
+		sync_SetUnixSemaphoreMax(UnixSemaphore, Max + 1);
+	}
+}
+
+/* Optional holder tables for semaphores with any number of units.  One slot per unit records the process holding it. */
+/* A slot is always cleared before its unit is released, so whoever acquires a unit finds a free slot. */
+size_t sync_GetUnixSemaphoreHoldersSize(uint32_t Slots)
+{
+	if (!Slots)  return 0;
+
+	return SYNC_UNIX_FIELD_ALIGN + (size_t)Slots * sizeof(uint64_t);
+}
+
+volatile uint64_t *sync_GetUnixSemaphoreHolders(char *Mem)
+{
+	return (volatile uint64_t *)sync_AlignUnixFieldPtr(Mem);
+}
+
+void sync_AddUnixSemaphoreHolder(volatile uint64_t *Holders, uint32_t Slots, uint32_t Count)
+{
+	uint64_t Owner = sync_GetUnixProcessOwner(), Expected;
+	uint32_t x;
+
+	for (x = 0; x < Slots && Count; x++)
+	{
+		Expected = 0;
+		if (!__atomic_load_n(&Holders[x], __ATOMIC_RELAXED) && __atomic_compare_exchange_n(&Holders[x], &Expected, Owner, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))  Count--;
+	}
+}
+
+/* Any slot recorded by this process will do.  Nothing is cleared when the process didn't acquire a unit (e.g. a producer signaling a consumer).  Returns the number of slots cleared. */
+uint32_t sync_RemoveUnixSemaphoreHolder(volatile uint64_t *Holders, uint32_t Slots, uint32_t Count)
+{
+	uint64_t Owner = sync_GetUnixProcessOwner(), Expected;
+	uint32_t x, Result = 0;
+
+	for (x = 0; x < Slots && Result < Count; x++)
+	{
+		Expected = Owner;
+		if (__atomic_load_n(&Holders[x], __ATOMIC_RELAXED) == Owner && __atomic_compare_exchange_n(&Holders[x], &Expected, 0, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))  Result++;
+	}
+
+	return Result;
+}
+
+/* Releases the units held by processes that died.  Returns the number of units released. */
+uint32_t sync_ReclaimUnixSemaphoreHolders(sync_UnixSemaphoreWrapper *UnixSemaphore, volatile uint64_t *Holders, uint32_t Slots)
+{
+	uint64_t Self = sync_GetUnixProcessOwner(), Owner;
+	uint32_t x, Result = 0;
+
+	for (x = 0; x < Slots; x++)
+	{
+		Owner = __atomic_load_n(&Holders[x], __ATOMIC_ACQUIRE);
+		if (!Owner || Owner == Self || sync_IsUnixOwnerAlive(Owner))  continue;
+
+		/* Only the waiter that clears the slot releases the unit. */
+		if (__atomic_compare_exchange_n(&Holders[x], &Owner, 0, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+		{
+			sync_ReleaseUnixSemaphore(UnixSemaphore, NULL);
+
+			Result++;
+		}
+	}
+
+	return Result;
+}
+
+/* Waits in the same slices as lock owners and reclaims units from dead holders whenever a slice times out.  A zero wait never reclaims. */
+int sync_WaitForUnixSemaphoreHolder(sync_UnixSemaphoreWrapper *UnixSemaphore, volatile uint64_t *Holders, uint32_t Slots, uint32_t Count, uint64_t Deadline)
+{
+	uint64_t Deadline2;
+
+	for (;;)
+	{
+		Deadline2 = sync_GetUnixOwnerCheckDeadline(Deadline);
+
+		/* In fair mode, reclaimed units go to the front of the queue, which may well be this waiter. */
+		if (sync_WaitForUnixSemaphoreSlice(UnixSemaphore, Count, Deadline2) || (Deadline != SYNC_DEADLINE_NOWAIT && sync_ReclaimUnixSemaphoreHolders(UnixSemaphore, Holders, Slots) && sync_WaitForUnixSemaphoreSlice(UnixSemaphore, Count, SYNC_DEADLINE_NOWAIT)))  break;
+
+		if (Deadline2 == Deadline)
+		{
+			if (!sync_CancelUnixSemaphoreFair(UnixSemaphore))  return 0;
+
+			break;
+		}
+	}
+
+	sync_AddUnixSemaphoreHolder(Holders, Slots, Count);
+
+	return 1;
+}
+
+void sync_FreeUnixSemaphore(sync_UnixSemaphoreWrapper *UnixSemaphore)
+{
+	pthread_mutex_destroy(UnixSemaphore->MxMutex);
+	pthread_cond_destroy(UnixSemaphore->MxCond);
+}
+
+/* Basic *NIX striped mutex functions. */
+/* A striped mutex is an array of semaphores in one block of memory.  Each stripe gets its own cache lines. */
+size_t sync_GetUnixStripedMutexSize(uint32_t Stripes)
+{
+	return SYNC_UNIX_FIELD_ALIGN + (size_t)Stripes * sync_AlignUnixField(sync_GetUnixSemaphoreSize());
+}
+
+char *sync_GetUnixStripedMutexStripe(char *Mem, uint32_t Stripe)
+{
+	return sync_AlignUnixFieldPtr(Mem) + (size_t)Stripe * sync_AlignUnixField(sync_GetUnixSemaphoreSize());
+}
+
+/* The object's own segment only holds the options and statistics, so it is the same for every stripe count.  The stripes are in a side segment. */
+#define SYNC_UNIX_STRIPED_MUTEX_MEM_SIZE   sizeof(uint32_t)
+
+/* Basic *NIX Event functions. */
+size_t sync_GetUnixEventSize()
+{
+	return sync_AlignUnixSize(sizeof(pthread_mutex_t)) + sync_AlignUnixSize(2) + sync_AlignUnixSize(sizeof(uint32_t)) + sync_AlignUnixSize(sizeof(pthread_cond_t));
+}
+
+void sync_GetUnixEvent(sync_UnixEventWrapper *Result, char *Mem, uint32_t SpinLimit)
+{
+	Result->MxSpinLimit = SpinLimit;
+	Result->MxSpin = 0;
+
+	Result->MxMutex = (pthread_mutex_t *)(Mem);
+	Mem += sync_AlignUnixSize(sizeof(pthread_mutex_t));
+
+	Result->MxManual = Mem;
+	Result->MxSignaled = Mem + 1;
+	Mem += sync_AlignUnixSize(2);
+
+	Result->MxWaiting = (uint32_t *)(Mem);
+	Mem += sync_AlignUnixSize(sizeof(uint32_t));
+
+	Result->MxCond = (pthread_cond_t *)(Mem);
+}
+
+void sync_InitUnixEvent(sync_UnixEventWrapper *UnixEvent, int Shared, int Manual, int Signaled)
+{
+	pthread_mutexattr_t MutexAttr;
+	pthread_condattr_t CondAttr;
+
+	sync_InitUnixMutexAttr(&MutexAttr, Shared);
+	sync_InitUnixCondAttr(&CondAttr, Shared);
+
+	pthread_mutex_init(UnixEvent->MxMutex, &MutexAttr);
+	UnixEvent->MxManual[0] = (Manual ? '\x01' : '\x00');
+	UnixEvent->MxSignaled[0] = (Signaled ? '\x01' : '\x00');
+	UnixEvent->MxWaiting[0] = 0;
+	pthread_cond_init(UnixEvent->MxCond, &CondAttr);
+
+	pthread_condattr_destroy(&CondAttr);
+	pthread_mutexattr_destroy(&MutexAttr);
+}
+
+int sync_WaitForUnixEvent(sync_UnixEventWrapper *UnixEvent, uint64_t Deadline)
+{
+	if (Deadline == SYNC_DEADLINE_NOWAIT)
+	{
+		/* Avoid the scenario of deadlock on the semaphore itself for 0 wait. */
+		if (sync_RecoverUnixMutex(UnixEvent->MxMutex, pthread_mutex_trylock(UnixEvent->MxMutex)) != 0)  return 0;
+	}
+	else
+	{
+		if (UnixEvent->MxSignaled[0] == '\x00' && UnixEvent->MxSpinLimit)
+		{
+			uint32_t x, y = sync_GetUnixSpinBudget(UnixEvent->MxSpin, UnixEvent->MxSpinLimit);
+
+			for (x = 0; x < y && UnixEvent->MxSignaled[0] == '\x00'; x++)  sync_UnixCpuRelax();
+			sync_UpdateUnixSpin(&UnixEvent->MxSpin, x);
+		}
+
+		if (sync_RecoverUnixMutex(UnixEvent->MxMutex, pthread_mutex_lock(UnixEvent->MxMutex)) != 0)  return 0;
+	}
+
+	int Result = 0;
+
+	/* Avoid a potential starvation issue by only allowing signaled manual events OR if there are no other waiting threads. */
+	if (UnixEvent->MxSignaled[0] != '\x00' && (UnixEvent->MxManual[0] != '\x00' || !UnixEvent->MxWaiting[0]))
+	{
+		/* Reset auto events. */
+		if (UnixEvent->MxManual[0] == '\x00')  UnixEvent->MxSignaled[0] = '\x00';
+
+		Result = 1;
+	}
+	else if (Deadline == SYNC_DEADLINE_INFINITE)
+	{
+		UnixEvent->MxWaiting[0]++;
+
+		int Result2;
+		do
+		{
+			SYNC_PROBE1(sleep, (uintptr_t)UnixEvent->MxCond);
+			Result2 = sync_RecoverUnixMutex(UnixEvent->MxMutex, pthread_cond_wait(UnixEvent->MxCond, UnixEvent->MxMutex));
+			SYNC_PROBE1(wakeup, (uintptr_t)UnixEvent->MxCond);
+			if (Result2 != 0)  break;
+		} while (UnixEvent->MxSignaled[0] == '\x00');
+
+		UnixEvent->MxWaiting[0]--;
+
+		if (Result2 == 0)
+		{
+			/* Reset auto events. */
+			if (UnixEvent->MxManual[0] == '\x00')  UnixEvent->MxSignaled[0] = '\x00';
+
+			Result = 1;
+		}
+	}
+	else if (Deadline == SYNC_DEADLINE_NOWAIT)
+	{
+		/* Failed to obtain lock.  Nothing to do. */
+	}
+	else
+	{
+		UnixEvent->MxWaiting[0]++;
+
+		int Result2;
+		do
+		{
+			/* Some platforms have pthread_cond_timedwait() but not pthread_mutex_timedlock() or sem_timedwait() (e.g. Mac OSX). */
+			SYNC_PROBE1(sleep, (uintptr_t)UnixEvent->MxCond);
+			Result2 = sync_RecoverUnixMutex(UnixEvent->MxMutex, sync_UnixCondTimedWait(UnixEvent->MxCond, UnixEvent->MxMutex, Deadline));
+			SYNC_PROBE1(wakeup, (uintptr_t)UnixEvent->MxCond);
+			if (Result2 != 0)  break;
+		} while (UnixEvent->MxSignaled[0] == '\x00');
+
+		UnixEvent->MxWaiting[0]--;
+
+		if (Result2 == 0)
+		{
+			/* Reset auto events. */
+			if (UnixEvent->MxManual[0] == '\x00')  UnixEvent->MxSignaled[0] = '\x00';
+
+			Result = 1;
+		}
+	}
+
+	pthread_mutex_unlock(UnixEvent->MxMutex);
+
+	return Result;
+}
+
+int sync_FireUnixEvent(sync_UnixEventWrapper *UnixEvent)
+{
+	if (sync_RecoverUnixMutex(UnixEvent->MxMutex, pthread_mutex_lock(UnixEvent->MxMutex)) != 0)  return 0;
+
+	UnixEvent->MxSignaled[0] = '\x01';
+
+	/* Let all waiting threads through for manual events, otherwise just one waiting thread (if any). */
+	if (UnixEvent->MxManual[0] != '\x00')  pthread_cond_broadcast(UnixEvent->MxCond);
+	else  pthread_cond_signal(UnixEvent->MxCond);
+
+	pthread_mutex_unlock(UnixEvent->MxMutex);
+
+	return 1;
+}
+
+/* Only call for manual events. */
+int sync_ResetUnixEvent(sync_UnixEventWrapper *UnixEvent)
+{
+	if (UnixEvent->MxManual[0] == '\x00')  return 0;
+	if (sync_RecoverUnixMutex(UnixEvent->MxMutex, pthread_mutex_lock(UnixEvent->MxMutex)) != 0)  return 0;
+
+	UnixEvent->MxSignaled[0] = '\x00';
+
+	pthread_mutex_unlock(UnixEvent->MxMutex);
+
+	return 1;
+}
+
+void sync_FreeUnixEvent(sync_UnixEventWrapper *UnixEvent)
+{
+	pthread_mutex_destroy(UnixEvent->MxMutex);
+	pthread_cond_destroy(UnixEvent->MxCond);
+}
+
+/* Waiting on several events at once.  Every event has its own mutex and condition variable and a process firing one event doesn't map the others, so there is nothing to sleep on in common. */
+/* Instead, all processes share one bell.  Firing an event rings it while anyone waits on several events, and those waiters check their events again. */
+static pthread_mutex_t sync_UnixEventBellMutex = PTHREAD_MUTEX_INITIALIZER;
+static char *sync_UnixEventBellMem = NULL;
+static sync_UnixEventBellWrapper sync_UnixEventBell;
+
+size_t sync_GetUnixEventBellSize()
+{
+#ifdef SYNC_UNIX_FUTEX
+	return SYNC_UNIX_FIELD_ALIGN + sync_AlignUnixField(sizeof(uint32_t)) * 2;
+#else
+	return SYNC_UNIX_FIELD_ALIGN + sync_AlignUnixField(sync_AlignUnixSize(sizeof(pthread_mutex_t)) + sync_AlignUnixSize(sizeof(pthread_cond_t)) + sync_AlignUnixSize(sizeof(uint32_t))) + sync_AlignUnixField(sizeof(uint32_t));
+#endif
+}
+
+/* A forked child inherits the mapping but not a reference to it.  Take one so the child's module shutdown doesn't drop the parent's. */
+static void sync_UnixEventBellAtForkPrepare()
+{
+	pthread_mutex_lock(&sync_UnixEventBellMutex);
+}
+
+static void sync_UnixEventBellAtForkParent()
+{
+	pthread_mutex_unlock(&sync_UnixEventBellMutex);
+}
+
+static void sync_UnixEventBellAtForkChild()
+{
+	pthread_mutex_t *MutexPtr;
+
+	if (sync_UnixEventBellMem != NULL)
+	{
+		MutexPtr = (pthread_mutex_t *)(sync_UnixEventBellMem + sync_AlignUnixSize(1));
+
+		sync_RecoverUnixMutex(MutexPtr, pthread_mutex_lock(MutexPtr));
+		((uint32_t *)(sync_UnixEventBellMem + sync_AlignUnixSize(1) + sync_AlignUnixSize(sizeof(pthread_mutex_t))))[0]++;
+		pthread_mutex_unlock(MutexPtr);
+	}
+
+	pthread_mutex_unlock(&sync_UnixEventBellMutex);
+}
+
+/* Maps the bell the first time a process needs it.  It stays mapped until the process exits and forked children inherit it. */
+sync_UnixEventBellWrapper *sync_GetUnixEventBell()
+{
+	static int AtFork = 0;
+	char *Mem;
+	size_t Pos;
+	int Result;
+
+	if (__atomic_load_n(&sync_UnixEventBellMem, __ATOMIC_ACQUIRE) != NULL)  return &sync_UnixEventBell;
+
+	pthread_mutex_lock(&sync_UnixEventBellMutex);
+
+	/* Registered before the bell is mapped, so no fork can miss the reference. */
+	if (!AtFork)
+	{
+		pthread_atfork(sync_UnixEventBellAtForkPrepare, sync_UnixEventBellAtForkParent, sync_UnixEventBellAtForkChild);
+
+		AtFork = 1;
+	}
+
+	if (sync_UnixEventBellMem == NULL)
+	{
+		Result = sync_InitUnixNamedMem(&Mem, &Pos, "/Sync_EventBell", "bell", sync_GetUnixEventBellSize());
+		if (Result > -1)
+		{
+			char *MemPtr = sync_AlignUnixFieldPtr(Mem + Pos);
+
+#ifndef SYNC_UNIX_FUTEX
+			sync_UnixEventBell.MxMutex = (pthread_mutex_t *)(MemPtr);
+			sync_UnixEventBell.MxCond = (pthread_cond_t *)(MemPtr + sync_AlignUnixSize(sizeof(pthread_mutex_t)));
+			sync_UnixEventBell.MxSeq = (uint32_t *)(MemPtr + sync_AlignUnixSize(sizeof(pthread_mutex_t)) + sync_AlignUnixSize(sizeof(pthread_cond_t)));
+			MemPtr += sync_AlignUnixField(sync_AlignUnixSize(sizeof(pthread_mutex_t)) + sync_AlignUnixSize(sizeof(pthread_cond_t)) + sync_AlignUnixSize(sizeof(uint32_t)));
+#else
+			sync_UnixEventBell.MxSeq = (uint32_t *)(MemPtr);
+			MemPtr += sync_AlignUnixField(sizeof(uint32_t));
+#endif
+			sync_UnixEventBell.MxWaiters = (uint32_t *)(MemPtr);
+
+			/* Handle the first time the bell has been opened.  Fresh memory is already zeroed. */
+			if (Result == 0)
+			{
+#ifndef SYNC_UNIX_FUTEX
+				pthread_mutexattr_t MutexAttr;
+				pthread_condattr_t CondAttr;
+
+				sync_InitUnixMutexAttr(&MutexAttr, 1);
+				sync_InitUnixCondAttr(&CondAttr, 1);
+
+				pthread_mutex_init(sync_UnixEventBell.MxMutex, &MutexAttr);
+				pthread_cond_init(sync_UnixEventBell.MxCond, &CondAttr);
+
+				pthread_condattr_destroy(&CondAttr);
+				pthread_mutexattr_destroy(&MutexAttr);
+#endif
+
+				sync_UnixNamedMemReady(Mem);
+			}
+
+			__atomic_store_n(&sync_UnixEventBellMem, Mem, __ATOMIC_RELEASE);
+		}
+	}
+
+	pthread_mutex_unlock(&sync_UnixEventBellMutex);
+
+	return (sync_UnixEventBellMem != NULL ? &sync_UnixEventBell : NULL);
+}
+
+void sync_FreeUnixEventBell()
+{
+	if (sync_UnixEventBellMem == NULL)  return;
+
+	sync_UnmapUnixNamedMem(sync_UnixEventBellMem, sync_GetUnixEventBellSize());
+	sync_UnixEventBellMem = NULL;
+}
+
+/* Call after firing an event.  Costs a fence and a load unless someone waits on several events. */
+void sync_RingUnixEventBell()
+{
+	sync_UnixEventBellWrapper *Bell;
+
+	if (__atomic_load_n(&sync_UnixEventBellMem, __ATOMIC_ACQUIRE) == NULL)  return;
+	Bell = &sync_UnixEventBell;
+
+	/* Pairs with the waiter registering itself before checking its events. */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(Bell->MxWaiters, __ATOMIC_RELAXED))  return;
+
+#ifdef SYNC_UNIX_FUTEX
+	__atomic_fetch_add(Bell->MxSeq, 1, __ATOMIC_RELEASE);
+	sync_UnixFutexWake(Bell->MxSeq, INT_MAX);
+#else
+	if (sync_RecoverUnixMutex(Bell->MxMutex, pthread_mutex_lock(Bell->MxMutex)) != 0)  return;
+
+	__atomic_fetch_add(Bell->MxSeq, 1, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(Bell->MxCond);
+
+	pthread_mutex_unlock(Bell->MxMutex);
+#endif
+}
+
+/* Takes an event if it is signaled without waiting for it.  Unlike a wait with SYNC_DEADLINE_NOWAIT, a busy event mutex is waited for, since it may be held by the process firing the event. */
+int sync_PollUnixEvent(sync_UnixEventWrapper *UnixEvent)
+{
+	int Result = 0;
+
+	if (sync_RecoverUnixMutex(UnixEvent->MxMutex, pthread_mutex_lock(UnixEvent->MxMutex)) != 0)  return 0;
+
+	/* Same rule as sync_WaitForUnixEvent():  Threads waiting on just this auto event come first. */
+	if (UnixEvent->MxSignaled[0] != '\x00' && (UnixEvent->MxManual[0] != '\x00' || !UnixEvent->MxWaiting[0]))
+	{
+		if (UnixEvent->MxManual[0] == '\x00')  UnixEvent->MxSignaled[0] = '\x00';
+
+		Result = 1;
+	}
+
+	pthread_mutex_unlock(UnixEvent->MxMutex);
+
+	return Result;
+}
+
+/* Waits until any (All = 0) or all (All = 1) of the events fire.  Only one event mutex is held at a time. */
+/* Taken tracks the events that fired so far and must start out zeroed.  For any, Index receives the event that fired. */
+/* Auto events are taken as they fire, so when waiting for all of them times out, the ones already taken are fired again. */
+/* Returns 1 on success, 0 on timeout, and -1 when the bell isn't available. */
+int sync_WaitForUnixEvents(sync_UnixEventWrapper **UnixEvents, char *Taken, uint32_t Num, int All, uint64_t Deadline, uint32_t *Index)
+{
+	sync_UnixEventBellWrapper *Bell = sync_GetUnixEventBell();
+	struct timespec TempTime;
+	uint32_t x, y, Seq;
+	int Result = 0;
+
+	if (Bell == NULL)  return -1;
+
+	__atomic_fetch_add(Bell->MxWaiters, 1, __ATOMIC_SEQ_CST);
+
+	if (Deadline != SYNC_DEADLINE_INFINITE)  sync_GetUnixDeadlineTimespec(&TempTime, Deadline);
+
+	for (;;)
+	{
+		/* A ring after this point changes the sequence number and the sleep below returns right away. */
+		Seq = __atomic_load_n(Bell->MxSeq, __ATOMIC_ACQUIRE);
+
+		for (x = 0, y = 0; x < Num; x++)
+		{
+			if (!Taken[x] && sync_PollUnixEvent(UnixEvents[x]))
+			{
+				Taken[x] = 1;
+
+				if (!All)
+				{
+					*Index = x;
+
+					break;
+				}
+			}
+
+			if (Taken[x])  y++;
+		}
+
+		if ((!All && x < Num) || (All && y == Num))
+		{
+			Result = 1;
+
+			break;
+		}
+
+		if (Deadline == SYNC_DEADLINE_NOWAIT || (Deadline != SYNC_DEADLINE_INFINITE && sync_GetMonotonicTime() >= Deadline))  break;
+
+#ifdef SYNC_UNIX_FUTEX
+		sync_UnixFutexWait(Bell->MxSeq, Seq, (Deadline == SYNC_DEADLINE_INFINITE ? NULL : &TempTime));
+#else
+		if (sync_RecoverUnixMutex(Bell->MxMutex, pthread_mutex_lock(Bell->MxMutex)) != 0)  break;
+
+		while (Bell->MxSeq[0] == Seq)
+		{
+			SYNC_PROBE1(sleep, (uintptr_t)Bell->MxCond);
+			if (Deadline == SYNC_DEADLINE_INFINITE)  y = sync_RecoverUnixMutex(Bell->MxMutex, pthread_cond_wait(Bell->MxCond, Bell->MxMutex));
+			else  y = sync_RecoverUnixMutex(Bell->MxMutex, sync_UnixCondTimedWait(Bell->MxCond, Bell->MxMutex, Deadline));
+			SYNC_PROBE1(wakeup, (uintptr_t)Bell->MxCond);
+
+			if (y != 0)  break;
+		}
+
+		pthread_mutex_unlock(Bell->MxMutex);
+#endif
+	}
+
+	__atomic_fetch_sub(Bell->MxWaiters, 1, __ATOMIC_RELEASE);
+
+	if (!Result && All)
+	{
+		for (x = 0, y = 0; x < Num; x++)
+		{
+			if (Taken[x] && UnixEvents[x]->MxManual[0] == '\x00' && sync_FireUnixEvent(UnixEvents[x]))  y++;
+		}
+
+		if (y)  sync_RingUnixEventBell();
+	}
+
+	return Result;
+}
+
+/* Basic *NIX Reader-Writer functions. */
+#ifdef SYNC_UNIX_FUTEX
+
+/* The state word holds the number of readers plus writer and sleeping reader flags. */
+/* Readers enter with a single atomic add.  A writer sets its flag to block new readers and then waits for existing readers to drain. */
+/* Blocked readers sleep on the gate word, which the writer bumps when it lets go. */
+#define SYNC_UNIX_RW_READERS           0x3FFFFFFFU
+#define SYNC_UNIX_RW_WRITER            0x40000000U
+#define SYNC_UNIX_RW_READERS_WAITING   0x80000000U
+
+/* Big-reader mode moves the reader count out of the state word into per-CPU slots so readers don't share a cache line. */
+/* A reader may unlock on a different slot than it locked on, so slots are signed and only their sum is meaningful. */
+/* Readers leaving while a writer is waiting bump the drain word to wake the writer for another scan. */
+#define SYNC_UNIX_RW_MAX_SLOTS         1024
+
+/* Readers hit the state word, sleeping readers watch the gate, leaving readers bump the drain, and only writers touch the writer semaphore, so each one gets its own cache line. */
+size_t sync_GetUnixReaderWriterSize()
+{
+	return SYNC_UNIX_FIELD_ALIGN + sync_AlignUnixField(sizeof(uint32_t)) * 3 + sync_AlignUnixField(sync_GetUnixSemaphoreSize());
+}
+
+/* The slots live in separate memory, so the lock itself is the same size in either mode. */
+size_t sync_GetUnixReaderWriterSlotsSize(uint32_t Slots)
+{
+	if (Slots > SYNC_UNIX_RW_MAX_SLOTS)  Slots = SYNC_UNIX_RW_MAX_SLOTS;
+	if (!Slots)  return 0;
+
+	return SYNC_UNIX_CACHE_LINE_SIZE + (size_t)Slots * SYNC_UNIX_CACHE_LINE_SIZE;
+}
+
+void sync_GetUnixReaderWriter(sync_UnixReaderWriterWrapper *Result, char *Mem, uint32_t SpinLimit)
+{
+	Result->MxSpinLimit = SpinLimit;
+	Result->MxSpin = 0;
+
+	Mem = sync_AlignUnixFieldPtr(Mem);
+
+	Result->MxState = (volatile uint32_t *)(Mem);
+	Mem += sync_AlignUnixField(sizeof(uint32_t));
+
+	Result->MxGate = (volatile uint32_t *)(Mem);
+	Mem += sync_AlignUnixField(sizeof(uint32_t));
+
+	Result->MxDrain = (volatile uint32_t *)(Mem);
+	Mem += sync_AlignUnixField(sizeof(uint32_t));
+
+	sync_GetUnixSemaphore(&Result->MxWWaitMutex, Mem, SpinLimit);
+
+	Result->MxSlots = 0;
+	Result->MxSlotMem = NULL;
+}
+
+/* Switches to big-reader mode.  Mem holds sync_GetUnixReaderWriterSlotsSize() bytes, zeroed when the lock is created. */
+void sync_SetUnixReaderWriterSlots(sync_UnixReaderWriterWrapper *Result, char *Mem, uint32_t Slots)
+{
+	/* The slots start on a cache line boundary. */
+	if (Slots > SYNC_UNIX_RW_MAX_SLOTS)  Slots = SYNC_UNIX_RW_MAX_SLOTS;
+	Result->MxSlots = Slots;
+	Result->MxSlotMem = (Slots ? (char *)(((uintptr_t)Mem + SYNC_UNIX_CACHE_LINE_SIZE - 1) & ~(uintptr_t)(SYNC_UNIX_CACHE_LINE_SIZE - 1)) : NULL);
+}
+
+void sync_InitUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter, int Shared)
+{
+	UnixReaderWriter->MxState[0] = 0;
+	UnixReaderWriter->MxGate[0] = 0;
+	UnixReaderWriter->MxDrain[0] = 0;
+	sync_InitUnixSemaphore(&UnixReaderWriter->MxWWaitMutex, Shared, 1, 1);
+}
+
+static inline volatile int32_t *sync_GetUnixReaderWriterSlot(sync_UnixReaderWriterWrapper *UnixReaderWriter)
+{
+	return (volatile int32_t *)(UnixReaderWriter->MxSlotMem + (sync_GetUnixCpuSlot() % UnixReaderWriter->MxSlots) * SYNC_UNIX_CACHE_LINE_SIZE);
+}
+
+static uint32_t sync_GetUnixReaderWriterSlotReaders(sync_UnixReaderWriterWrapper *UnixReaderWriter)
+{
+	uint32_t x, Result = 0;
+
+	for (x = 0; x < UnixReaderWriter->MxSlots; x++)  Result += (uint32_t)__atomic_load_n((volatile int32_t *)(UnixReaderWriter->MxSlotMem + x * SYNC_UNIX_CACHE_LINE_SIZE), __ATOMIC_SEQ_CST);
+
+	return Result;
+}
+
+/* Removes one reader.  The last reader out wakes a writer that is waiting for readers to drain. */
+static inline void sync_LeaveUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter, uint32_t Val)
+{
+	if ((Val & (SYNC_UNIX_RW_READERS | SYNC_UNIX_RW_WRITER)) == (1 | SYNC_UNIX_RW_WRITER))  sync_UnixFutexWake(UnixReaderWriter->MxState, 1);
+}
+
+/* Removes one reader from a slot.  Any reader might be the last one, so a waiting writer always rescans. */
+static inline void sync_LeaveUnixReaderWriterSlot(sync_UnixReaderWriterWrapper *UnixReaderWriter, volatile int32_t *Slot)
+{
+	__atomic_fetch_sub(Slot, 1, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(UnixReaderWriter->MxState, __ATOMIC_SEQ_CST) & SYNC_UNIX_RW_WRITER)
+	{
+		__atomic_fetch_add(UnixReaderWriter->MxDrain, 1, __ATOMIC_SEQ_CST);
+		sync_UnixFutexWake(UnixReaderWriter->MxDrain, 1);
+	}
+}
+
+/* Attempts to add a reader when no writer is around. */
+static inline int sync_EnterUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter, uint32_t Val)
+{
+	volatile int32_t *Slot;
+
+	if (!UnixReaderWriter->MxSlots)  return __atomic_compare_exchange_n(UnixReaderWriter->MxState, &Val, Val + 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+
+	/* Announce the reader before checking for a writer.  The writer does the opposite, so at least one of them sees the other. */
+	Slot = sync_GetUnixReaderWriterSlot(UnixReaderWriter);
+	__atomic_fetch_add(Slot, 1, __ATOMIC_SEQ_CST);
+	if (!(__atomic_load_n(UnixReaderWriter->MxState, __ATOMIC_SEQ_CST) & SYNC_UNIX_RW_WRITER))  return 1;
+
+	sync_LeaveUnixReaderWriterSlot(UnixReaderWriter, Slot);
+
+	return 0;
+}
+
+/* Clears the writer flag and lets sleeping readers through the gate. */
+static inline void sync_OpenUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter)
+{
+	uint32_t Val;
+
+	Val = __atomic_fetch_and(UnixReaderWriter->MxState, ~(SYNC_UNIX_RW_WRITER | SYNC_UNIX_RW_READERS_WAITING), __ATOMIC_SEQ_CST);
+
+	if (Val & SYNC_UNIX_RW_READERS_WAITING)
+	{
+		__atomic_fetch_add(UnixReaderWriter->MxGate, 1, __ATOMIC_SEQ_CST);
+		sync_UnixFutexWake(UnixReaderWriter->MxGate, INT_MAX);
+	}
+}
+
+/* Takes the writer semaphore over from a writer that died and lets everyone back in. */
+static int sync_RecoverUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter)
+{
+	if (!sync_TakeOverUnixSemaphore(&UnixReaderWriter->MxWWaitMutex))  return 0;
+
+	sync_OpenUnixReaderWriter(UnixReaderWriter);
+	sync_ReleaseUnixSemaphoreOwner(&UnixReaderWriter->MxWWaitMutex);
+
+	return 1;
+}
+
+/* Returns SYNC_UNIX_LOCK_ABANDONED instead of 1 when this reader had to recover from a writer that died. */
+int sync_ReadLockUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter, uint64_t Deadline)
+{
+	struct timespec TempTime;
+	uint64_t Deadline2;
+	uint32_t Val, Seq, x, y;
+	int Spun = 0, Result = 1;
+
+	if (UnixReaderWriter->MxSlots)
+	{
+		if (sync_EnterUnixReaderWriter(UnixReaderWriter, 0))  return 1;
+	}
+	else
+	{
+		Val = __atomic_fetch_add(UnixReaderWriter->MxState, 1, __ATOMIC_ACQUIRE);
+		if (!(Val & SYNC_UNIX_RW_WRITER))  return 1;
+
+		/* A writer is active or waiting.  Back out since the writer might be waiting for this reader. */
+		Val = __atomic_fetch_sub(UnixReaderWriter->MxState, 1, __ATOMIC_RELEASE);
+		sync_LeaveUnixReaderWriter(UnixReaderWriter, Val);
+	}
+
+	for (;;)
+	{
+		/* Sample the gate before the state so that a writer leaving in between is noticed by the futex. */
+		Seq = __atomic_load_n(UnixReaderWriter->MxGate, __ATOMIC_SEQ_CST);
+		Val = __atomic_load_n(UnixReaderWriter->MxState, __ATOMIC_SEQ_CST);
+
+		if (!(Val & SYNC_UNIX_RW_WRITER))
+		{
+			if (sync_EnterUnixReaderWriter(UnixReaderWriter, Val))  return Result;
+
+			continue;
+		}
+
+		if (Deadline == SYNC_DEADLINE_NOWAIT)  return 0;
+
+		if (!Spun && UnixReaderWriter->MxSpinLimit)
+		{
+			y = sync_GetUnixSpinBudget(UnixReaderWriter->MxSpin, UnixReaderWriter->MxSpinLimit);
+			for (x = 0; x < y && (UnixReaderWriter->MxState[0] & SYNC_UNIX_RW_WRITER); x++)  sync_UnixCpuRelax();
+			sync_UpdateUnixSpin(&UnixReaderWriter->MxSpin, x);
+
+			Spun = 1;
+
+			continue;
+		}
+
+		/* Flag the state so that the writer opens the gate when it leaves. */
+		if (!(Val & SYNC_UNIX_RW_READERS_WAITING) && !__atomic_compare_exchange_n(UnixReaderWriter->MxState, &Val, Val | SYNC_UNIX_RW_READERS_WAITING, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))  continue;
+
+		/* Wake up now and then to check on the writer. */
+		Deadline2 = sync_GetUnixOwnerCheckDeadline(Deadline);
+		sync_GetUnixDeadlineTimespec(&TempTime, Deadline2);
+
+		if (sync_UnixFutexWait(UnixReaderWriter->MxGate, Seq, &TempTime) == -1 && errno == ETIMEDOUT)
+		{
+			if (sync_RecoverUnixReaderWriter(UnixReaderWriter))  Result = SYNC_UNIX_LOCK_ABANDONED;
+			else if (Deadline2 == Deadline)  return 0;
+		}
+	}
+}
+
+/* In big-reader mode, the caller has to track whether it holds a read lock. */
+int sync_ReadUnlockUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter)
+{
+	uint32_t Val;
+
+	if (UnixReaderWriter->MxSlots)
+	{
+		sync_LeaveUnixReaderWriterSlot(UnixReaderWriter, sync_GetUnixReaderWriterSlot(UnixReaderWriter));
+
+		return 1;
+	}
+
+	Val = __atomic_load_n(UnixReaderWriter->MxState, __ATOMIC_RELAXED);
+	do
+	{
+		if (!(Val & SYNC_UNIX_RW_READERS))  return 0;
+	} while (!__atomic_compare_exchange_n(UnixReaderWriter->MxState, &Val, Val - 1, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	sync_LeaveUnixReaderWriter(UnixReaderWriter, Val);
+
+	return 1;
+}
+
+/* Adds a reader while holding the writer semaphore.  No writer flag can be set, so the reader gets in right away. */
+static inline void sync_AddUnixReaderWriterReader(sync_UnixReaderWriterWrapper *UnixReaderWriter)
+{
+	if (UnixReaderWriter->MxSlots)  __atomic_fetch_add(sync_GetUnixReaderWriterSlot(UnixReaderWriter), 1, __ATOMIC_SEQ_CST);
+	else  __atomic_fetch_add(UnixReaderWriter->MxState, 1, __ATOMIC_ACQUIRE);
+}
+
+/* Sets the writer flag and waits for readers to drain.  The caller holds the writer semaphore. */
+static int sync_DrainUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter, uint64_t Deadline)
+{
+	struct timespec TempTime;
+	volatile uint32_t *WaitAddr;
+	uint32_t Val, Readers, x, y;
+	int Spun = 0;
+
+	/* Block new readers.  Guarantees that readers can't starve the writer. */
+	Val = __atomic_fetch_or(UnixReaderWriter->MxState, SYNC_UNIX_RW_WRITER, __ATOMIC_SEQ_CST) | SYNC_UNIX_RW_WRITER;
+
+	/* Wait for readers to reach zero. */
+	for (;;)
+	{
+		if (UnixReaderWriter->MxSlots)
+		{
+			WaitAddr = UnixReaderWriter->MxDrain;
+			Val = __atomic_load_n(WaitAddr, __ATOMIC_SEQ_CST);
+			Readers = sync_GetUnixReaderWriterSlotReaders(UnixReaderWriter);
+		}
+		else
+		{
+			WaitAddr = UnixReaderWriter->MxState;
+			Readers = Val & SYNC_UNIX_RW_READERS;
+		}
+
+		if (!Readers)  return 1;
+
+		if (Deadline == SYNC_DEADLINE_NOWAIT)  break;
+
+		if (!Spun && UnixReaderWriter->MxSpinLimit)
+		{
+			y = sync_GetUnixSpinBudget(UnixReaderWriter->MxSpin, UnixReaderWriter->MxSpinLimit);
+			for (x = 0; x < y && WaitAddr[0] == Val; x++)  sync_UnixCpuRelax();
+			sync_UpdateUnixSpin(&UnixReaderWriter->MxSpin, x);
+
+			Spun = 1;
+		}
+		else
+		{
+			if (Deadline != SYNC_DEADLINE_INFINITE)  sync_GetUnixDeadlineTimespec(&TempTime, Deadline);
+
+			if (sync_UnixFutexWait(WaitAddr, Val, (Deadline != SYNC_DEADLINE_INFINITE ? &TempTime : NULL)) == -1 && errno == ETIMEDOUT)  break;
+		}
+
+		Val = __atomic_load_n(UnixReaderWriter->MxState, __ATOMIC_ACQUIRE);
+	}
+
+	/* Timed out.  Let blocked readers back in. */
+	sync_OpenUnixReaderWriter(UnixReaderWriter);
+
+	return 0;
+}
+
+/* Writers own the writer semaphore and return SYNC_UNIX_LOCK_ABANDONED instead of 1 when they took it over from a writer that died. */
+int sync_WriteLockUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter, uint64_t Deadline)
+{
+	/* Only one writer at a time gets to set the writer flag. */
+	int Result = sync_WaitForUnixSemaphoreOwner(&UnixReaderWriter->MxWWaitMutex, Deadline);
+	if (!Result)  return 0;
+
+	if (!sync_DrainUnixReaderWriter(UnixReaderWriter, Deadline))
+	{
+		sync_ReleaseUnixSemaphoreOwner(&UnixReaderWriter->MxWWaitMutex);
+
+		return 0;
+	}
+
+	return Result;
+}
+
+int sync_WriteUnlockUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter)
+{
+	/* The flag has to be cleared before the next writer can get in and set it again. */
+	sync_OpenUnixReaderWriter(UnixReaderWriter);
+
+	return sync_ReleaseUnixSemaphoreOwner(&UnixReaderWriter->MxWWaitMutex);
+}
+
+/* An upgradeable read lock is a read lock that also holds the writer semaphore.  It excludes writers and other upgradeable readers but not readers. */
+int sync_UpgradeLockUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter, uint64_t Deadline)
+{
+	int Result = sync_WaitForUnixSemaphoreOwner(&UnixReaderWriter->MxWWaitMutex, Deadline);
+	if (!Result)  return 0;
+
+	sync_AddUnixReaderWriterReader(UnixReaderWriter);
+
+	return Result;
+}
+
+int sync_UpgradeUnlockUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter)
+{
+	sync_ReadUnlockUnixReaderWriter(UnixReaderWriter);
+
+	return sync_ReleaseUnixSemaphoreOwner(&UnixReaderWriter->MxWWaitMutex);
+}
+
+/* Converts an upgradeable read lock into a write lock.  Other writers stay locked out the whole time. */
+int sync_UpgradeUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter, uint64_t Deadline)
+{
+	sync_ReadUnlockUnixReaderWriter(UnixReaderWriter);
+
+	if (sync_DrainUnixReaderWriter(UnixReaderWriter, Deadline))  return 1;
+
+	/* Timed out.  Stay an upgradeable reader. */
+	sync_AddUnixReaderWriterReader(UnixReaderWriter);
+
+	return 0;
+}
+
+/* Converts a write lock into a read lock.  The reader is added before anyone else is let in. */
+int sync_DowngradeUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter)
+{
+	sync_AddUnixReaderWriterReader(UnixReaderWriter);
+	sync_OpenUnixReaderWriter(UnixReaderWriter);
+
+	return sync_ReleaseUnixSemaphoreOwner(&UnixReaderWriter->MxWWaitMutex);
+}
+
+void sync_FreeUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter)
+{
+	sync_FreeUnixSemaphore(&UnixReaderWriter->MxWWaitMutex);
+}
+
+#else
+
+/* The reader count is only written while holding its mutex, so the two share cache lines.  The event and the writer semaphore get their own. */
+size_t sync_GetUnixReaderWriterSize()
+{
+	return SYNC_UNIX_FIELD_ALIGN + sync_AlignUnixField(sync_GetUnixSemaphoreSize() + sync_AlignUnixSize(sizeof(uint32_t))) + sync_AlignUnixField(sync_GetUnixEventSize()) + sync_AlignUnixField(sync_GetUnixSemaphoreSize());
+}
+
+/* Big-reader mode needs futexes.  Slots are ignored here. */
+size_t sync_GetUnixReaderWriterSlotsSize(uint32_t Slots)
+{
+	return 0;
+}
+
+void sync_GetUnixReaderWriter(sync_UnixReaderWriterWrapper *Result, char *Mem, uint32_t SpinLimit)
+{
+	Mem = sync_AlignUnixFieldPtr(Mem);
+
+	sync_GetUnixSemaphore(&Result->MxRCountMutex, Mem, SpinLimit);
+	Result->MxRCount = (volatile uint32_t *)(Mem + sync_GetUnixSemaphoreSize());
+	Mem += sync_AlignUnixField(sync_GetUnixSemaphoreSize() + sync_AlignUnixSize(sizeof(uint32_t)));
+
+	sync_GetUnixEvent(&Result->MxRWaitEvent, Mem, SpinLimit);
+	Mem += sync_AlignUnixField(sync_GetUnixEventSize());
+
+	sync_GetUnixSemaphore(&Result->MxWWaitMutex, Mem, SpinLimit);
+}
+
+void sync_SetUnixReaderWriterSlots(sync_UnixReaderWriterWrapper *Result, char *Mem, uint32_t Slots)
+{
+}
+
+void sync_InitUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter, int Shared)
+{
+	sync_InitUnixSemaphore(&UnixReaderWriter->MxRCountMutex, Shared, 1, 1);
+	UnixReaderWriter->MxRCount[0] = 0;
+	sync_InitUnixEvent(&UnixReaderWriter->MxRWaitEvent, Shared, 1, 1);
+	sync_InitUnixSemaphore(&UnixReaderWriter->MxWWaitMutex, Shared, 1, 1);
+}
+
+/* Both semaphores are owned, so a reader or writer that died holding one can be recovered.  Functions that acquire return SYNC_UNIX_LOCK_ABANDONED instead of 1 when that happened. */
+/* Adds a reader.  The caller holds the writer semaphore. */
+static int sync_AddUnixReaderWriterReader(sync_UnixReaderWriterWrapper *UnixReaderWriter, uint64_t Deadline)
+{
+	/* Acquire the counter mutex. */
+	int Result = sync_WaitForUnixSemaphoreOwner(&UnixReaderWriter->MxRCountMutex, Deadline);
+	if (!Result)  return 0;
+
+	/* Update the event state. */
+	if (!sync_ResetUnixEvent(&UnixReaderWriter->MxRWaitEvent))
+	{
+		sync_ReleaseUnixSemaphoreOwner(&UnixReaderWriter->MxRCountMutex);
+
+		return 0;
+	}
+
+	/* Increment the number of readers. */
+	UnixReaderWriter->MxRCount[0]++;
+
+	/* Release the counter mutex. */
+	sync_ReleaseUnixSemaphoreOwner(&UnixReaderWriter->MxRCountMutex);
+
+	return Result;
+}
+
+/* A single deadline covers every stage. */
+int sync_ReadLockUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter, uint64_t Deadline)
+{
+	int Result, Result2;
+
+	/* Acquire the write lock mutex.  Guarantees that readers can't starve the writer. */
+	Result = sync_WaitForUnixSemaphoreOwner(&UnixReaderWriter->MxWWaitMutex, Deadline);
+	if (!Result)  return 0;
+
+	Result2 = sync_AddUnixReaderWriterReader(UnixReaderWriter, Deadline);
+	if (!Result2)
+	{
+		sync_ReleaseUnixSemaphoreOwner(&UnixReaderWriter->MxWWaitMutex);
+
+		return 0;
+	}
+
+	/* Release the write lock mutex. */
+	sync_ReleaseUnixSemaphoreOwner(&UnixReaderWriter->MxWWaitMutex);
+
+	return (Result2 == SYNC_UNIX_LOCK_ABANDONED ? Result2 : Result);
+}
+
+int sync_ReadUnlockUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter)
+{
+	/* Acquire the counter mutex. */
+	if (!sync_WaitForUnixSemaphoreOwner(&UnixReaderWriter->MxRCountMutex, SYNC_DEADLINE_INFINITE))  return 0;
+
+	/* Decrease the number of readers. */
+	if (UnixReaderWriter->MxRCount[0])  UnixReaderWriter->MxRCount[0]--;
+	else
+	{
+		sync_ReleaseUnixSemaphoreOwner(&UnixReaderWriter->MxRCountMutex);
+
+		return 0;
+	}
+
+	/* Update the event state. */
+	if (!UnixReaderWriter->MxRCount[0] && !sync_FireUnixEvent(&UnixReaderWriter->MxRWaitEvent))
+	{
+		sync_ReleaseUnixSemaphoreOwner(&UnixReaderWriter->MxRCountMutex);
+
+		return 0;
+	}
+
+	/* Release the counter mutex. */
+	sync_ReleaseUnixSemaphoreOwner(&UnixReaderWriter->MxRCountMutex);
+
+	return 1;
+}
+
+int sync_WriteLockUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter, uint64_t Deadline)
+{
+	/* Acquire the write lock mutex. */
+	int Result = sync_WaitForUnixSemaphoreOwner(&UnixReaderWriter->MxWWaitMutex, Deadline);
+	if (!Result)  return 0;
+
+	/* Wait for readers to reach zero. */
+	if (!sync_WaitForUnixEvent(&UnixReaderWriter->MxRWaitEvent, Deadline))
+	{
+		sync_ReleaseUnixSemaphoreOwner(&UnixReaderWriter->MxWWaitMutex);
+
+		return 0;
+	}
+
+	return Result;
+}
+
+int sync_WriteUnlockUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter)
+{
+	return sync_ReleaseUnixSemaphoreOwner(&UnixReaderWriter->MxWWaitMutex);
+}
+
+/* Readers take the writer semaphore on the way in, so an upgradeable read lock holds off new readers on these platforms. */
+int sync_UpgradeLockUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter, uint64_t Deadline)
+{
+	int Result, Result2;
+
+	Result = sync_WaitForUnixSemaphoreOwner(&UnixReaderWriter->MxWWaitMutex, Deadline);
+	if (!Result)  return 0;
+
+	Result2 = sync_AddUnixReaderWriterReader(UnixReaderWriter, Deadline);
+	if (!Result2)
+	{
+		sync_ReleaseUnixSemaphoreOwner(&UnixReaderWriter->MxWWaitMutex);
+
+		return 0;
+	}
+
+	return (Result2 == SYNC_UNIX_LOCK_ABANDONED ? Result2 : Result);
+}
+
+int sync_UpgradeUnlockUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter)
+{
+	sync_ReadUnlockUnixReaderWriter(UnixReaderWriter);
+
+	return sync_ReleaseUnixSemaphoreOwner(&UnixReaderWriter->MxWWaitMutex);
+}
+
+int sync_UpgradeUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter, uint64_t Deadline)
+{
+	if (!sync_ReadUnlockUnixReaderWriter(UnixReaderWriter))  return 0;
+
+	/* Wait for readers to reach zero. */
+	if (sync_WaitForUnixEvent(&UnixReaderWriter->MxRWaitEvent, Deadline))  return 1;
+
+	/* Timed out.  Stay an upgradeable reader. */
+	sync_AddUnixReaderWriterReader(UnixReaderWriter, SYNC_DEADLINE_INFINITE);
+
+	return 0;
+}
+
+int sync_DowngradeUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter)
+{
+	if (!sync_AddUnixReaderWriterReader(UnixReaderWriter, SYNC_DEADLINE_INFINITE))  return 0;
+
+	return sync_ReleaseUnixSemaphoreOwner(&UnixReaderWriter->MxWWaitMutex);
+}
+
+void sync_FreeUnixReaderWriter(sync_UnixReaderWriterWrapper *UnixReaderWriter)
+{
+	sync_FreeUnixSemaphore(&UnixReaderWriter->MxRCountMutex);
+	sync_FreeUnixEvent(&UnixReaderWriter->MxRWaitEvent);
+	sync_FreeUnixSemaphore(&UnixReaderWriter->MxWWaitMutex);
+}
+
+#endif
+
+#endif
+
+
+/* {{{ PHP 5 and 7 crossover compatibility defines and functions */
+#if PHP_MAJOR_VERSION >= 7
+
+#define PORTABLE_new_zend_object_func(funcname)   zend_object *funcname(zend_class_entry *ce)
+#define PORTABLE_new_zend_object_return_var
+#define PORTABLE_new_zend_object_return_var_ref   NULL
+#define PORTABLE_allocate_zend_object(size, ce)   ecalloc(1, (size) + zend_object_properties_size(ce));
+#define PORTABLE_new_zend_object_return(std)   return (std)
+
+void PORTABLE_InitZendObject(void *obj, zend_object *std, void *unused1, void *FreeFunc, zend_object_handlers *Handlers, zend_class_entry *ce TSRMLS_DC)
+{
+	/* Initialize Zend. */
+	zend_object_std_init(std, ce TSRMLS_CC);
+	object_properties_init(std, ce);
+
+	/* Initialize destructor callback. */
+	std->handlers = Handlers;
+}
+
+typedef zend_long   PORTABLE_ZPP_ARG_long;
+typedef size_t   PORTABLE_ZPP_ARG_size;
+typedef zval *   PORTABLE_ZPP_ARG_zval_ref;
+#define PORTABLE_ZPP_ARG_zval_ref_deref(var)   var
+
+static inline void *PHP_7_zend_object_to_object(zend_object *std)
+{
+	return (void *)((char *)std - std->handlers->offset);
+}
+
+#define PORTABLE_zend_object_store_get_object()   PHP_7_zend_object_to_object(Z_OBJ_P(getThis()))
+
+#define PORTABLE_free_zend_object_func(funcname)   void funcname(zend_object *object)
+#define PORTABLE_free_zend_object_get_object(object)   PHP_7_zend_object_to_object(object)
+#define PORTABLE_free_zend_object_free_object(obj)   zend_object_std_dtor(&obj->std);
+
+#define PORTABLE_RETURN_STRINGL(str, len)   RETURN_STRINGL(str, len)
+#define PORTABLE_RETVAL_STRINGL(str, len)   RETVAL_STRINGL(str, len)
+
+#else
+
+#define PORTABLE_new_zend_object_func(funcname)   zend_object_value funcname(zend_class_entry *ce TSRMLS_DC)
+#define PORTABLE_new_zend_object_return_var   zend_object_value retval
+#define PORTABLE_new_zend_object_return_var_ref   &retval
+#define PORTABLE_new_zend_object_return(std)   return retval
+#define PORTABLE_allocate_zend_object(size, ce)   ecalloc(1, (size));
+
+void PORTABLE_InitZendObject(void *obj, zend_object *std, zend_object_value *retval, zend_objects_free_object_storage_t FreeFunc, zend_object_handlers *Handlers, zend_class_entry *ce TSRMLS_DC)
+{
+#if PHP_VERSION_ID < 50399
+	zval *tmp;
+#endif
+
+	/* Initialize Zend. */
+	zend_object_std_init(std, ce TSRMLS_CC);
+#if PHP_VERSION_ID < 50399
+	zend_hash_copy(std->properties, &ce->default_properties, (copy_ctor_func_t)zval_add_ref, (void *)&tmp, sizeof(zval *));
+#else
+	object_properties_init(std, ce);
+#endif
+
+	/* Initialize destructor callback. */
+	retval->handle = zend_objects_store_put(obj, (zend_objects_store_dtor_t)zend_objects_destroy_object, FreeFunc, NULL TSRMLS_CC);
+	retval->handlers = Handlers;
+}
+
+typedef long   PORTABLE_ZPP_ARG_long;
+typedef int   PORTABLE_ZPP_ARG_size;
+typedef zval **   PORTABLE_ZPP_ARG_zval_ref;
+#define PORTABLE_ZPP_ARG_zval_ref_deref(var)   *var
+
+#define PORTABLE_zend_object_store_get_object()   zend_object_store_get_object(getThis() TSRMLS_CC)
+
+#define PORTABLE_free_zend_object_func(funcname)   void funcname(void *object TSRMLS_DC)
+#define PORTABLE_free_zend_object_get_object(object)   object;
+#define PORTABLE_free_zend_object_free_object(obj)   zend_object_std_dtor(&obj->std TSRMLS_CC);  efree(obj);
+
+#define PORTABLE_RETURN_STRINGL(str, len)   RETURN_STRINGL(str, len, 1)
+#define PORTABLE_RETVAL_STRINGL(str, len)   RETVAL_STRINGL(str, len, 1)
+
+#endif
+/* }}} */
+
+
+#if !defined(PHP_WIN32)
+/* Spinning is pointless on single CPU systems. */
+static int sync_MultiCPU = 1;
+
+/* {{{ Returns the spin limit for newly constructed objects. */
+uint32_t sync_GetSpinLimit(TSRMLS_D)
+{
+	if (!sync_MultiCPU || SYNC_G(spin_limit) < 0)  return 0;
+
+	return (uint32_t)SYNC_G(spin_limit);
+}
+/* }}} */
+
+/* {{{ Returns contention statistics as an array.  Times are in nanoseconds. */
+void sync_GetUnixStatsArray(char *Stats, zval *Result)
+{
+	sync_UnixStatsSlot TempStats;
+
+	sync_GetUnixStats(Stats, &TempStats);
+
+	array_init(Result);
+	add_assoc_long(Result, "acquisitions", (PORTABLE_ZPP_ARG_long)TempStats.MxAcquired);
+	add_assoc_long(Result, "contended", (PORTABLE_ZPP_ARG_long)TempStats.MxContended);
+	add_assoc_long(Result, "timeouts", (PORTABLE_ZPP_ARG_long)TempStats.MxTimeouts);
+	add_assoc_long(Result, "wait_ns", (PORTABLE_ZPP_ARG_long)TempStats.MxWaitTime);
+	add_assoc_long(Result, "max_wait_ns", (PORTABLE_ZPP_ARG_long)TempStats.MxMaxWaitTime);
+	add_assoc_long(Result, "max_hold_ns", (PORTABLE_ZPP_ARG_long)TempStats.MxMaxHoldTime);
+}
+/* }}} */
+
+/* {{{ Returns wait and hold time percentiles as an array.  Times are in nanoseconds. */
+void sync_GetUnixHistogramsArray(sync_UnixHistogram *Histograms, zval *Result)
+{
+	static const char *Names[2] = { "wait", "hold" };
+	static const char *Keys[5] = { "p50", "p90", "p99", "p99.9", "max" };
+	static const double Percents[5] = { 50.0, 90.0, 99.0, 99.9, 100.0 };
+	char Key[20];
+	size_t x, y;
+
+	array_init(Result);
+
+	for (x = 0; x < 2; x++)
+	{
+		sprintf(Key, "%s_count", Names[x]);
+		add_assoc_long(Result, Key, (PORTABLE_ZPP_ARG_long)sync_GetUnixHistogramCount(&Histograms[x]));
+
+		for (y = 0; y < 5; y++)
+		{
+			sprintf(Key, "%s_%s", Names[x], Keys[y]);
+			add_assoc_long(Result, Key, (PORTABLE_ZPP_ARG_long)sync_GetUnixHistogramPercentile(&Histograms[x], Percents[y]));
+		}
+	}
+}
+/* }}} */
+#endif
+
+/* {{{ Converts a relative wait in milliseconds (fractions allowed, negative or NaN is infinite) into a deadline. */
+uint64_t sync_GetWaitDeadline(double wait)
+{
+	uint64_t CurrTime;
+
+	/* NaN fails every comparison and converting it to an integer is undefined. */
+	if (wait < 0 || wait != wait)  return SYNC_DEADLINE_INFINITE;
+	if (wait == 0)  return SYNC_DEADLINE_NOWAIT;
+
+	CurrTime = sync_GetMonotonicTime();
+	wait *= 1000000.0;
+	if (wait >= (double)(SYNC_DEADLINE_INFINITE - CurrTime))  return SYNC_DEADLINE_INFINITE;
+
+	return CurrTime + (wait < 1.0 ? 1 : (uint64_t)wait);
+}
+/* }}} */
+
+/* {{{ Converts an absolute hrtime() deadline in nanoseconds into a deadline.  NaN is infinite, the same as for relative waits. */
+uint64_t sync_GetUntilDeadline(double deadline)
+{
+	if (deadline < 1.0)  return SYNC_DEADLINE_NOWAIT;
+	if (deadline >= (double)SYNC_DEADLINE_INFINITE || deadline != deadline)  return SYNC_DEADLINE_INFINITE;
+
+	return (uint64_t)deadline;
+}
+/* }}} */
+
+
+/* Mutex */
+PHP_SYNC_API zend_class_entry *sync_Mutex_ce;
+static zend_object_handlers sync_Mutex_object_handlers;
+
+PORTABLE_free_zend_object_func(sync_Mutex_free_object);
+
+/* {{{ Initialize internal Mutex structure. */
+PORTABLE_new_zend_object_func(sync_Mutex_create_object)
+{
+	PORTABLE_new_zend_object_return_var;
+	sync_Mutex_object *obj;
+
+	/* Create the object. */
+	obj = (sync_Mutex_object *)PORTABLE_allocate_zend_object(sizeof(sync_Mutex_object), ce);
+
+	PORTABLE_InitZendObject(obj, &obj->std, PORTABLE_new_zend_object_return_var_ref, sync_Mutex_free_object, &sync_Mutex_object_handlers, ce TSRMLS_CC);
+
+	/* Initialize Mutex information. */
+#if defined(PHP_WIN32)
 	obj->MxWinMutex = NULL;
 	InitializeCriticalSection(&obj->MxWinCritSection);
 #else
-	obj->MxNamed = 0;
-	obj->MxMem = NULL;
-	pthread_mutex_init(&obj->MxPthreadCritSection, NULL);
+	obj->MxMemType = SYNC_UNIX_MEM_PRIVATE;
+	obj->MxMem = NULL;
+	obj->MxPrioInherit = 0;
+	obj->MxFairMem = NULL;
+	pthread_mutex_init(&obj->MxPthreadCritSection, NULL);
+	obj->MxStats = NULL;
+	obj->MxNameHash = 0;
+	obj->MxHoldStart = 0;
+	obj->MxHistMem = NULL;
+	obj->MxHistograms = NULL;
+	obj->MxForkGen = sync_UnixForkGeneration;
+#endif
+	obj->MxOwnerID = 0;
+	obj->MxCount = 0;
+	obj->MxAbandoned = 0;
+
+	PORTABLE_new_zend_object_return(&obj->std);
+}
+/* }}} */
+
+/* {{{ Forgets a lock inherited through fork().  Only the parent process can release it. */
+static inline void sync_Mutex_forget_forked(sync_Mutex_object *obj)
+{
+#if !defined(PHP_WIN32)
+	if (sync_IsUnixForkedState(&obj->MxForkGen))
+	{
+		obj->MxOwnerID = 0;
+		obj->MxCount = 0;
+		obj->MxHoldStart = 0;
+	}
+#endif
+}
+/* }}} */
+
+/* {{{ Unlocks a mutex. */
+int sync_Mutex_unlock_internal(sync_Mutex_object *obj, int all)
+{
+	sync_Mutex_forget_forked(obj);
+
+#if defined(PHP_WIN32)
+
+	EnterCriticalSection(&obj->MxWinCritSection);
+
+	/* Make sure the mutex exists and make sure it is owned by the calling thread. */
+	if (obj->MxWinMutex == NULL || obj->MxOwnerID != sync_GetCurrentThreadID())
+	{
+		LeaveCriticalSection(&obj->MxWinCritSection);
+
+		return 0;
+	}
+
+	if (all)  obj->MxCount = 1;
+
+	obj->MxCount--;
+	if (!obj->MxCount)
+	{
+		obj->MxOwnerID = 0;
+
+		/* Release the mutex. */
+		ReleaseMutex(obj->MxWinMutex);
+	}
+
+	LeaveCriticalSection(&obj->MxWinCritSection);
+
+#else
+
+	if (pthread_mutex_lock(&obj->MxPthreadCritSection) != 0)  return 0;
+
+	/* Make sure the mutex exists and make sure it is owned by the calling thread. */
+	if (obj->MxMem == NULL || obj->MxOwnerID != sync_GetCurrentThreadID())
+	{
+		pthread_mutex_unlock(&obj->MxPthreadCritSection);
+
+		return 0;
+	}
+
+	if (all)  obj->MxCount = 1;
+
+	obj->MxCount--;
+	if (!obj->MxCount)
+	{
+		obj->MxOwnerID = 0;
+
+		sync_AddUnixLockRelease(obj->MxStats, obj->MxHistograms, obj->MxNameHash, SYNC_PROBE_MUTEX, obj->MxHoldStart);
+
+		/* Release the mutex. */
+#ifdef SYNC_UNIX_PRIO_INHERIT
+		if (obj->MxPrioInherit)  pthread_mutex_unlock(obj->MxPthreadMutex.MxMutex);
+		else
+#endif
+		sync_ReleaseUnixSemaphoreOwner(&obj->MxPthreadMutex);
+	}
+
+	pthread_mutex_unlock(&obj->MxPthreadCritSection);
+
+#endif
+
+	return 1;
+}
+/* }}} */
+
+/* {{{ Free internal Mutex structure. */
+PORTABLE_free_zend_object_func(sync_Mutex_free_object)
+{
+	sync_Mutex_object *obj = (sync_Mutex_object *)PORTABLE_free_zend_object_get_object(object);
+
+	sync_Mutex_unlock_internal(obj, 1);
+
+#if defined(PHP_WIN32)
+	if (obj->MxWinMutex != NULL)  CloseHandle(obj->MxWinMutex);
+	DeleteCriticalSection(&obj->MxWinCritSection);
+#else
+	if (obj->MxMem != NULL)
+	{
+		if (!sync_CloseUnixObjectMem(obj->MxMem, obj->MxMemType, sync_GetUnixSemaphoreSize()))
+		{
+			sync_FreeUnixSemaphore(&obj->MxPthreadMutex);
+
+			efree(obj->MxMem);
+		}
+	}
+
+	if (obj->MxFairMem != NULL)  sync_CloseUnixSideMem(obj->MxFairMem, obj->MxMemType, sync_GetUnixFairQueueSize(1));
+	if (obj->MxHistMem != NULL)  sync_FreeUnixHistograms(obj->MxHistMem, obj->MxMemType);
+
+	pthread_mutex_destroy(&obj->MxPthreadCritSection);
+#endif
+
+	PORTABLE_free_zend_object_free_object(obj);
+}
+/* }}} */
+
+/* {{{ proto void Sync_Mutex::__construct([string $name = null, [bool $histograms = false, [bool $fair = false, [bool $prioinherit = false]]]])
+   Constructs a named or unnamed mutex object.  $histograms enables wait and hold time histograms.  $fair hands the mutex to waiters in the order they arrived.  $prioinherit boosts the owner to the priority of the highest waiter. */
+PHP_METHOD(sync_Mutex, __construct)
+{
+	char *name = NULL;
+	PORTABLE_ZPP_ARG_size name_len;
+	PORTABLE_ZPP_ARG_long histograms = 0;
+	PORTABLE_ZPP_ARG_long fair = 0;
+	PORTABLE_ZPP_ARG_long prioinherit = 0;
+	sync_Mutex_object *obj;
+#if defined(PHP_WIN32)
+	SECURITY_ATTRIBUTES SecAttr;
+#else
+	size_t Pos, TempSize;
+#endif
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|s!lll", &name, &name_len, &histograms, &fair, &prioinherit) == FAILURE)  return;
+
+	obj = (sync_Mutex_object *)PORTABLE_zend_object_store_get_object();
+
+	if (name_len < 1)  name = NULL;
+
+	/* The kernel orders priority inheritance waiters by priority, which a FIFO queue would defeat. */
+	if (fair && prioinherit)
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Mutex can't be both fair and priority inheriting", 0 TSRMLS_CC);
+
+		return;
+	}
+
+#if defined(PHP_WIN32)
+
+	SecAttr.nLength = sizeof(SecAttr);
+	SecAttr.lpSecurityDescriptor = NULL;
+	SecAttr.bInheritHandle = TRUE;
+
+	obj->MxWinMutex = CreateMutexA(&SecAttr, FALSE, name);
+	if (obj->MxWinMutex == NULL)
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Mutex could not be created", 0 TSRMLS_CC);
+		return;
+	}
+
+#else
+
+#ifdef SYNC_UNIX_PRIO_INHERIT
+	obj->MxPrioInherit = (prioinherit != 0);
+#endif
+
+	/* Priority inheritance mutexes are locked differently and the fair mode queue gets its own segment.  Both are recorded as options, so mixing modes is caught instead of splitting the name. */
+	TempSize = sync_GetUnixSemaphoreSize();
+	obj->MxNameHash = sync_GetUnixNameHash(name);
+	int Result = sync_OpenUnixObjectMem(&obj->MxMem, &Pos, &obj->MxMemType, "/Sync_Mutex", name, SYNC_G(shared_unnamed), TempSize);
+
+	if (Result < 0)
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Mutex could not be created", 0 TSRMLS_CC);
+
+		return;
+	}
+
+	if (!sync_CheckUnixObjectOptions(obj->MxMem, obj->MxMemType, (Result == 0), (fair ? 1 : 0) | (obj->MxPrioInherit ? 2 : 0)))
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Mutex already exists with different options", 0 TSRMLS_CC);
+
+		return;
+	}
+
+	obj->MxStats = sync_GetUnixNamedMemStats(obj->MxMem, Pos);
+	sync_GetUnixSemaphore(&obj->MxPthreadMutex, obj->MxMem + Pos, sync_GetSpinLimit(TSRMLS_C));
+
+	/* Handle the first time this mutex has been opened. */
+	if (Result == 0)
+	{
+		sync_InitUnixSemaphore(&obj->MxPthreadMutex, (obj->MxMemType != SYNC_UNIX_MEM_PRIVATE), 1, 1);
+#ifdef SYNC_UNIX_PRIO_INHERIT
+		if (obj->MxPrioInherit)  sync_InitUnixPrioInheritMutex(obj->MxPthreadMutex.MxMutex, (obj->MxMemType != SYNC_UNIX_MEM_PRIVATE));
+#endif
+
+		if (obj->MxMemType == SYNC_UNIX_MEM_NAMED)  sync_UnixNamedMemReady(obj->MxMem);
+	}
+
+	if (fair)
+	{
+		char *FairMem = sync_OpenUnixSideMem(&obj->MxFairMem, "/Sync_MutexFair", name, SYNC_G(shared_unnamed), sync_GetUnixFairQueueSize(1));
+		if (FairMem == NULL)
+		{
+			zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Mutex could not be created", 0 TSRMLS_CC);
+
+			return;
+		}
+
+		obj->MxPthreadMutex.MxFair = sync_GetUnixFairQueue(FairMem);
+	}
+
+	if (histograms)
+	{
+		obj->MxHistograms = sync_InitUnixHistograms(&obj->MxHistMem, "/Sync_MutexHist", name, SYNC_G(shared_unnamed));
+		if (obj->MxHistograms == NULL)
+		{
+			zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Mutex histograms could not be created", 0 TSRMLS_CC);
+
+			return;
+		}
+	}
+
+#endif
+}
+/* }}} */
+
+/* {{{ Locks a mutex. */
+int sync_Mutex_lock_internal(sync_Mutex_object *obj, uint64_t Deadline TSRMLS_DC)
+{
+	sync_Mutex_forget_forked(obj);
+
+#if defined(PHP_WIN32)
+	DWORD Result;
+
+	EnterCriticalSection(&obj->MxWinCritSection);
+
+	/* Check to see if this is already owned by the calling thread. */
+	if (obj->MxOwnerID == sync_GetCurrentThreadID())
+	{
+		obj->MxCount++;
+		LeaveCriticalSection(&obj->MxWinCritSection);
+
+		return 1;
+	}
+
+	LeaveCriticalSection(&obj->MxWinCritSection);
+
+	/* Acquire the mutex.  A mutex abandoned by a thread that exited without releasing it is acquired too. */
+	Result = WaitForSingleObject(obj->MxWinMutex, sync_GetWinWaitAmt(Deadline));
+	if (Result != WAIT_OBJECT_0 && Result != WAIT_ABANDONED)  return 0;
+
+	EnterCriticalSection(&obj->MxWinCritSection);
+	obj->MxOwnerID = sync_GetCurrentThreadID();
+	obj->MxCount = 1;
+	obj->MxAbandoned = (Result == WAIT_ABANDONED);
+	LeaveCriticalSection(&obj->MxWinCritSection);
+
+#else
+
+	if (pthread_mutex_lock(&obj->MxPthreadCritSection) != 0)
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Unable to acquire mutex critical section", 0 TSRMLS_CC);
+
+		return 0;
+	}
+
+	/* Check to see if this mutex is already owned by the calling thread. */
+	if (obj->MxOwnerID == sync_GetCurrentThreadID())
+	{
+		obj->MxCount++;
+		pthread_mutex_unlock(&obj->MxPthreadCritSection);
+
+		return 1;
+	}
+
+	pthread_mutex_unlock(&obj->MxPthreadCritSection);
+
+	/* Only time the wait when the first attempt fails. */
+	uint64_t WaitStart = 0;
+	int Result;
+#ifdef SYNC_UNIX_PRIO_INHERIT
+	if (obj->MxPrioInherit)
+	{
+		Result = sync_WaitForUnixPrioInheritMutex(obj->MxPthreadMutex.MxMutex, SYNC_DEADLINE_NOWAIT);
+		if (!Result && Deadline != SYNC_DEADLINE_NOWAIT)
+		{
+			WaitStart = sync_StartUnixLockWait(obj->MxNameHash, SYNC_PROBE_MUTEX);
+			Result = sync_WaitForUnixPrioInheritMutex(obj->MxPthreadMutex.MxMutex, Deadline);
+		}
+	}
+	else
+#endif
+	{
+		Result = sync_WaitForUnixSemaphoreOwner(&obj->MxPthreadMutex, SYNC_DEADLINE_NOWAIT);
+		if (!Result && Deadline != SYNC_DEADLINE_NOWAIT)
+		{
+			WaitStart = sync_StartUnixLockWait(obj->MxNameHash, SYNC_PROBE_MUTEX);
+			Result = sync_WaitForUnixSemaphoreOwner(&obj->MxPthreadMutex, Deadline);
+		}
+	}
+
+	if (!sync_EndUnixLockWait(obj->MxStats, obj->MxHistograms, obj->MxNameHash, SYNC_PROBE_MUTEX, WaitStart, Result))  return 0;
+
+	pthread_mutex_lock(&obj->MxPthreadCritSection);
+	obj->MxOwnerID = sync_GetCurrentThreadID();
+	obj->MxCount = 1;
+	obj->MxAbandoned = (Result == SYNC_UNIX_LOCK_ABANDONED);
+	obj->MxHoldStart = sync_GetUnixHoldStart(obj->MxHistograms);
+	pthread_mutex_unlock(&obj->MxPthreadCritSection);
+
+#endif
+
+	return 1;
+}
+/* }}} */
+
+/* {{{ proto bool Sync_Mutex::lock([float $wait = -1])
+   Locks a mutex object. */
+PHP_METHOD(sync_Mutex, lock)
+{
+	double wait = -1;
+	sync_Mutex_object *obj;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|d", &wait) == FAILURE)  return;
+
+	obj = (sync_Mutex_object *)PORTABLE_zend_object_store_get_object();
+
+	if (!sync_Mutex_lock_internal(obj, sync_GetWaitDeadline(wait) TSRMLS_CC))  RETURN_FALSE;
+
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool Sync_Mutex::lockUntil(int $deadline)
+   Locks a mutex object before an absolute hrtime() deadline in nanoseconds. */
+PHP_METHOD(sync_Mutex, lockUntil)
+{
+	double deadline;
+	sync_Mutex_object *obj;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "d", &deadline) == FAILURE)  return;
+
+	obj = (sync_Mutex_object *)PORTABLE_zend_object_store_get_object();
+
+	if (!sync_Mutex_lock_internal(obj, sync_GetUntilDeadline(deadline) TSRMLS_CC))  RETURN_FALSE;
+
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool Sync_Mutex::unlock([bool $all = false])
+   Unlocks a mutex object. */
+PHP_METHOD(sync_Mutex, unlock)
+{
+	PORTABLE_ZPP_ARG_long all = 0;
+	sync_Mutex_object *obj;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|l", &all) == FAILURE)  return;
+
+	obj = (sync_Mutex_object *)PORTABLE_zend_object_store_get_object();
+
+	if (!sync_Mutex_unlock_internal(obj, all))  RETURN_FALSE;
+
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool Sync_Mutex::abandoned()
+   Returns whether the last lock() took the mutex over from a process that died while holding it.  Whatever the mutex protects may be in an inconsistent state. */
+PHP_METHOD(sync_Mutex, abandoned)
+{
+	sync_Mutex_object *obj;
+
+	obj = (sync_Mutex_object *)PORTABLE_zend_object_store_get_object();
+
+	RETURN_BOOL(obj->MxAbandoned);
+}
+/* }}} */
+
+/* {{{ proto array Sync_Mutex::getStats()
+   Returns contention statistics for the mutex.  Named objects aggregate across all processes. */
+PHP_METHOD(sync_Mutex, getStats)
+{
+	sync_Mutex_object *obj;
+
+	obj = (sync_Mutex_object *)PORTABLE_zend_object_store_get_object();
+
+#if defined(PHP_WIN32)
+
+	RETURN_FALSE;
+
+#else
+
+	if (obj->MxStats == NULL)  RETURN_FALSE;
+
+	sync_GetUnixStatsArray(obj->MxStats, return_value);
+
+#endif
+}
+/* }}} */
+
+/* {{{ proto array Sync_Mutex::getPercentiles()
+   Returns wait and hold time percentiles for the mutex.  Requires $histograms at construction. */
+PHP_METHOD(sync_Mutex, getPercentiles)
+{
+	sync_Mutex_object *obj;
+
+	obj = (sync_Mutex_object *)PORTABLE_zend_object_store_get_object();
+
+#if defined(PHP_WIN32)
+
+	RETURN_FALSE;
+
+#else
+
+	if (obj->MxHistograms == NULL)  RETURN_FALSE;
+
+	sync_GetUnixHistogramsArray(obj->MxHistograms, return_value);
+
+#endif
+}
+/* }}} */
+
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_mutex___construct, 0, 0, 0)
+	ZEND_ARG_INFO(0, name)
+	ZEND_ARG_INFO(0, histograms)
+	ZEND_ARG_INFO(0, fair)
+	ZEND_ARG_INFO(0, prioinherit)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_mutex_lock, 0, 0, 0)
+	ZEND_ARG_INFO(0, wait)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_mutex_lockuntil, 0, 0, 1)
+	ZEND_ARG_INFO(0, deadline)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_mutex_unlock, 0, 0, 0)
+	ZEND_ARG_INFO(0, all)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_mutex_abandoned, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_mutex_getstats, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_mutex_getpercentiles, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry sync_Mutex_methods[] = {
+	PHP_ME(sync_Mutex, __construct, arginfo_sync_mutex___construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
+	PHP_ME(sync_Mutex, lock, arginfo_sync_mutex_lock, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_Mutex, lockUntil, arginfo_sync_mutex_lockuntil, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_Mutex, unlock, arginfo_sync_mutex_unlock, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_Mutex, abandoned, arginfo_sync_mutex_abandoned, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_Mutex, getStats, arginfo_sync_mutex_getstats, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_Mutex, getPercentiles, arginfo_sync_mutex_getpercentiles, ZEND_ACC_PUBLIC)
+	PHP_FE_END
+};
+
+
+
+/* Striped Mutex */
+PHP_SYNC_API zend_class_entry *sync_StripedMutex_ce;
+static zend_object_handlers sync_StripedMutex_object_handlers;
+
+PORTABLE_free_zend_object_func(sync_StripedMutex_free_object);
+
+/* {{{ Initialize internal Striped Mutex structure. */
+PORTABLE_new_zend_object_func(sync_StripedMutex_create_object)
+{
+	PORTABLE_new_zend_object_return_var;
+	sync_StripedMutex_object *obj;
+
+	/* Create the object. */
+	obj = (sync_StripedMutex_object *)PORTABLE_allocate_zend_object(sizeof(sync_StripedMutex_object), ce);
+
+	PORTABLE_InitZendObject(obj, &obj->std, PORTABLE_new_zend_object_return_var_ref, sync_StripedMutex_free_object, &sync_StripedMutex_object_handlers, ce TSRMLS_CC);
+
+	/* Initialize Striped Mutex information. */
+#if defined(PHP_WIN32)
+	InitializeCriticalSection(&obj->MxWinCritSection);
+	obj->MxWinName = NULL;
+#else
+	pthread_mutex_init(&obj->MxPthreadCritSection, NULL);
+	obj->MxMemType = SYNC_UNIX_MEM_PRIVATE;
+	obj->MxMem = NULL;
+	obj->MxStripesMem = NULL;
+	obj->MxStats = NULL;
+	obj->MxNameHash = 0;
+	obj->MxForkGen = sync_UnixForkGeneration;
+#endif
+	obj->MxNumStripes = 0;
+	obj->MxStripes = NULL;
+	obj->MxAbandoned = 0;
+
+	PORTABLE_new_zend_object_return(&obj->std);
+}
+/* }}} */
+
+/* {{{ Maps a key to a stripe.  Integer keys map the same as their decimal strings. */
+int sync_StripedMutex_get_stripe(sync_StripedMutex_object *obj, zval *key, uint32_t *Stripe TSRMLS_DC)
+{
+	char Buffer[32];
+	const char *Str;
+	size_t x, Len;
+	uint32_t Hash = 2166136261U;
+
+	if (obj->MxStripes == NULL)  return 0;
+
+	if (Z_TYPE_P(key) == IS_LONG)
+	{
+		PORTABLE_ZPP_ARG_long Num = Z_LVAL_P(key);
+		unsigned long long Num2 = (Num < 0 ? 0ULL - (unsigned long long)Num : (unsigned long long)Num);
+
+		Str = Buffer + sizeof(Buffer);
+		do
+		{
+			*(char *)(--Str) = (char)('0' + (Num2 % 10));
+			Num2 /= 10;
+		} while (Num2);
+
+		if (Num < 0)  *(char *)(--Str) = '-';
+
+		Len = (size_t)(Buffer + sizeof(Buffer) - Str);
+	}
+	else if (Z_TYPE_P(key) == IS_STRING)
+	{
+		Str = Z_STRVAL_P(key);
+		Len = (size_t)Z_STRLEN_P(key);
+	}
+	else
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Key must be a string or an integer", 0 TSRMLS_CC);
+
+		return 0;
+	}
+
+	/* FNV-1a. */
+	for (x = 0; x < Len; x++)  Hash = (Hash ^ (uint32_t)(unsigned char)Str[x]) * 16777619U;
+
+	*Stripe = Hash % obj->MxNumStripes;
+
+	return 1;
+}
+/* }}} */
+
+/* {{{ Forgets locks inherited through fork().  Only the parent process can release them. */
+static inline void sync_StripedMutex_forget_forked(sync_StripedMutex_object *obj)
+{
+#if !defined(PHP_WIN32)
+	uint32_t x;
+
+	if (sync_IsUnixForkedState(&obj->MxForkGen))
+	{
+		for (x = 0; x < obj->MxNumStripes; x++)
+		{
+			obj->MxStripes[x].MxOwnerID = 0;
+			obj->MxStripes[x].MxCount = 0;
+			obj->MxStripes[x].MxHoldStart = 0;
+		}
+	}
+#endif
+}
+/* }}} */
+
+/* {{{ Unlocks a stripe. */
+int sync_StripedMutex_unlock_internal(sync_StripedMutex_object *obj, uint32_t Stripe, int all)
+{
+	sync_StripedMutexStripe *StripePtr = &obj->MxStripes[Stripe];
+
+	sync_StripedMutex_forget_forked(obj);
+
+#if defined(PHP_WIN32)
+
+	EnterCriticalSection(&obj->MxWinCritSection);
+
+	/* Make sure the stripe is owned by the calling thread. */
+	if (StripePtr->MxWinMutex == NULL || StripePtr->MxOwnerID != sync_GetCurrentThreadID())
+	{
+		LeaveCriticalSection(&obj->MxWinCritSection);
+
+		return 0;
+	}
+
+	if (all)  StripePtr->MxCount = 1;
+
+	StripePtr->MxCount--;
+	if (!StripePtr->MxCount)
+	{
+		StripePtr->MxOwnerID = 0;
+
+		/* Release the mutex. */
+		ReleaseMutex(StripePtr->MxWinMutex);
+	}
+
+	LeaveCriticalSection(&obj->MxWinCritSection);
+
+#else
+
+	if (pthread_mutex_lock(&obj->MxPthreadCritSection) != 0)  return 0;
+
+	/* Make sure the stripe is owned by the calling thread. */
+	if (obj->MxStripesMem == NULL || StripePtr->MxOwnerID != sync_GetCurrentThreadID())
+	{
+		pthread_mutex_unlock(&obj->MxPthreadCritSection);
+
+		return 0;
+	}
+
+	if (all)  StripePtr->MxCount = 1;
+
+	StripePtr->MxCount--;
+	if (!StripePtr->MxCount)
+	{
+		StripePtr->MxOwnerID = 0;
+
+		sync_AddUnixLockRelease(obj->MxStats, NULL, obj->MxNameHash, SYNC_PROBE_MUTEX, StripePtr->MxHoldStart);
+
+		/* Release the mutex. */
+		sync_ReleaseUnixSemaphoreOwner(&StripePtr->MxPthreadMutex);
+	}
+
+	pthread_mutex_unlock(&obj->MxPthreadCritSection);
+
+#endif
+
+	return 1;
+}
+/* }}} */
+
+/* {{{ Free internal Striped Mutex structure. */
+PORTABLE_free_zend_object_func(sync_StripedMutex_free_object)
+{
+	sync_StripedMutex_object *obj = (sync_StripedMutex_object *)PORTABLE_free_zend_object_get_object(object);
+	uint32_t x;
+
+	if (obj->MxStripes != NULL)
+	{
+		for (x = 0; x < obj->MxNumStripes; x++)  sync_StripedMutex_unlock_internal(obj, x, 1);
+	}
+
+#if defined(PHP_WIN32)
+	if (obj->MxStripes != NULL)
+	{
+		for (x = 0; x < obj->MxNumStripes; x++)
+		{
+			if (obj->MxStripes[x].MxWinMutex != NULL)  CloseHandle(obj->MxStripes[x].MxWinMutex);
+		}
+	}
+
+	if (obj->MxWinName != NULL)  efree(obj->MxWinName);
+
+	DeleteCriticalSection(&obj->MxWinCritSection);
+#else
+	if (obj->MxStripesMem != NULL)
+	{
+		if (!sync_CloseUnixObjectMem(obj->MxStripesMem, obj->MxMemType, sync_GetUnixStripedMutexSize(obj->MxNumStripes)))
+		{
+			for (x = 0; x < obj->MxNumStripes; x++)  sync_FreeUnixSemaphore(&obj->MxStripes[x].MxPthreadMutex);
+
+			efree(obj->MxStripesMem);
+		}
+	}
+
+	if (obj->MxMem != NULL)  sync_CloseUnixSideMem(obj->MxMem, obj->MxMemType, SYNC_UNIX_STRIPED_MUTEX_MEM_SIZE);
+
+	pthread_mutex_destroy(&obj->MxPthreadCritSection);
 #endif
-	obj->MxOwnerID = 0;
-	obj->MxCount = 0;
 
-	PORTABLE_new_zend_object_return(&obj->std);
+	if (obj->MxStripes != NULL)  efree(obj->MxStripes);
+
+	PORTABLE_free_zend_object_free_object(obj);
 }
 /* }}} */
 
-/* {{{ Unlocks a mutex. */
-int sync_Mutex_unlock_internal(sync_Mutex_object *obj, int all)
+/* {{{ proto void Sync_StripedMutex::__construct([string $name = null, [int $stripes = 64]])
+   Constructs a named or unnamed striped mutex object.  All of the stripes share one block of shared memory. */
+PHP_METHOD(sync_StripedMutex, __construct)
+{
+	char *name = NULL;
+	PORTABLE_ZPP_ARG_size name_len;
+	PORTABLE_ZPP_ARG_long stripes = 64;
+	sync_StripedMutex_object *obj;
+#if !defined(PHP_WIN32)
+	uint32_t x;
+	size_t Pos, TempSize;
+	int MemType;
+#endif
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|s!l", &name, &name_len, &stripes) == FAILURE)  return;
+
+	obj = (sync_StripedMutex_object *)PORTABLE_zend_object_store_get_object();
+
+	if (name_len < 1)  name = NULL;
+
+	if (stripes < 1 || stripes > SYNC_STRIPED_MUTEX_MAX_STRIPES)
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "An invalid number of stripes was passed", 0 TSRMLS_CC);
+
+		return;
+	}
+
+	obj->MxNumStripes = (uint32_t)stripes;
+	obj->MxStripes = (sync_StripedMutexStripe *)ecalloc(obj->MxNumStripes, sizeof(sync_StripedMutexStripe));
+
+#if defined(PHP_WIN32)
+
+	if (name != NULL)
+	{
+		obj->MxWinName = (char *)emalloc(name_len + 1);
+		memcpy(obj->MxWinName, name, name_len + 1);
+	}
+
+#else
+
+	obj->MxNameHash = sync_GetUnixNameHash(name);
+	int Result = sync_OpenUnixObjectMem(&obj->MxMem, &Pos, &obj->MxMemType, "/Sync_StripedMutex", name, SYNC_G(shared_unnamed), SYNC_UNIX_STRIPED_MUTEX_MEM_SIZE);
+
+	if (Result < 0)
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Striped mutex could not be created", 0 TSRMLS_CC);
+
+		return;
+	}
+
+	/* The stripe count sizes the stripes segment, so it is recorded instead of splitting the name. */
+	if (!sync_CheckUnixObjectOptions(obj->MxMem, obj->MxMemType, (Result == 0), (uint64_t)obj->MxNumStripes))
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Striped mutex already exists with different options", 0 TSRMLS_CC);
+
+		return;
+	}
+
+	obj->MxStats = sync_GetUnixNamedMemStats(obj->MxMem, Pos);
+
+	if (Result == 0 && obj->MxMemType == SYNC_UNIX_MEM_NAMED)  sync_UnixNamedMemReady(obj->MxMem);
+
+	/* The stripes segment goes through the same first-time handshake as any other object's memory. */
+	TempSize = sync_GetUnixStripedMutexSize(obj->MxNumStripes);
+	Result = sync_OpenUnixObjectMem(&obj->MxStripesMem, &Pos, &MemType, "/Sync_StripedMutexStripes", name, SYNC_G(shared_unnamed), TempSize);
+
+	if (Result < 0)
+	{
+		obj->MxStripesMem = NULL;
+
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Striped mutex could not be created", 0 TSRMLS_CC);
+
+		return;
+	}
+
+	for (x = 0; x < obj->MxNumStripes; x++)
+	{
+		sync_GetUnixSemaphore(&obj->MxStripes[x].MxPthreadMutex, sync_GetUnixStripedMutexStripe(obj->MxStripesMem + Pos, x), sync_GetSpinLimit(TSRMLS_C));
+
+		/* Handle the first time this striped mutex has been opened. */
+		if (Result == 0)  sync_InitUnixSemaphore(&obj->MxStripes[x].MxPthreadMutex, (MemType != SYNC_UNIX_MEM_PRIVATE), 1, 1);
+	}
+
+	if (Result == 0 && MemType == SYNC_UNIX_MEM_NAMED)  sync_UnixNamedMemReady(obj->MxStripesMem);
+
+#endif
+}
+/* }}} */
+
+/* {{{ Locks a stripe. */
+int sync_StripedMutex_lock_internal(sync_StripedMutex_object *obj, uint32_t Stripe, uint64_t Deadline TSRMLS_DC)
 {
+	sync_StripedMutexStripe *StripePtr = &obj->MxStripes[Stripe];
+
+	sync_StripedMutex_forget_forked(obj);
+
 #if defined(PHP_WIN32)
+	DWORD Result;
 
 	EnterCriticalSection(&obj->MxWinCritSection);
 
-	/* Make sure the mutex exists and make sure it is owned by the calling thread. */
-	if (obj->MxWinMutex == NULL || obj->MxOwnerID != sync_GetCurrentThreadID())
+	/* Check to see if this stripe is already owned by the calling thread. */
+	if (StripePtr->MxOwnerID == sync_GetCurrentThreadID())
 	{
+		StripePtr->MxCount++;
 		LeaveCriticalSection(&obj->MxWinCritSection);
 
-		return 0;
+		return 1;
 	}
 
-	if (all)  obj->MxCount = 1;
-
-	obj->MxCount--;
-	if (!obj->MxCount)
+	/* Create the mutex the first time the stripe is used.  The name includes the number of stripes since keys map differently with a different number. */
+	if (StripePtr->MxWinMutex == NULL)
 	{
-		obj->MxOwnerID = 0;
+		SECURITY_ATTRIBUTES SecAttr;
+		char *Name = NULL;
 
-		/* Release the mutex. */
-		ReleaseMutex(obj->MxWinMutex);
+		SecAttr.nLength = sizeof(SecAttr);
+		SecAttr.lpSecurityDescriptor = NULL;
+		SecAttr.bInheritHandle = TRUE;
+
+		if (obj->MxWinName != NULL)
+		{
+			Name = (char *)emalloc(strlen(obj->MxWinName) + 30);
+			sprintf(Name, "%s-%u-%u", obj->MxWinName, (unsigned int)obj->MxNumStripes, (unsigned int)Stripe);
+		}
+
+		StripePtr->MxWinMutex = CreateMutexA(&SecAttr, FALSE, Name);
+
+		if (Name != NULL)  efree(Name);
+
+		if (StripePtr->MxWinMutex == NULL)
+		{
+			LeaveCriticalSection(&obj->MxWinCritSection);
+
+			zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Striped mutex stripe could not be created", 0 TSRMLS_CC);
+
+			return 0;
+		}
 	}
 
 	LeaveCriticalSection(&obj->MxWinCritSection);
 
+	/* Acquire the mutex.  A mutex abandoned by a thread that exited without releasing it is acquired too. */
+	Result = WaitForSingleObject(StripePtr->MxWinMutex, sync_GetWinWaitAmt(Deadline));
+	if (Result != WAIT_OBJECT_0 && Result != WAIT_ABANDONED)  return 0;
+
+	EnterCriticalSection(&obj->MxWinCritSection);
+	StripePtr->MxOwnerID = sync_GetCurrentThreadID();
+	StripePtr->MxCount = 1;
+	obj->MxAbandoned = (Result == WAIT_ABANDONED);
+	LeaveCriticalSection(&obj->MxWinCritSection);
+
 #else
 
-	if (pthread_mutex_lock(&obj->MxPthreadCritSection) != 0)  return 0;
+	if (pthread_mutex_lock(&obj->MxPthreadCritSection) != 0)
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Unable to acquire striped mutex critical section", 0 TSRMLS_CC);
 
-	/* Make sure the mutex exists and make sure it is owned by the calling thread. */
-	if (obj->MxMem == NULL || obj->MxOwnerID != sync_GetCurrentThreadID())
+		return 0;
+	}
+
+	/* Check to see if this stripe is already owned by the calling thread. */
+	if (StripePtr->MxOwnerID == sync_GetCurrentThreadID())
 	{
+		StripePtr->MxCount++;
 		pthread_mutex_unlock(&obj->MxPthreadCritSection);
 
-		return 0;
+		return 1;
 	}
 
-	if (all)  obj->MxCount = 1;
+	pthread_mutex_unlock(&obj->MxPthreadCritSection);
 
-	obj->MxCount--;
-	if (!obj->MxCount)
+	/* Only time the wait when the first attempt fails. */
+	uint64_t WaitStart = 0;
+	int Result = sync_WaitForUnixSemaphoreOwner(&StripePtr->MxPthreadMutex, SYNC_DEADLINE_NOWAIT);
+	if (!Result && Deadline != SYNC_DEADLINE_NOWAIT)
 	{
-		obj->MxOwnerID = 0;
-
-		/* Release the mutex. */
-		sync_ReleaseUnixSemaphore(&obj->MxPthreadMutex, NULL);
+		WaitStart = sync_StartUnixLockWait(obj->MxNameHash, SYNC_PROBE_MUTEX);
+		Result = sync_WaitForUnixSemaphoreOwner(&StripePtr->MxPthreadMutex, Deadline);
 	}
 
+	if (!sync_EndUnixLockWait(obj->MxStats, NULL, obj->MxNameHash, SYNC_PROBE_MUTEX, WaitStart, Result))  return 0;
+
+	pthread_mutex_lock(&obj->MxPthreadCritSection);
+	StripePtr->MxOwnerID = sync_GetCurrentThreadID();
+	StripePtr->MxCount = 1;
+	obj->MxAbandoned = (Result == SYNC_UNIX_LOCK_ABANDONED);
+	StripePtr->MxHoldStart = sync_GetUnixHoldStart(NULL);
 	pthread_mutex_unlock(&obj->MxPthreadCritSection);
 
 #endif
@@ -843,411 +4296,780 @@ int sync_Mutex_unlock_internal(sync_Mutex_object *obj, int all)
 }
 /* }}} */
 
-/* {{{ Free internal Mutex structure. */
-PORTABLE_free_zend_object_func(sync_Mutex_free_object)
+/* {{{ proto bool Sync_StripedMutex::lock(string|int $key, [float $wait = -1])
+   Locks the stripe that a key maps to. */
+PHP_METHOD(sync_StripedMutex, lock)
 {
-	sync_Mutex_object *obj = (sync_Mutex_object *)PORTABLE_free_zend_object_get_object(object);
+	zval *key;
+	double wait = -1;
+	uint32_t Stripe;
+	sync_StripedMutex_object *obj;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z|d", &key, &wait) == FAILURE)  return;
+
+	obj = (sync_StripedMutex_object *)PORTABLE_zend_object_store_get_object();
+
+	if (!sync_StripedMutex_get_stripe(obj, key, &Stripe TSRMLS_CC))  RETURN_FALSE;
+
+	if (!sync_StripedMutex_lock_internal(obj, Stripe, sync_GetWaitDeadline(wait) TSRMLS_CC))  RETURN_FALSE;
+
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool Sync_StripedMutex::lockUntil(string|int $key, int $deadline)
+   Locks the stripe that a key maps to before an absolute hrtime() deadline in nanoseconds. */
+PHP_METHOD(sync_StripedMutex, lockUntil)
+{
+	zval *key;
+	double deadline;
+	uint32_t Stripe;
+	sync_StripedMutex_object *obj;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zd", &key, &deadline) == FAILURE)  return;
+
+	obj = (sync_StripedMutex_object *)PORTABLE_zend_object_store_get_object();
+
+	if (!sync_StripedMutex_get_stripe(obj, key, &Stripe TSRMLS_CC))  RETURN_FALSE;
+
+	if (!sync_StripedMutex_lock_internal(obj, Stripe, sync_GetUntilDeadline(deadline) TSRMLS_CC))  RETURN_FALSE;
+
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool Sync_StripedMutex::unlock(string|int $key, [bool $all = false])
+   Unlocks the stripe that a key maps to. */
+PHP_METHOD(sync_StripedMutex, unlock)
+{
+	zval *key;
+	PORTABLE_ZPP_ARG_long all = 0;
+	uint32_t Stripe;
+	sync_StripedMutex_object *obj;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z|l", &key, &all) == FAILURE)  return;
+
+	obj = (sync_StripedMutex_object *)PORTABLE_zend_object_store_get_object();
+
+	if (!sync_StripedMutex_get_stripe(obj, key, &Stripe TSRMLS_CC))  RETURN_FALSE;
+
+	if (!sync_StripedMutex_unlock_internal(obj, Stripe, all))  RETURN_FALSE;
+
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool Sync_StripedMutex::abandoned()
+   Returns whether the last lock() took a stripe over from a process that died while holding it. */
+PHP_METHOD(sync_StripedMutex, abandoned)
+{
+	sync_StripedMutex_object *obj;
+
+	obj = (sync_StripedMutex_object *)PORTABLE_zend_object_store_get_object();
+
+	RETURN_BOOL(obj->MxAbandoned);
+}
+/* }}} */
+
+/* {{{ proto int Sync_StripedMutex::getStripe(string|int $key)
+   Returns the stripe that a key maps to. */
+PHP_METHOD(sync_StripedMutex, getStripe)
+{
+	zval *key;
+	uint32_t Stripe;
+	sync_StripedMutex_object *obj;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z", &key) == FAILURE)  return;
+
+	obj = (sync_StripedMutex_object *)PORTABLE_zend_object_store_get_object();
+
+	if (!sync_StripedMutex_get_stripe(obj, key, &Stripe TSRMLS_CC))  RETURN_FALSE;
+
+	RETURN_LONG((PORTABLE_ZPP_ARG_long)Stripe);
+}
+/* }}} */
+
+/* {{{ proto array Sync_StripedMutex::getStats()
+   Returns contention statistics for all of the stripes together.  Named objects aggregate across all processes. */
+PHP_METHOD(sync_StripedMutex, getStats)
+{
+	sync_StripedMutex_object *obj;
+
+	obj = (sync_StripedMutex_object *)PORTABLE_zend_object_store_get_object();
+
+#if defined(PHP_WIN32)
+
+	RETURN_FALSE;
+
+#else
+
+	if (obj->MxStats == NULL)  RETURN_FALSE;
+
+	sync_GetUnixStatsArray(obj->MxStats, return_value);
+
+#endif
+}
+/* }}} */
+
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_stripedmutex___construct, 0, 0, 0)
+	ZEND_ARG_INFO(0, name)
+	ZEND_ARG_INFO(0, stripes)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_stripedmutex_lock, 0, 0, 1)
+	ZEND_ARG_INFO(0, key)
+	ZEND_ARG_INFO(0, wait)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_stripedmutex_lockuntil, 0, 0, 2)
+	ZEND_ARG_INFO(0, key)
+	ZEND_ARG_INFO(0, deadline)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_stripedmutex_unlock, 0, 0, 1)
+	ZEND_ARG_INFO(0, key)
+	ZEND_ARG_INFO(0, all)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_stripedmutex_abandoned, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_stripedmutex_getstripe, 0, 0, 1)
+	ZEND_ARG_INFO(0, key)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_stripedmutex_getstats, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry sync_StripedMutex_methods[] = {
+	PHP_ME(sync_StripedMutex, __construct, arginfo_sync_stripedmutex___construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
+	PHP_ME(sync_StripedMutex, lock, arginfo_sync_stripedmutex_lock, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_StripedMutex, lockUntil, arginfo_sync_stripedmutex_lockuntil, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_StripedMutex, unlock, arginfo_sync_stripedmutex_unlock, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_StripedMutex, abandoned, arginfo_sync_stripedmutex_abandoned, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_StripedMutex, getStripe, arginfo_sync_stripedmutex_getstripe, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_StripedMutex, getStats, arginfo_sync_stripedmutex_getstats, ZEND_ACC_PUBLIC)
+	PHP_FE_END
+};
+
+
+
+/* Semaphore */
+PHP_SYNC_API zend_class_entry *sync_Semaphore_ce;
+static zend_object_handlers sync_Semaphore_object_handlers;
+
+PORTABLE_free_zend_object_func(sync_Semaphore_free_object);
+
+/* {{{ Initialize internal Semaphore structure. */
+PORTABLE_new_zend_object_func(sync_Semaphore_create_object)
+{
+	PORTABLE_new_zend_object_return_var;
+	sync_Semaphore_object *obj;
+
+	/* Create the object. */
+	obj = (sync_Semaphore_object *)PORTABLE_allocate_zend_object(sizeof(sync_Semaphore_object), ce);
+
+	PORTABLE_InitZendObject(obj, &obj->std, PORTABLE_new_zend_object_return_var_ref, sync_Semaphore_free_object, &sync_Semaphore_object_handlers, ce TSRMLS_CC);
+
+	/* Initialize Semaphore information. */
+#if defined(PHP_WIN32)
+	obj->MxWinSemaphore = NULL;
+#else
+	obj->MxMemType = SYNC_UNIX_MEM_PRIVATE;
+	obj->MxMem = NULL;
+	obj->MxNumHolders = 0;
+	obj->MxHoldersMem = NULL;
+	obj->MxHolders = NULL;
+	obj->MxFairMem = NULL;
+	obj->MxLimiter = NULL;
+	obj->MxLimitStart = 0;
+	obj->MxStats = NULL;
+	obj->MxNameHash = 0;
+	obj->MxHoldStart = 0;
+	obj->MxHistMem = NULL;
+	obj->MxHistograms = NULL;
+	obj->MxForkGen = sync_UnixForkGeneration;
+#endif
+	obj->MxAutoUnlock = 0;
+	obj->MxCount = 0;
+
+	PORTABLE_new_zend_object_return(&obj->std);
+}
+/* }}} */
+
+/* {{{ Forgets units inherited through fork().  They were acquired by the parent process, which releases them. */
+static inline void sync_Semaphore_forget_forked(sync_Semaphore_object *obj)
+{
+#if !defined(PHP_WIN32)
+	if (sync_IsUnixForkedState(&obj->MxForkGen))
+	{
+		obj->MxCount = 0;
+		obj->MxHoldStart = 0;
+		obj->MxLimitStart = 0;
+	}
+#endif
+}
+/* }}} */
+
+/* {{{ Free internal Semaphore structure. */
+PORTABLE_free_zend_object_func(sync_Semaphore_free_object)
+{
+	sync_Semaphore_object *obj = (sync_Semaphore_object *)PORTABLE_free_zend_object_get_object(object);
+#if !defined(PHP_WIN32)
+	uint32_t Removed;
+#endif
+
+	sync_Semaphore_forget_forked(obj);
+
+	if (obj->MxAutoUnlock)
+	{
+#if !defined(PHP_WIN32)
+		if (obj->MxCount)  sync_AddUnixLockRelease(obj->MxStats, obj->MxHistograms, obj->MxNameHash, SYNC_PROBE_SEMAPHORE, obj->MxHoldStart);
+#endif
 
-	sync_Mutex_unlock_internal(obj, 1);
+		if (obj->MxCount)
+		{
+#if defined(PHP_WIN32)
+			ReleaseSemaphore(obj->MxWinSemaphore, (LONG)obj->MxCount, NULL);
+#else
+			Removed = (obj->MxHolders != NULL ? sync_RemoveUnixSemaphoreHolder(obj->MxHolders, obj->MxNumHolders, obj->MxCount) : 0);
+			if (!sync_ReleaseUnixSemaphoreCount(&obj->MxPthreadSemaphore, obj->MxCount, NULL) && Removed)  sync_AddUnixSemaphoreHolder(obj->MxHolders, obj->MxNumHolders, Removed);
+#endif
+
+			obj->MxCount = 0;
+		}
+	}
 
 #if defined(PHP_WIN32)
-	if (obj->MxWinMutex != NULL)  CloseHandle(obj->MxWinMutex);
-	DeleteCriticalSection(&obj->MxWinCritSection);
+	if (obj->MxWinSemaphore != NULL)  CloseHandle(obj->MxWinSemaphore);
 #else
 	if (obj->MxMem != NULL)
 	{
-		if (obj->MxNamed)  sync_UnmapUnixNamedMem(obj->MxMem, sync_GetUnixSemaphoreSize());
-		else
+		if (!sync_CloseUnixObjectMem(obj->MxMem, obj->MxMemType, sync_GetUnixSemaphoreSize() + sync_GetUnixSemaphoreLimiterSize()))
 		{
-			sync_FreeUnixSemaphore(&obj->MxPthreadMutex);
+			sync_FreeUnixSemaphore(&obj->MxPthreadSemaphore);
 
 			efree(obj->MxMem);
 		}
 	}
 
-	pthread_mutex_destroy(&obj->MxPthreadCritSection);
+	if (obj->MxHoldersMem != NULL)  sync_CloseUnixSideMem(obj->MxHoldersMem, obj->MxMemType, sync_GetUnixSemaphoreHoldersSize(obj->MxNumHolders));
+	if (obj->MxFairMem != NULL)  sync_CloseUnixSideMem(obj->MxFairMem, obj->MxMemType, sync_GetUnixFairQueueSize(1));
+	if (obj->MxHistMem != NULL)  sync_FreeUnixHistograms(obj->MxHistMem, obj->MxMemType);
 #endif
 
 	PORTABLE_free_zend_object_free_object(obj);
 }
 /* }}} */
 
-/* {{{ proto void Sync_Mutex::__construct([string $name = null])
-   Constructs a named or unnamed mutex object. */
-PHP_METHOD(sync_Mutex, __construct)
+/* {{{ proto void Sync_Semaphore::__construct([string $name = null, [int $initialval = 1, [bool $autounlock = true, [bool $histograms = false, [bool $holders = false, [bool $fair = false]]]]]])
+   Constructs a named or unnamed semaphore object.  Don't set $autounlock to false unless you really know what you are doing.  $histograms enables wait and hold time histograms.  $holders records the process holding each unit so that units held by processes that died can be reclaimed.  $fair hands units to waiters in the order they arrived. */
+PHP_METHOD(sync_Semaphore, __construct)
 {
 	char *name = NULL;
 	PORTABLE_ZPP_ARG_size name_len;
-	sync_Mutex_object *obj;
+	PORTABLE_ZPP_ARG_long initialval = 1;
+	PORTABLE_ZPP_ARG_long autounlock = 1;
+	PORTABLE_ZPP_ARG_long histograms = 0;
+	PORTABLE_ZPP_ARG_long holders = 0;
+	PORTABLE_ZPP_ARG_long fair = 0;
+	sync_Semaphore_object *obj;
 #if defined(PHP_WIN32)
 	SECURITY_ATTRIBUTES SecAttr;
 #else
 	size_t Pos, TempSize;
 #endif
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|s!", &name, &name_len) == FAILURE)  return;
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|s!lllll", &name, &name_len, &initialval, &autounlock, &histograms, &holders, &fair) == FAILURE)  return;
 
-	obj = (sync_Mutex_object *)PORTABLE_zend_object_store_get_object();
+	obj = (sync_Semaphore_object *)PORTABLE_zend_object_store_get_object();
 
 	if (name_len < 1)  name = NULL;
 
+	if (holders && (initialval < 1 || initialval > SYNC_SEMAPHORE_MAX_HOLDERS))
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Semaphore holder tables support 1 to 65536 units", 0 TSRMLS_CC);
+
+		return;
+	}
+
+	obj->MxAutoUnlock = (autounlock ? 1 : 0);
+
 #if defined(PHP_WIN32)
 
 	SecAttr.nLength = sizeof(SecAttr);
 	SecAttr.lpSecurityDescriptor = NULL;
 	SecAttr.bInheritHandle = TRUE;
 
-	obj->MxWinMutex = CreateMutexA(&SecAttr, FALSE, name);
-	if (obj->MxWinMutex == NULL)
+	obj->MxWinSemaphore = CreateSemaphoreA(&SecAttr, (LONG)initialval, (LONG)initialval, name);
+	if (obj->MxWinSemaphore == NULL)
 	{
-		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Mutex could not be created", 0 TSRMLS_CC);
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Semaphore could not be created", 0 TSRMLS_CC);
 		return;
 	}
 
 #else
 
-	TempSize = sync_GetUnixSemaphoreSize();
-	obj->MxNamed = (name != NULL ? 1 : 0);
-	int Result = sync_InitUnixNamedMem(&obj->MxMem, &Pos, "/Sync_Mutex", name, TempSize);
+	/* The controller state follows the semaphore in the same memory.  The holder table and the fair mode queue get their own segments, so mixing options is caught instead of splitting the name. */
+	if (holders)  obj->MxNumHolders = (uint32_t)initialval;
+
+	TempSize = sync_GetUnixSemaphoreSize() + sync_GetUnixSemaphoreLimiterSize();
+	obj->MxNameHash = sync_GetUnixNameHash(name);
+	int Result = sync_OpenUnixObjectMem(&obj->MxMem, &Pos, &obj->MxMemType, "/Sync_Semaphore", name, SYNC_G(shared_unnamed), TempSize);
 
 	if (Result < 0)
 	{
-		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Mutex could not be created", 0 TSRMLS_CC);
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Semaphore could not be created", 0 TSRMLS_CC);
 
 		return;
 	}
 
-	sync_GetUnixSemaphore(&obj->MxPthreadMutex, obj->MxMem + Pos);
+	/* The holder table size is an option too. */
+	if (!sync_CheckUnixObjectOptions(obj->MxMem, obj->MxMemType, (Result == 0), ((uint64_t)obj->MxNumHolders << 32) | (fair ? 1 : 0)))
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Semaphore already exists with different options", 0 TSRMLS_CC);
 
-	/* Handle the first time this mutex has been opened. */
+		return;
+	}
+
+	obj->MxStats = sync_GetUnixNamedMemStats(obj->MxMem, Pos);
+	sync_GetUnixSemaphore(&obj->MxPthreadSemaphore, obj->MxMem + Pos, sync_GetSpinLimit(TSRMLS_C));
+	obj->MxLimiter = sync_GetUnixSemaphoreLimiter(obj->MxMem + Pos + sync_GetUnixSemaphoreSize());
+
+	/* Handle the first time this semaphore has been opened. */
 	if (Result == 0)
 	{
-		sync_InitUnixSemaphore(&obj->MxPthreadMutex, obj->MxNamed, 1, 1);
+		sync_InitUnixSemaphore(&obj->MxPthreadSemaphore, (obj->MxMemType != SYNC_UNIX_MEM_PRIVATE), (uint32_t)initialval, (uint32_t)initialval);
+		memset(obj->MxLimiter, 0, sizeof(sync_UnixSemaphoreLimiter));
+
+		if (obj->MxMemType == SYNC_UNIX_MEM_NAMED)  sync_UnixNamedMemReady(obj->MxMem);
+	}
+
+	if (obj->MxNumHolders)
+	{
+		char *HoldersMem = sync_OpenUnixSideMem(&obj->MxHoldersMem, "/Sync_SemaphoreHolders", name, SYNC_G(shared_unnamed), sync_GetUnixSemaphoreHoldersSize(obj->MxNumHolders));
+		if (HoldersMem == NULL)
+		{
+			zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Semaphore could not be created", 0 TSRMLS_CC);
+
+			return;
+		}
+
+		obj->MxHolders = sync_GetUnixSemaphoreHolders(HoldersMem);
+	}
+
+	if (fair)
+	{
+		char *FairMem = sync_OpenUnixSideMem(&obj->MxFairMem, "/Sync_SemaphoreFair", name, SYNC_G(shared_unnamed), sync_GetUnixFairQueueSize(1));
+		if (FairMem == NULL)
+		{
+			zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Semaphore could not be created", 0 TSRMLS_CC);
+
+			return;
+		}
+
+		obj->MxPthreadSemaphore.MxFair = sync_GetUnixFairQueue(FairMem);
+	}
+
+	if (histograms)
+	{
+		obj->MxHistograms = sync_InitUnixHistograms(&obj->MxHistMem, "/Sync_SemaphoreHist", name, SYNC_G(shared_unnamed));
+		if (obj->MxHistograms == NULL)
+		{
+			zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Semaphore histograms could not be created", 0 TSRMLS_CC);
 
-		if (obj->MxNamed)  sync_UnixNamedMemReady(obj->MxMem);
+			return;
+		}
 	}
 
 #endif
 }
 /* }}} */
 
-/* {{{ proto bool Sync_Mutex::lock([int $wait = -1])
-   Locks a mutex object. */
-PHP_METHOD(sync_Mutex, lock)
+/* {{{ Locks Count units of a semaphore all at once. */
+int sync_Semaphore_lock_internal(sync_Semaphore_object *obj, uint32_t Count, uint64_t Deadline)
 {
-	PORTABLE_ZPP_ARG_long wait = -1;
-	sync_Mutex_object *obj;
+	sync_Semaphore_forget_forked(obj);
+
 #if defined(PHP_WIN32)
+
 	DWORD Result;
-#else
-#endif
+	uint32_t x;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|l", &wait) == FAILURE)  return;
+	/* Windows can only wait for one unit at a time.  Take the rest without waiting and start over when they aren't all there. */
+	for (;;)
+	{
+		Result = WaitForSingleObject(obj->MxWinSemaphore, sync_GetWinWaitAmt(Deadline));
+		if (Result != WAIT_OBJECT_0)  return 0;
 
-	obj = (sync_Mutex_object *)PORTABLE_zend_object_store_get_object();
+		for (x = 1; x < Count && WaitForSingleObject(obj->MxWinSemaphore, 0) == WAIT_OBJECT_0; x++)
+		{
+		}
 
-#if defined(PHP_WIN32)
+		if (x == Count)  break;
 
-	EnterCriticalSection(&obj->MxWinCritSection);
+		ReleaseSemaphore(obj->MxWinSemaphore, (LONG)x, NULL);
 
-	/* Check to see if this is already owned by the calling thread. */
-	if (obj->MxOwnerID == sync_GetCurrentThreadID())
-	{
-		obj->MxCount++;
-		LeaveCriticalSection(&obj->MxWinCritSection);
+		if (!sync_GetWinWaitAmt(Deadline))  return 0;
 
-		RETURN_TRUE;
+		Sleep(1);
 	}
 
-	LeaveCriticalSection(&obj->MxWinCritSection);
+#else
 
-	/* Acquire the mutex. */
-	Result = WaitForSingleObject(obj->MxWinMutex, (DWORD)(wait > -1 ? wait : INFINITE));
-	if (Result != WAIT_OBJECT_0)  RETURN_FALSE;
+	/* Only time the wait when the first attempt fails. */
+	uint64_t WaitStart = 0;
+	int Result;
+	if (obj->MxHolders != NULL)
+	{
+		Result = sync_WaitForUnixSemaphoreHolder(&obj->MxPthreadSemaphore, obj->MxHolders, obj->MxNumHolders, Count, SYNC_DEADLINE_NOWAIT);
+		if (!Result && Deadline != SYNC_DEADLINE_NOWAIT)
+		{
+			WaitStart = sync_StartUnixLockWait(obj->MxNameHash, SYNC_PROBE_SEMAPHORE);
+			Result = sync_WaitForUnixSemaphoreHolder(&obj->MxPthreadSemaphore, obj->MxHolders, obj->MxNumHolders, Count, Deadline);
+		}
+	}
+	else
+	{
+		Result = sync_WaitForUnixSemaphoreCount(&obj->MxPthreadSemaphore, Count, SYNC_DEADLINE_NOWAIT);
+		if (!Result && Deadline != SYNC_DEADLINE_NOWAIT)
+		{
+			WaitStart = sync_StartUnixLockWait(obj->MxNameHash, SYNC_PROBE_SEMAPHORE);
+			Result = sync_WaitForUnixSemaphoreCount(&obj->MxPthreadSemaphore, Count, Deadline);
+		}
+	}
 
-	EnterCriticalSection(&obj->MxWinCritSection);
-	obj->MxOwnerID = sync_GetCurrentThreadID();
-	obj->MxCount = 1;
-	LeaveCriticalSection(&obj->MxWinCritSection);
+	if (!sync_EndUnixLockWait(obj->MxStats, obj->MxHistograms, obj->MxNameHash, SYNC_PROBE_SEMAPHORE, WaitStart, Result))  return 0;
 
-#else
+	/* The hold time runs from the first unit this object acquires. */
+	if (!obj->MxHoldStart)  obj->MxHoldStart = sync_GetUnixHoldStart(obj->MxHistograms);
+	if (!obj->MxLimitStart && __atomic_load_n(&obj->MxLimiter->MxTarget, __ATOMIC_RELAXED))  obj->MxLimitStart = sync_GetMonotonicTime();
 
-	if (pthread_mutex_lock(&obj->MxPthreadCritSection) != 0)
-	{
-		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Unable to acquire mutex critical section", 0 TSRMLS_CC);
+#endif
 
-		RETURN_FALSE;
-	}
+	if (obj->MxAutoUnlock)  obj->MxCount += Count;
 
-	/* Check to see if this mutex is already owned by the calling thread. */
-	if (obj->MxOwnerID == sync_GetCurrentThreadID())
-	{
-		obj->MxCount++;
-		pthread_mutex_unlock(&obj->MxPthreadCritSection);
+	return 1;
+}
+/* }}} */
 
-		RETURN_TRUE;
-	}
+/* {{{ proto bool Sync_Semaphore::lock([float $wait = -1, [int $count = 1]])
+   Locks $count units of a semaphore object all at once. */
+PHP_METHOD(sync_Semaphore, lock)
+{
+	double wait = -1;
+	PORTABLE_ZPP_ARG_long count = 1;
+	sync_Semaphore_object *obj;
 
-	pthread_mutex_unlock(&obj->MxPthreadCritSection);
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|dl", &wait, &count) == FAILURE)  return;
 
-	if (!sync_WaitForUnixSemaphore(&obj->MxPthreadMutex, (uint32_t)(wait > -1 ? wait : INFINITE)))  RETURN_FALSE;
+	obj = (sync_Semaphore_object *)PORTABLE_zend_object_store_get_object();
 
-	pthread_mutex_lock(&obj->MxPthreadCritSection);
-	obj->MxOwnerID = sync_GetCurrentThreadID();
-	obj->MxCount = 1;
-	pthread_mutex_unlock(&obj->MxPthreadCritSection);
+	if (count < 1 || count > INT_MAX)
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "An invalid number of units was passed", 0 TSRMLS_CC);
 
-#endif
+		return;
+	}
+
+	if (!sync_Semaphore_lock_internal(obj, (uint32_t)count, sync_GetWaitDeadline(wait)))  RETURN_FALSE;
 
 	RETURN_TRUE;
 }
 /* }}} */
 
-/* {{{ proto bool Sync_Mutex::unlock([bool $all = false])
-   Unlocks a mutex object. */
-PHP_METHOD(sync_Mutex, unlock)
+/* {{{ proto bool Sync_Semaphore::lockUntil(int $deadline, [int $count = 1])
+   Locks $count units of a semaphore object all at once before an absolute hrtime() deadline in nanoseconds. */
+PHP_METHOD(sync_Semaphore, lockUntil)
 {
-	PORTABLE_ZPP_ARG_long all = 0;
-	sync_Mutex_object *obj;
+	double deadline;
+	PORTABLE_ZPP_ARG_long count = 1;
+	sync_Semaphore_object *obj;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|l", &all) == FAILURE)  return;
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "d|l", &deadline, &count) == FAILURE)  return;
 
-	obj = (sync_Mutex_object *)PORTABLE_zend_object_store_get_object();
+	obj = (sync_Semaphore_object *)PORTABLE_zend_object_store_get_object();
 
-	if (!sync_Mutex_unlock_internal(obj, all))  RETURN_FALSE;
+	if (count < 1 || count > INT_MAX)
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "An invalid number of units was passed", 0 TSRMLS_CC);
+
+		return;
+	}
+
+	if (!sync_Semaphore_lock_internal(obj, (uint32_t)count, sync_GetUntilDeadline(deadline)))  RETURN_FALSE;
 
 	RETURN_TRUE;
 }
 /* }}} */
 
+/* {{{ proto bool Sync_Semaphore::unlock([int &$prevcount, [int $count = 1]])
+   Unlocks $count units of a semaphore object all at once. */
+PHP_METHOD(sync_Semaphore, unlock)
+{
+	PORTABLE_ZPP_ARG_zval_ref zprevcount = NULL;
+	sync_Semaphore_object *obj;
+	PORTABLE_ZPP_ARG_long count = 1;
+	PORTABLE_ZPP_ARG_long prevcount;
+#if defined(PHP_WIN32)
+	LONG PrevCount;
+#else
+	uint32_t PrevCount, Removed;
+	uint64_t CurrTime;
+#endif
 
-ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_mutex___construct, 0, 0, 0)
-	ZEND_ARG_INFO(0, name)
-ZEND_END_ARG_INFO()
+#if PHP_MAJOR_VERSION >= 7
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|z/l", &zprevcount, &count) == FAILURE)  return;
+#else
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|Zl", &zprevcount, &count) == FAILURE)  return;
+#endif
 
-ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_mutex_lock, 0, 0, 0)
-	ZEND_ARG_INFO(0, wait)
-ZEND_END_ARG_INFO()
+	obj = (sync_Semaphore_object *)PORTABLE_zend_object_store_get_object();
 
-ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_mutex_unlock, 0, 0, 0)
-	ZEND_ARG_INFO(0, all)
-ZEND_END_ARG_INFO()
+	if (count < 1 || count > INT_MAX)
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "An invalid number of units was passed", 0 TSRMLS_CC);
 
-static const zend_function_entry sync_Mutex_methods[] = {
-	PHP_ME(sync_Mutex, __construct, arginfo_sync_mutex___construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
-	PHP_ME(sync_Mutex, lock, arginfo_sync_mutex_lock, ZEND_ACC_PUBLIC)
-	PHP_ME(sync_Mutex, unlock, arginfo_sync_mutex_unlock, ZEND_ACC_PUBLIC)
-	PHP_FE_END
-};
+		return;
+	}
 
+	sync_Semaphore_forget_forked(obj);
 
+#if defined(PHP_WIN32)
 
-/* Semaphore */
-PHP_SYNC_API zend_class_entry *sync_Semaphore_ce;
-static zend_object_handlers sync_Semaphore_object_handlers;
+	if (!ReleaseSemaphore(obj->MxWinSemaphore, (LONG)count, &PrevCount))  RETURN_FALSE;
 
-PORTABLE_free_zend_object_func(sync_Semaphore_free_object);
+#else
 
-/* {{{ Initialize internal Semaphore structure. */
-PORTABLE_new_zend_object_func(sync_Semaphore_create_object)
+	/* The units are still held if the internal mutex couldn't be recovered, so they go back in the holder table. */
+	Removed = (obj->MxHolders != NULL ? sync_RemoveUnixSemaphoreHolder(obj->MxHolders, obj->MxNumHolders, (uint32_t)count) : 0);
+	if (!sync_ReleaseUnixSemaphoreCount(&obj->MxPthreadSemaphore, (uint32_t)count, &PrevCount))
+	{
+		if (Removed)  sync_AddUnixSemaphoreHolder(obj->MxHolders, obj->MxNumHolders, Removed);
+
+		RETURN_FALSE;
+	}
+
+	sync_AddUnixLockRelease(obj->MxStats, obj->MxHistograms, obj->MxNameHash, SYNC_PROBE_SEMAPHORE, obj->MxHoldStart);
+	if (!obj->MxAutoUnlock || obj->MxCount <= (unsigned int)count)  obj->MxHoldStart = 0;
+
+	if (obj->MxLimitStart)
+	{
+		CurrTime = sync_GetMonotonicTime();
+		sync_UpdateUnixSemaphoreLimiter(&obj->MxPthreadSemaphore, obj->MxLimiter, (CurrTime > obj->MxLimitStart ? CurrTime - obj->MxLimitStart : 0), CurrTime);
+
+		if (!obj->MxAutoUnlock || obj->MxCount <= (unsigned int)count)  obj->MxLimitStart = 0;
+	}
+
+#endif
+
+	if (zprevcount != NULL)
+	{
+		prevcount = (PORTABLE_ZPP_ARG_long)PrevCount;
+
+		zval_dtor(PORTABLE_ZPP_ARG_zval_ref_deref(zprevcount));
+		ZVAL_LONG(PORTABLE_ZPP_ARG_zval_ref_deref(zprevcount), prevcount);
+	}
+
+	/* Units this object doesn't hold (e.g. a producer signaling a consumer) don't count against the ones it does. */
+	if (obj->MxAutoUnlock)  obj->MxCount -= ((unsigned int)count < obj->MxCount ? (unsigned int)count : obj->MxCount);
+
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool Sync_Semaphore::setCapacity(int $capacity)
+   Changes the number of units in place for every process.  Units taken away while they are in use are taken away as they are unlocked. */
+PHP_METHOD(sync_Semaphore, setCapacity)
 {
-	PORTABLE_new_zend_object_return_var;
+	PORTABLE_ZPP_ARG_long capacity;
 	sync_Semaphore_object *obj;
 
-	/* Create the object. */
-	obj = (sync_Semaphore_object *)PORTABLE_allocate_zend_object(sizeof(sync_Semaphore_object), ce);
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "l", &capacity) == FAILURE)  return;
 
-	PORTABLE_InitZendObject(obj, &obj->std, PORTABLE_new_zend_object_return_var_ref, sync_Semaphore_free_object, &sync_Semaphore_object_handlers, ce TSRMLS_CC);
+	obj = (sync_Semaphore_object *)PORTABLE_zend_object_store_get_object();
+
+	if (capacity < 1 || capacity > INT_MAX)
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "An invalid capacity was passed", 0 TSRMLS_CC);
+
+		return;
+	}
 
-	/* Initialize Semaphore information. */
 #if defined(PHP_WIN32)
-	obj->MxWinSemaphore = NULL;
+
+	RETURN_FALSE;
+
 #else
-	obj->MxNamed = 0;
-	obj->MxMem = NULL;
-#endif
-	obj->MxAutoUnlock = 0;
-	obj->MxCount = 0;
 
-	PORTABLE_new_zend_object_return(&obj->std);
+	/* Units past the end of the holder table couldn't be recorded. */
+	if (obj->MxHolders != NULL && (uint32_t)capacity > obj->MxNumHolders)  RETURN_FALSE;
+
+	if (!sync_SetUnixSemaphoreMax(&obj->MxPthreadSemaphore, (uint32_t)capacity))  RETURN_FALSE;
+
+	RETURN_TRUE;
+
+#endif
 }
 /* }}} */
 
-/* {{{ Free internal Semaphore structure. */
-PORTABLE_free_zend_object_func(sync_Semaphore_free_object)
+/* {{{ proto int Sync_Semaphore::getCapacity()
+   Returns the number of units. */
+PHP_METHOD(sync_Semaphore, getCapacity)
 {
-	sync_Semaphore_object *obj = (sync_Semaphore_object *)PORTABLE_free_zend_object_get_object(object);
+	sync_Semaphore_object *obj;
+
+	obj = (sync_Semaphore_object *)PORTABLE_zend_object_store_get_object();
 
-	if (obj->MxAutoUnlock)
-	{
-		while (obj->MxCount)
-		{
 #if defined(PHP_WIN32)
-			ReleaseSemaphore(obj->MxWinSemaphore, 1, NULL);
+
+	RETURN_FALSE;
+
 #else
-			sync_ReleaseUnixSemaphore(&obj->MxPthreadSemaphore, NULL);
+
+	RETURN_LONG((PORTABLE_ZPP_ARG_long)__atomic_load_n(obj->MxPthreadSemaphore.MxMax, __ATOMIC_RELAXED));
+
 #endif
+}
+/* }}} */
 
-			obj->MxCount--;
-		}
-	}
+/* {{{ proto int Sync_Semaphore::getValue()
+   Returns the number of units that can be locked right now without waiting.  Never blocks. */
+PHP_METHOD(sync_Semaphore, getValue)
+{
+	sync_Semaphore_object *obj;
+
+	obj = (sync_Semaphore_object *)PORTABLE_zend_object_store_get_object();
 
 #if defined(PHP_WIN32)
-	if (obj->MxWinSemaphore != NULL)  CloseHandle(obj->MxWinSemaphore);
+
+	RETURN_FALSE;
+
 #else
-	if (obj->MxMem != NULL)
-	{
-		if (obj->MxNamed)  sync_UnmapUnixNamedMem(obj->MxMem, sync_GetUnixSemaphoreSize());
-		else
-		{
-			sync_FreeUnixSemaphore(&obj->MxPthreadSemaphore);
 
-			efree(obj->MxMem);
-		}
-	}
-#endif
+	RETURN_LONG((PORTABLE_ZPP_ARG_long)sync_GetUnixSemaphoreValue(&obj->MxPthreadSemaphore));
 
-	PORTABLE_free_zend_object_free_object(obj);
+#endif
 }
 /* }}} */
 
-/* {{{ proto void Sync_Semaphore::__construct([string $name = null, [int $initialval = 1, [bool $autounlock = true]]])
-   Constructs a named or unnamed semaphore object.  Don't set $autounlock to false unless you really know what you are doing. */
-PHP_METHOD(sync_Semaphore, __construct)
+/* {{{ proto bool Sync_Semaphore::setAdaptive(float $target, [int $mincapacity = 1, [int $maxcapacity = 0]])
+   Turns on an AIMD controller that adjusts the capacity based on hold times.  $target is in milliseconds and 0 turns the controller off.  A $maxcapacity of 0 is the current capacity. */
+PHP_METHOD(sync_Semaphore, setAdaptive)
 {
-	char *name = NULL;
-	PORTABLE_ZPP_ARG_size name_len;
-	PORTABLE_ZPP_ARG_long initialval = 1;
-	PORTABLE_ZPP_ARG_long autounlock = 1;
+	double target;
+	PORTABLE_ZPP_ARG_long mincapacity = 1;
+	PORTABLE_ZPP_ARG_long maxcapacity = 0;
 	sync_Semaphore_object *obj;
-#if defined(PHP_WIN32)
-	SECURITY_ATTRIBUTES SecAttr;
-#else
-	size_t Pos, TempSize;
+#if !defined(PHP_WIN32)
+	uint32_t Max;
 #endif
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|s!ll", &name, &name_len, &initialval, &autounlock) == FAILURE)  return;
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "d|ll", &target, &mincapacity, &maxcapacity) == FAILURE)  return;
 
 	obj = (sync_Semaphore_object *)PORTABLE_zend_object_store_get_object();
 
-	if (name_len < 1)  name = NULL;
-
-	obj->MxAutoUnlock = (autounlock ? 1 : 0);
-
 #if defined(PHP_WIN32)
 
-	SecAttr.nLength = sizeof(SecAttr);
-	SecAttr.lpSecurityDescriptor = NULL;
-	SecAttr.bInheritHandle = TRUE;
-
-	obj->MxWinSemaphore = CreateSemaphoreA(&SecAttr, (LONG)initialval, (LONG)initialval, name);
-	if (obj->MxWinSemaphore == NULL)
-	{
-		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Semaphore could not be created", 0 TSRMLS_CC);
-		return;
-	}
+	RETURN_FALSE;
 
 #else
 
-	TempSize = sync_GetUnixSemaphoreSize();
-	obj->MxNamed = (name != NULL ? 1 : 0);
-	int Result = sync_InitUnixNamedMem(&obj->MxMem, &Pos, "/Sync_Semaphore", name, TempSize);
+	Max = __atomic_load_n(obj->MxPthreadSemaphore.MxMax, __ATOMIC_RELAXED);
+	if (!maxcapacity)  maxcapacity = (PORTABLE_ZPP_ARG_long)Max;
 
-	if (Result < 0)
+	if (target < 0 || mincapacity < 1 || maxcapacity < mincapacity || maxcapacity > INT_MAX)
 	{
-		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Semaphore could not be created", 0 TSRMLS_CC);
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "An invalid target or capacity range was passed", 0 TSRMLS_CC);
 
 		return;
 	}
 
-	sync_GetUnixSemaphore(&obj->MxPthreadSemaphore, obj->MxMem + Pos);
+	if (obj->MxHolders != NULL && (uint32_t)maxcapacity > obj->MxNumHolders)  RETURN_FALSE;
 
-	/* Handle the first time this semaphore has been opened. */
-	if (Result == 0)
-	{
-		sync_InitUnixSemaphore(&obj->MxPthreadSemaphore, obj->MxNamed, (uint32_t)initialval, (uint32_t)initialval);
+	/* Turn the controller off while changing the range. */
+	__atomic_store_n(&obj->MxLimiter->MxTarget, 0, __ATOMIC_RELAXED);
 
-		if (obj->MxNamed)  sync_UnixNamedMemReady(obj->MxMem);
-	}
+	obj->MxLimiter->MxMin = (uint32_t)mincapacity;
+	obj->MxLimiter->MxMax = (uint32_t)maxcapacity;
+	obj->MxLimiter->MxFast = 0;
+	obj->MxLimiter->MxLastDecrease = 0;
+
+	if (Max < (uint32_t)mincapacity)  sync_SetUnixSemaphoreMax(&obj->MxPthreadSemaphore, (uint32_t)mincapacity);
+	else if (Max > (uint32_t)maxcapacity)  sync_SetUnixSemaphoreMax(&obj->MxPthreadSemaphore, (uint32_t)maxcapacity);
+
+	__atomic_store_n(&obj->MxLimiter->MxTarget, (uint64_t)(target * 1000000.0), __ATOMIC_RELEASE);
+
+	RETURN_TRUE;
 
 #endif
 }
 /* }}} */
 
-/* {{{ proto bool Sync_Semaphore::lock([int $wait = -1])
-   Locks a semaphore object. */
-PHP_METHOD(sync_Semaphore, lock)
+/* {{{ proto int Sync_Semaphore::reclaim()
+   Releases units held by processes that died.  Returns the number of units released.  Requires $holders at construction. */
+PHP_METHOD(sync_Semaphore, reclaim)
 {
-	PORTABLE_ZPP_ARG_long wait = -1;
 	sync_Semaphore_object *obj;
-#if defined(PHP_WIN32)
-	DWORD Result;
-#else
-#endif
-
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|l", &wait) == FAILURE)  return;
 
 	obj = (sync_Semaphore_object *)PORTABLE_zend_object_store_get_object();
 
 #if defined(PHP_WIN32)
 
-	Result = WaitForSingleObject(obj->MxWinSemaphore, (DWORD)(wait > -1 ? wait : INFINITE));
-	if (Result != WAIT_OBJECT_0)  RETURN_FALSE;
+	RETURN_FALSE;
 
 #else
 
-	if (!sync_WaitForUnixSemaphore(&obj->MxPthreadSemaphore, (uint32_t)(wait > -1 ? wait : INFINITE)))  RETURN_FALSE;
-
-#endif
+	if (obj->MxHolders == NULL)  RETURN_FALSE;
 
-	if (obj->MxAutoUnlock)  obj->MxCount++;
+	RETURN_LONG((PORTABLE_ZPP_ARG_long)sync_ReclaimUnixSemaphoreHolders(&obj->MxPthreadSemaphore, obj->MxHolders, obj->MxNumHolders));
 
-	RETURN_TRUE;
+#endif
 }
 /* }}} */
 
-/* {{{ proto bool Sync_Semaphore::unlock([int &$prevcount])
-   Unlocks a semaphore object. */
-PHP_METHOD(sync_Semaphore, unlock)
+/* {{{ proto array Sync_Semaphore::getStats()
+   Returns contention statistics for the semaphore.  Named objects aggregate across all processes. */
+PHP_METHOD(sync_Semaphore, getStats)
 {
-	PORTABLE_ZPP_ARG_zval_ref zprevcount = NULL;
 	sync_Semaphore_object *obj;
-	PORTABLE_ZPP_ARG_long count;
-#if defined(PHP_WIN32)
-	LONG PrevCount;
-#else
-	uint32_t PrevCount;
-#endif
-
-#if PHP_MAJOR_VERSION >= 7
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|z/", &zprevcount) == FAILURE)  return;
-#else
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|Z", &zprevcount) == FAILURE)  return;
-#endif
 
 	obj = (sync_Semaphore_object *)PORTABLE_zend_object_store_get_object();
 
 #if defined(PHP_WIN32)
 
-	if (!ReleaseSemaphore(obj->MxWinSemaphore, 1, &PrevCount))  RETURN_FALSE;
+	RETURN_FALSE;
 
 #else
 
-	sync_ReleaseUnixSemaphore(&obj->MxPthreadSemaphore, &PrevCount);
+	if (obj->MxStats == NULL)  RETURN_FALSE;
+
+	sync_GetUnixStatsArray(obj->MxStats, return_value);
 
 #endif
+}
+/* }}} */
 
-	if (zprevcount != NULL)
-	{
-		count = (PORTABLE_ZPP_ARG_long)PrevCount;
+/* {{{ proto array Sync_Semaphore::getPercentiles()
+   Returns wait and hold time percentiles for the semaphore.  Requires $histograms at construction. */
+PHP_METHOD(sync_Semaphore, getPercentiles)
+{
+	sync_Semaphore_object *obj;
 
-		zval_dtor(PORTABLE_ZPP_ARG_zval_ref_deref(zprevcount));
-		ZVAL_LONG(PORTABLE_ZPP_ARG_zval_ref_deref(zprevcount), count);
-	}
+	obj = (sync_Semaphore_object *)PORTABLE_zend_object_store_get_object();
 
-	if (obj->MxAutoUnlock)  obj->MxCount--;
+#if defined(PHP_WIN32)
 
-	RETURN_TRUE;
+	RETURN_FALSE;
+
+#else
+
+	if (obj->MxHistograms == NULL)  RETURN_FALSE;
+
+	sync_GetUnixHistogramsArray(obj->MxHistograms, return_value);
+
+#endif
 }
 /* }}} */
 
@@ -1256,20 +5078,63 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_semaphore___construct, 0, 0, 0)
 	ZEND_ARG_INFO(0, name)
 	ZEND_ARG_INFO(0, initialval)
 	ZEND_ARG_INFO(0, autounlock)
+	ZEND_ARG_INFO(0, histograms)
+	ZEND_ARG_INFO(0, holders)
+	ZEND_ARG_INFO(0, fair)
 ZEND_END_ARG_INFO()
 
 ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_semaphore_lock, 0, 0, 0)
 	ZEND_ARG_INFO(0, wait)
+	ZEND_ARG_INFO(0, count)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_semaphore_lockuntil, 0, 0, 1)
+	ZEND_ARG_INFO(0, deadline)
+	ZEND_ARG_INFO(0, count)
 ZEND_END_ARG_INFO()
 
 ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_semaphore_unlock, 0, 0, 0)
 	ZEND_ARG_INFO(1, prevcount)
+	ZEND_ARG_INFO(0, count)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_semaphore_setcapacity, 0, 0, 1)
+	ZEND_ARG_INFO(0, capacity)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_semaphore_getcapacity, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_semaphore_getvalue, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_semaphore_setadaptive, 0, 0, 1)
+	ZEND_ARG_INFO(0, target)
+	ZEND_ARG_INFO(0, mincapacity)
+	ZEND_ARG_INFO(0, maxcapacity)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_semaphore_reclaim, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_semaphore_getstats, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_semaphore_getpercentiles, 0, 0, 0)
 ZEND_END_ARG_INFO()
 
 static const zend_function_entry sync_Semaphore_methods[] = {
 	PHP_ME(sync_Semaphore, __construct, arginfo_sync_semaphore___construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
 	PHP_ME(sync_Semaphore, lock, arginfo_sync_semaphore_lock, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_Semaphore, lockUntil, arginfo_sync_semaphore_lockuntil, ZEND_ACC_PUBLIC)
 	PHP_ME(sync_Semaphore, unlock, arginfo_sync_semaphore_unlock, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_Semaphore, setCapacity, arginfo_sync_semaphore_setcapacity, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_Semaphore, getCapacity, arginfo_sync_semaphore_getcapacity, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_Semaphore, getValue, arginfo_sync_semaphore_getvalue, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_Semaphore, setAdaptive, arginfo_sync_semaphore_setadaptive, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_Semaphore, reclaim, arginfo_sync_semaphore_reclaim, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_Semaphore, getStats, arginfo_sync_semaphore_getstats, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_Semaphore, getPercentiles, arginfo_sync_semaphore_getpercentiles, ZEND_ACC_PUBLIC)
 	PHP_FE_END
 };
 
@@ -1296,8 +5161,10 @@ PORTABLE_new_zend_object_func(sync_Event_create_object)
 #if defined(PHP_WIN32)
 	obj->MxWinWaitEvent = NULL;
 #else
-	obj->MxNamed = 0;
+	obj->MxMemType = SYNC_UNIX_MEM_PRIVATE;
 	obj->MxMem = NULL;
+	obj->MxStats = NULL;
+	obj->MxNameHash = 0;
 #endif
 
 	PORTABLE_new_zend_object_return(&obj->std);
@@ -1314,8 +5181,7 @@ PORTABLE_free_zend_object_func(sync_Event_free_object)
 #else
 	if (obj->MxMem != NULL)
 	{
-		if (obj->MxNamed)  sync_UnmapUnixNamedMem(obj->MxMem, sync_GetUnixEventSize());
-		else
+		if (!sync_CloseUnixObjectMem(obj->MxMem, obj->MxMemType, sync_GetUnixEventSize()))
 		{
 			sync_FreeUnixEvent(&obj->MxPthreadEvent);
 
@@ -1364,8 +5230,8 @@ PHP_METHOD(sync_Event, __construct)
 #else
 
 	TempSize = sync_GetUnixEventSize();
-	obj->MxNamed = (name != NULL ? 1 : 0);
-	int Result = sync_InitUnixNamedMem(&obj->MxMem, &Pos, "/Sync_Event", name, TempSize);
+	obj->MxNameHash = sync_GetUnixNameHash(name);
+	int Result = sync_OpenUnixObjectMem(&obj->MxMem, &Pos, &obj->MxMemType, "/Sync_Event", name, SYNC_G(shared_unnamed), TempSize);
 
 	if (Result < 0)
 	{
@@ -1374,44 +5240,87 @@ PHP_METHOD(sync_Event, __construct)
 		return;
 	}
 
-	sync_GetUnixEvent(&obj->MxPthreadEvent, obj->MxMem + Pos);
+	obj->MxStats = sync_GetUnixNamedMemStats(obj->MxMem, Pos);
+	sync_GetUnixEvent(&obj->MxPthreadEvent, obj->MxMem + Pos, sync_GetSpinLimit(TSRMLS_C));
 
 	/* Handle the first time this event has been opened. */
 	if (Result == 0)
 	{
-		sync_InitUnixEvent(&obj->MxPthreadEvent, obj->MxNamed, (manual ? 1 : 0), (prefire ? 1 : 0));
+		sync_InitUnixEvent(&obj->MxPthreadEvent, (obj->MxMemType != SYNC_UNIX_MEM_PRIVATE), (manual ? 1 : 0), (prefire ? 1 : 0));
+
+		if (obj->MxMemType == SYNC_UNIX_MEM_NAMED)  sync_UnixNamedMemReady(obj->MxMem);
+	}
+
+	/* Firing rings the bell for waitAny() and waitAll() in other processes.  Private events are only waited on by this process, which maps the bell itself. */
+	if (obj->MxMemType != SYNC_UNIX_MEM_PRIVATE && sync_GetUnixEventBell() == NULL)
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Event object could not be created", 0 TSRMLS_CC);
 
-		if (obj->MxNamed)  sync_UnixNamedMemReady(obj->MxMem);
+		return;
 	}
 
 #endif
 }
 /* }}} */
 
-/* {{{ proto bool Sync_Event::wait([int $wait = -1])
-   Waits for an event object to fire. */
-PHP_METHOD(sync_Event, wait)
+/* {{{ Waits for an event to fire. */
+int sync_Event_wait_internal(sync_Event_object *obj, uint64_t Deadline)
 {
-	PORTABLE_ZPP_ARG_long wait = -1;
-	sync_Event_object *obj;
 #if defined(PHP_WIN32)
+
 	DWORD Result;
+
+	Result = WaitForSingleObject(obj->MxWinWaitEvent, sync_GetWinWaitAmt(Deadline));
+	if (Result != WAIT_OBJECT_0)  return 0;
+
+#else
+
+	/* Only time the wait when the first attempt fails. */
+	uint64_t WaitStart = 0;
+	int Result = sync_WaitForUnixEvent(&obj->MxPthreadEvent, SYNC_DEADLINE_NOWAIT);
+	if (!Result && Deadline != SYNC_DEADLINE_NOWAIT)
+	{
+		WaitStart = sync_StartUnixLockWait(obj->MxNameHash, SYNC_PROBE_EVENT);
+		Result = sync_WaitForUnixEvent(&obj->MxPthreadEvent, Deadline);
+	}
+
+	if (!sync_EndUnixLockWait(obj->MxStats, NULL, obj->MxNameHash, SYNC_PROBE_EVENT, WaitStart, Result))  return 0;
+
 #endif
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|l", &wait) == FAILURE)  return;
+	return 1;
+}
+/* }}} */
+
+/* {{{ proto bool Sync_Event::wait([float $wait = -1])
+   Waits for an event object to fire. */
+PHP_METHOD(sync_Event, wait)
+{
+	double wait = -1;
+	sync_Event_object *obj;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|d", &wait) == FAILURE)  return;
 
 	obj = (sync_Event_object *)PORTABLE_zend_object_store_get_object();
 
-#if defined(PHP_WIN32)
+	if (!sync_Event_wait_internal(obj, sync_GetWaitDeadline(wait)))  RETURN_FALSE;
 
-	Result = WaitForSingleObject(obj->MxWinWaitEvent, (DWORD)(wait > -1 ? wait : INFINITE));
-	if (Result != WAIT_OBJECT_0)  RETURN_FALSE;
+	RETURN_TRUE;
+}
+/* }}} */
 
-#else
+/* {{{ proto bool Sync_Event::waitUntil(int $deadline)
+   Waits for an event object to fire before an absolute hrtime() deadline in nanoseconds. */
+PHP_METHOD(sync_Event, waitUntil)
+{
+	double deadline;
+	sync_Event_object *obj;
 
-	if (!sync_WaitForUnixEvent(&obj->MxPthreadEvent, (uint32_t)(wait > -1 ? wait : INFINITE)))  RETURN_FALSE;
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "d", &deadline) == FAILURE)  return;
 
-#endif
+	obj = (sync_Event_object *)PORTABLE_zend_object_store_get_object();
+
+	if (!sync_Event_wait_internal(obj, sync_GetUntilDeadline(deadline)))  RETURN_FALSE;
 
 	RETURN_TRUE;
 }
@@ -1431,8 +5340,12 @@ PHP_METHOD(sync_Event, fire)
 
 #else
 
+	SYNC_PROBE2(fired, obj->MxNameHash, SYNC_PROBE_EVENT);
+
 	if (!sync_FireUnixEvent(&obj->MxPthreadEvent))  RETURN_FALSE;
 
+	sync_RingUnixEventBell();
+
 #endif
 
 	RETURN_TRUE;
@@ -1461,6 +5374,202 @@ PHP_METHOD(sync_Event, reset)
 }
 /* }}} */
 
+/* {{{ proto array Sync_Event::getStats()
+   Returns contention statistics for the event object.  Named objects aggregate across all processes. */
+PHP_METHOD(sync_Event, getStats)
+{
+	sync_Event_object *obj;
+
+	obj = (sync_Event_object *)PORTABLE_zend_object_store_get_object();
+
+#if defined(PHP_WIN32)
+
+	RETURN_FALSE;
+
+#else
+
+	if (obj->MxStats == NULL)  RETURN_FALSE;
+
+	sync_GetUnixStatsArray(obj->MxStats, return_value);
+
+#endif
+}
+/* }}} */
+
+
+/* {{{ Collects the Event objects in an array for waitAny() and waitAll().  Returns the number of objects or -1 when the array holds anything else. */
+int sync_Event_get_objects(HashTable *Events, sync_Event_object **Objs TSRMLS_DC)
+{
+	sync_Event_object *obj;
+	int Num = 0;
+#if PHP_MAJOR_VERSION >= 7
+	zval *entry;
+
+	ZEND_HASH_FOREACH_VAL(Events, entry)
+	{
+		ZVAL_DEREF(entry);
+		if (Z_TYPE_P(entry) != IS_OBJECT || !instanceof_function(Z_OBJCE_P(entry), sync_Event_ce))  return -1;
+
+		obj = (sync_Event_object *)PHP_7_zend_object_to_object(Z_OBJ_P(entry));
+#else
+	zval **entry;
+	HashPosition Pos;
+
+	for (zend_hash_internal_pointer_reset_ex(Events, &Pos); zend_hash_get_current_data_ex(Events, (void **)&entry, &Pos) == SUCCESS; zend_hash_move_forward_ex(Events, &Pos))
+	{
+		if (Z_TYPE_PP(entry) != IS_OBJECT || !instanceof_function(Z_OBJCE_PP(entry), sync_Event_ce TSRMLS_CC))  return -1;
+
+		obj = (sync_Event_object *)zend_object_store_get_object(*entry TSRMLS_CC);
+#endif
+
+		/* Objects whose constructor failed can't be waited on. */
+#if defined(PHP_WIN32)
+		if (obj->MxWinWaitEvent == NULL)  return -1;
+#else
+		if (obj->MxMem == NULL)  return -1;
+#endif
+
+		Objs[Num++] = obj;
+	}
+#if PHP_MAJOR_VERSION >= 7
+	ZEND_HASH_FOREACH_END();
+#endif
+
+	return Num;
+}
+/* }}} */
+
+/* {{{ Sets Result to the key of the array element at a position. */
+void sync_Event_get_key(HashTable *Events, uint32_t Index, zval *Result)
+{
+	uint32_t x = 0;
+#if PHP_MAJOR_VERSION >= 7
+	zend_ulong num_key;
+	zend_string *str_key;
+
+	ZEND_HASH_FOREACH_KEY(Events, num_key, str_key)
+	{
+		if (x == Index)
+		{
+			if (str_key != NULL)  ZVAL_STR_COPY(Result, str_key);
+			else  ZVAL_LONG(Result, (zend_long)num_key);
+
+			break;
+		}
+
+		x++;
+	} ZEND_HASH_FOREACH_END();
+#else
+	char *str_key;
+	uint str_key_len;
+	ulong num_key;
+	HashPosition Pos;
+
+	for (zend_hash_internal_pointer_reset_ex(Events, &Pos); x < Index && zend_hash_move_forward_ex(Events, &Pos) == SUCCESS; x++)
+	{
+	}
+
+	if (zend_hash_get_current_key_ex(Events, &str_key, &str_key_len, &num_key, 0, &Pos) == HASH_KEY_IS_STRING)  ZVAL_STRINGL(Result, str_key, str_key_len - 1, 1);
+	else  ZVAL_LONG(Result, (long)num_key);
+#endif
+}
+/* }}} */
+
+/* {{{ Waits for any or all of the events in an array to fire.  Returns the position of the event that fired for any, 0 for all, and -1 on timeout or failure. */
+int sync_Event_wait_multiple_internal(HashTable *Events, int All, uint64_t Deadline TSRMLS_DC)
+{
+	sync_Event_object **Objs;
+	int Num, x, Result;
+
+	if (!zend_hash_num_elements(Events))  return -1;
+
+	Objs = (sync_Event_object **)safe_emalloc(zend_hash_num_elements(Events), sizeof(sync_Event_object *), 0);
+	Num = sync_Event_get_objects(Events, Objs TSRMLS_CC);
+	if (Num < 0)
+	{
+		efree(Objs);
+
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Events must be an array of SyncEvent objects", 0 TSRMLS_CC);
+
+		return -1;
+	}
+
+#if defined(PHP_WIN32)
+
+	HANDLE Handles[MAXIMUM_WAIT_OBJECTS];
+	DWORD Result2;
+
+	if (Num > MAXIMUM_WAIT_OBJECTS)
+	{
+		efree(Objs);
+
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Too many events (the limit on Windows is 64)", 0 TSRMLS_CC);
+
+		return -1;
+	}
+
+	for (x = 0; x < Num; x++)  Handles[x] = Objs[x]->MxWinWaitEvent;
+
+	/* Windows takes all of the events at once. */
+	Result2 = WaitForMultipleObjects((DWORD)Num, Handles, (All ? TRUE : FALSE), sync_GetWinWaitAmt(Deadline));
+	Result = (Result2 >= WAIT_OBJECT_0 && Result2 < WAIT_OBJECT_0 + (DWORD)Num ? (All ? 0 : (int)(Result2 - WAIT_OBJECT_0)) : -1);
+
+#else
+
+	sync_UnixEventWrapper **UnixEvents = (sync_UnixEventWrapper **)safe_emalloc(Num, sizeof(sync_UnixEventWrapper *), 0);
+	char *Taken = (char *)ecalloc(Num, 1);
+	uint32_t Index = 0;
+
+	for (x = 0; x < Num; x++)  UnixEvents[x] = &Objs[x]->MxPthreadEvent;
+
+	Result = sync_WaitForUnixEvents(UnixEvents, Taken, (uint32_t)Num, All, Deadline, &Index);
+	if (Result < 0)  zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Unable to open the shared event bell", 0 TSRMLS_CC);
+
+	Result = (Result > 0 ? (int)Index : -1);
+
+	efree(Taken);
+	efree(UnixEvents);
+
+#endif
+
+	efree(Objs);
+
+	return Result;
+}
+/* }}} */
+
+/* {{{ proto mixed Sync_Event::waitAny(array $events, [float $wait = -1])
+   Waits for any of an array of event objects to fire.  Returns the key of the event that fired or false on timeout. */
+PHP_METHOD(sync_Event, waitAny)
+{
+	zval *events;
+	double wait = -1;
+	int Result;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "a|d", &events, &wait) == FAILURE)  return;
+
+	Result = sync_Event_wait_multiple_internal(Z_ARRVAL_P(events), 0, sync_GetWaitDeadline(wait) TSRMLS_CC);
+	if (Result < 0)  RETURN_FALSE;
+
+	sync_Event_get_key(Z_ARRVAL_P(events), (uint32_t)Result, return_value);
+}
+/* }}} */
+
+/* {{{ proto bool Sync_Event::waitAll(array $events, [float $wait = -1])
+   Waits for all of an array of event objects to fire. */
+PHP_METHOD(sync_Event, waitAll)
+{
+	zval *events;
+	double wait = -1;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "a|d", &events, &wait) == FAILURE)  return;
+
+	if (sync_Event_wait_multiple_internal(Z_ARRVAL_P(events), 1, sync_GetWaitDeadline(wait) TSRMLS_CC) < 0)  RETURN_FALSE;
+
+	RETURN_TRUE;
+}
+/* }}} */
+
 
 ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_event___construct, 0, 0, 0)
 	ZEND_ARG_INFO(0, name)
@@ -1471,17 +5580,38 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_event_wait, 0, 0, 0)
 	ZEND_ARG_INFO(0, wait)
 ZEND_END_ARG_INFO()
 
-ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_event_fire, 0, 0, 0)
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_event_waituntil, 0, 0, 1)
+	ZEND_ARG_INFO(0, deadline)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_event_fire, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_event_reset, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_event_getstats, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_event_waitany, 0, 0, 1)
+	ZEND_ARG_INFO(0, events)
+	ZEND_ARG_INFO(0, wait)
 ZEND_END_ARG_INFO()
 
-ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_event_reset, 0, 0, 0)
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_event_waitall, 0, 0, 1)
+	ZEND_ARG_INFO(0, events)
+	ZEND_ARG_INFO(0, wait)
 ZEND_END_ARG_INFO()
 
 static const zend_function_entry sync_Event_methods[] = {
 	PHP_ME(sync_Event, __construct, arginfo_sync_event___construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
 	PHP_ME(sync_Event, wait, arginfo_sync_event_wait, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_Event, waitUntil, arginfo_sync_event_waituntil, ZEND_ACC_PUBLIC)
 	PHP_ME(sync_Event, fire, arginfo_sync_event_fire, ZEND_ACC_PUBLIC)
 	PHP_ME(sync_Event, reset, arginfo_sync_event_reset, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_Event, getStats, arginfo_sync_event_getstats, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_Event, waitAny, arginfo_sync_event_waitany, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(sync_Event, waitAll, arginfo_sync_event_waitall, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
 	PHP_FE_END
 };
 
@@ -1511,35 +5641,88 @@ PORTABLE_new_zend_object_func(sync_ReaderWriter_create_object)
 	obj->MxWinRWaitEvent = NULL;
 	obj->MxWinWWaitMutex = NULL;
 #else
-	obj->MxNamed = 0;
+	obj->MxMemType = SYNC_UNIX_MEM_PRIVATE;
 	obj->MxMem = NULL;
-	obj->MxRCount = NULL;
+	obj->MxReaderSlots = 0;
+	obj->MxSlotsMem = NULL;
+	obj->MxStats = NULL;
+	obj->MxNameHash = 0;
+	obj->MxHoldStart = 0;
+	obj->MxHistMem = NULL;
+	obj->MxHistograms = NULL;
+	obj->MxForkGen = sync_UnixForkGeneration;
 #endif
 
 	obj->MxAutoUnlock = 1;
 	obj->MxReadLocks = 0;
 	obj->MxWriteLock = 0;
+	obj->MxAbandoned = 0;
+	obj->MxUpgradeLock = 0;
 
 	PORTABLE_new_zend_object_return(&obj->std);
 }
 /* }}} */
 
-/* {{{ Unlocks a read lock. */
-int sync_ReaderWriter_readunlock_internal(sync_ReaderWriter_object *obj)
+/* {{{ Forgets locks inherited through fork().  Only the parent process can release them. */
+static inline void sync_ReaderWriter_forget_forked(sync_ReaderWriter_object *obj)
 {
+#if !defined(PHP_WIN32)
+	if (sync_IsUnixForkedState(&obj->MxForkGen))
+	{
+		obj->MxReadLocks = 0;
+		obj->MxWriteLock = 0;
+		obj->MxUpgradeLock = 0;
+		obj->MxHoldStart = 0;
+	}
+#endif
+}
+/* }}} */
+
 #if defined(PHP_WIN32)
+/* {{{ Adds a reader.  The caller holds the write lock mutex. */
+int sync_ReaderWriter_AddWinReader(sync_ReaderWriter_object *obj, uint64_t Deadline)
+{
+	DWORD Result;
+
+	/* Acquire the semaphore mutex. */
+	Result = WaitForSingleObject(obj->MxWinRSemMutex, sync_GetWinWaitAmt(Deadline));
+	if (Result != WAIT_OBJECT_0)  return 0;
+
+	/* Acquire the semaphore. */
+	Result = WaitForSingleObject(obj->MxWinRSemaphore, sync_GetWinWaitAmt(Deadline));
+	if (Result != WAIT_OBJECT_0)
+	{
+		ReleaseSemaphore(obj->MxWinRSemMutex, 1, NULL);
+
+		return 0;
+	}
+
+	/* Update the event state. */
+	if (!ResetEvent(obj->MxWinRWaitEvent))
+	{
+		ReleaseSemaphore(obj->MxWinRSemaphore, 1, NULL);
+		ReleaseSemaphore(obj->MxWinRSemMutex, 1, NULL);
+
+		return 0;
+	}
+
+	/* Release the semaphore mutex. */
+	ReleaseSemaphore(obj->MxWinRSemMutex, 1, NULL);
+
+	return 1;
+}
+/* }}} */
 
+/* {{{ Removes a reader. */
+int sync_ReaderWriter_RemoveWinReader(sync_ReaderWriter_object *obj)
+{
 	DWORD Result;
 	LONG Val;
 
-	if (obj->MxWinRSemMutex == NULL || obj->MxWinRSemaphore == NULL || obj->MxWinRWaitEvent == NULL)  return 0;
-
 	/* Acquire the semaphore mutex. */
 	Result = WaitForSingleObject(obj->MxWinRSemMutex, INFINITE);
 	if (Result != WAIT_OBJECT_0)  return 0;
 
-	if (obj->MxReadLocks)  obj->MxReadLocks--;
-
 	/* Release the semaphore. */
 	if (!ReleaseSemaphore(obj->MxWinRSemaphore, 1, &Val))
 	{
@@ -1562,37 +5745,60 @@ int sync_ReaderWriter_readunlock_internal(sync_ReaderWriter_object *obj)
 	/* Release the semaphore mutex. */
 	ReleaseSemaphore(obj->MxWinRSemMutex, 1, NULL);
 
+	return 1;
+}
+/* }}} */
+#endif
+
+/* {{{ Unlocks a read lock.  An upgradeable read lock is released after any other read locks. */
+int sync_ReaderWriter_readunlock_internal(sync_ReaderWriter_object *obj)
+{
+	int Upgradeable;
+
+	sync_ReaderWriter_forget_forked(obj);
+
+	Upgradeable = (obj->MxUpgradeLock && obj->MxReadLocks == 1);
+
+#if defined(PHP_WIN32)
+
+	if (obj->MxWinRSemMutex == NULL || obj->MxWinRSemaphore == NULL || obj->MxWinRWaitEvent == NULL)  return 0;
+
+	if (obj->MxReadLocks)  obj->MxReadLocks--;
+
+	if (!sync_ReaderWriter_RemoveWinReader(obj))  return 0;
+
+	/* Release the write lock mutex held by an upgradeable read lock. */
+	if (Upgradeable)  ReleaseSemaphore(obj->MxWinWWaitMutex, 1, NULL);
+
 #else
 
 	if (obj->MxMem == NULL)  return 0;
 
-	/* Acquire the counter mutex. */
-	if (!sync_WaitForUnixSemaphore(&obj->MxPthreadRCountMutex, INFINITE))  return 0;
+	/* Big-reader mode can't tell if anyone holds a read lock. */
+	if (obj->MxReaderSlots && !obj->MxReadLocks)  return 0;
 
 	if (obj->MxReadLocks)  obj->MxReadLocks--;
 
-	/* Decrease the number of readers. */
-	if (obj->MxRCount[0])  obj->MxRCount[0]--;
-	else
+	/* The hold time ends with the last lock held through this object. */
+	if (!obj->MxReadLocks && !obj->MxWriteLock)
 	{
-		sync_ReleaseUnixSemaphore(&obj->MxPthreadRCountMutex, NULL);
+		sync_AddUnixLockRelease(obj->MxStats, obj->MxHistograms, obj->MxNameHash, SYNC_PROBE_READLOCK, obj->MxHoldStart);
 
-		return 0;
+		obj->MxHoldStart = 0;
 	}
-
-	/* Update the event state. */
-	if (!obj->MxRCount[0] && !sync_FireUnixEvent(&obj->MxPthreadRWaitEvent))
+	else
 	{
-		sync_ReleaseUnixSemaphore(&obj->MxPthreadRCountMutex, NULL);
-
-		return 0;
+		sync_AddUnixLockRelease(obj->MxStats, obj->MxHistograms, obj->MxNameHash, SYNC_PROBE_READLOCK, 0);
 	}
 
-	/* Release the counter mutex. */
-	sync_ReleaseUnixSemaphore(&obj->MxPthreadRCountMutex, NULL);
+	/* Decrease the number of readers. */
+	if (Upgradeable)  sync_UpgradeUnlockUnixReaderWriter(&obj->MxPthreadReaderWriter);
+	else if (!sync_ReadUnlockUnixReaderWriter(&obj->MxPthreadReaderWriter))  return 0;
 
 #endif
 
+	if (Upgradeable)  obj->MxUpgradeLock = 0;
+
 	return 1;
 }
 /* }}} */
@@ -1600,6 +5806,8 @@ int sync_ReaderWriter_readunlock_internal(sync_ReaderWriter_object *obj)
 /* {{{ Unlocks a write lock. */
 int sync_ReaderWriter_writeunlock_internal(sync_ReaderWriter_object *obj)
 {
+	sync_ReaderWriter_forget_forked(obj);
+
 #if defined(PHP_WIN32)
 
 	if (obj->MxWinWWaitMutex == NULL)  return 0;
@@ -1615,8 +5823,20 @@ int sync_ReaderWriter_writeunlock_internal(sync_ReaderWriter_object *obj)
 
 	obj->MxWriteLock = 0;
 
+	/* The hold time ends with the last lock held through this object. */
+	if (!obj->MxReadLocks)
+	{
+		sync_AddUnixLockRelease(obj->MxStats, obj->MxHistograms, obj->MxNameHash, SYNC_PROBE_WRITELOCK, obj->MxHoldStart);
+
+		obj->MxHoldStart = 0;
+	}
+	else
+	{
+		sync_AddUnixLockRelease(obj->MxStats, obj->MxHistograms, obj->MxNameHash, SYNC_PROBE_WRITELOCK, 0);
+	}
+
 	/* Release the write lock. */
-	sync_ReleaseUnixSemaphore(&obj->MxPthreadWWaitMutex, NULL);
+	sync_WriteUnlockUnixReaderWriter(&obj->MxPthreadReaderWriter);
 
 #endif
 
@@ -1629,6 +5849,8 @@ PORTABLE_free_zend_object_func(sync_ReaderWriter_free_object)
 {
 	sync_ReaderWriter_object *obj = (sync_ReaderWriter_object *)PORTABLE_free_zend_object_get_object(object);
 
+	sync_ReaderWriter_forget_forked(obj);
+
 	if (obj->MxAutoUnlock)
 	{
 		while (obj->MxReadLocks)  sync_ReaderWriter_readunlock_internal(obj);
@@ -1644,29 +5866,32 @@ PORTABLE_free_zend_object_func(sync_ReaderWriter_free_object)
 #else
 	if (obj->MxMem != NULL)
 	{
-		if (obj->MxNamed)  sync_UnmapUnixNamedMem(obj->MxMem, sync_GetUnixSemaphoreSize() + sync_AlignUnixSize(sizeof(uint32_t)) + sync_GetUnixEventSize() + sync_GetUnixSemaphoreSize());
-		else
+		if (!sync_CloseUnixObjectMem(obj->MxMem, obj->MxMemType, sync_GetUnixReaderWriterSize()))
 		{
-			sync_FreeUnixSemaphore(&obj->MxPthreadRCountMutex);
-			sync_FreeUnixEvent(&obj->MxPthreadRWaitEvent);
-			sync_FreeUnixSemaphore(&obj->MxPthreadWWaitMutex);
+			sync_FreeUnixReaderWriter(&obj->MxPthreadReaderWriter);
 
 			efree(obj->MxMem);
 		}
 	}
+
+	if (obj->MxSlotsMem != NULL)  sync_CloseUnixSideMem(obj->MxSlotsMem, obj->MxMemType, sync_GetUnixReaderWriterSlotsSize(obj->MxReaderSlots));
+
+	if (obj->MxHistMem != NULL)  sync_FreeUnixHistograms(obj->MxHistMem, obj->MxMemType);
 #endif
 
 	PORTABLE_free_zend_object_free_object(obj);
 }
 /* }}} */
 
-/* {{{ proto void Sync_ReaderWriter::__construct([string $name = null, [bool $autounlock = true]])
-   Constructs a named or unnamed reader-writer object.  Don't set $autounlock to false unless you really know what you are doing. */
+/* {{{ proto void Sync_ReaderWriter::__construct([string $name = null, [bool $autounlock = true, [int $readerslots = 0, [bool $histograms = false]]]])
+   Constructs a named or unnamed reader-writer object.  Don't set $autounlock to false unless you really know what you are doing.  A positive $readerslots enables big-reader mode.  $histograms enables wait and hold time histograms. */
 PHP_METHOD(sync_ReaderWriter, __construct)
 {
 	char *name = NULL;
 	PORTABLE_ZPP_ARG_size name_len;
 	PORTABLE_ZPP_ARG_long autounlock = 1;
+	PORTABLE_ZPP_ARG_long readerslots = 0;
+	PORTABLE_ZPP_ARG_long histograms = 0;
 	sync_ReaderWriter_object *obj;
 #if defined(PHP_WIN32)
 	char *name2;
@@ -1675,7 +5900,7 @@ PHP_METHOD(sync_ReaderWriter, __construct)
 	size_t Pos, TempSize;
 #endif
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|s!l", &name, &name_len, &autounlock) == FAILURE)  return;
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|s!lll", &name, &name_len, &autounlock, &readerslots, &histograms) == FAILURE)  return;
 
 	obj = (sync_ReaderWriter_object *)PORTABLE_zend_object_store_get_object();
 
@@ -1713,9 +5938,13 @@ PHP_METHOD(sync_ReaderWriter, __construct)
 
 #else
 
-	TempSize = sync_GetUnixSemaphoreSize() + sync_AlignUnixSize(sizeof(uint32_t)) + sync_GetUnixEventSize() + sync_GetUnixSemaphoreSize();
-	obj->MxNamed = (name != NULL ? 1 : 0);
-	int Result = sync_InitUnixNamedMem(&obj->MxMem, &Pos, "/Sync_ReadWrite", name, TempSize);
+	/* Big-reader mode slots get their own segment and their number is recorded, so readers with a different count can't miss writers. */
+#ifdef SYNC_UNIX_FUTEX
+	if (readerslots > 0)  obj->MxReaderSlots = (readerslots > SYNC_UNIX_RW_MAX_SLOTS ? SYNC_UNIX_RW_MAX_SLOTS : (uint32_t)readerslots);
+#endif
+	TempSize = sync_GetUnixReaderWriterSize();
+	obj->MxNameHash = sync_GetUnixNameHash(name);
+	int Result = sync_OpenUnixObjectMem(&obj->MxMem, &Pos, &obj->MxMemType, "/Sync_ReadWrite", name, SYNC_G(shared_unnamed), TempSize);
 
 	if (Result < 0)
 	{
@@ -1724,204 +5953,342 @@ PHP_METHOD(sync_ReaderWriter, __construct)
 		return;
 	}
 
-	/* Load the pointers. */
-	char *MemPtr = obj->MxMem + Pos;
-	sync_GetUnixSemaphore(&obj->MxPthreadRCountMutex, MemPtr);
-	MemPtr += sync_GetUnixSemaphoreSize();
-
-	obj->MxRCount = (volatile uint32_t *)(MemPtr);
-	MemPtr += sync_AlignUnixSize(sizeof(uint32_t));
+	if (!sync_CheckUnixObjectOptions(obj->MxMem, obj->MxMemType, (Result == 0), obj->MxReaderSlots))
+	{
+		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Reader-Writer object already exists with different options", 0 TSRMLS_CC);
 
-	sync_GetUnixEvent(&obj->MxPthreadRWaitEvent, MemPtr);
-	MemPtr += sync_GetUnixEventSize();
+		return;
+	}
 
-	sync_GetUnixSemaphore(&obj->MxPthreadWWaitMutex, MemPtr);
+	/* Load the pointers. */
+	obj->MxStats = sync_GetUnixNamedMemStats(obj->MxMem, Pos);
+	sync_GetUnixReaderWriter(&obj->MxPthreadReaderWriter, obj->MxMem + Pos, sync_GetSpinLimit(TSRMLS_C));
 
 	/* Handle the first time this reader/writer lock has been opened. */
 	if (Result == 0)
 	{
-		sync_InitUnixSemaphore(&obj->MxPthreadRCountMutex, obj->MxNamed, 1, 1);
-		obj->MxRCount[0] = 0;
-		sync_InitUnixEvent(&obj->MxPthreadRWaitEvent, obj->MxNamed, 1, 1);
-		sync_InitUnixSemaphore(&obj->MxPthreadWWaitMutex, obj->MxNamed, 1, 1);
+		sync_InitUnixReaderWriter(&obj->MxPthreadReaderWriter, (obj->MxMemType != SYNC_UNIX_MEM_PRIVATE));
+
+		if (obj->MxMemType == SYNC_UNIX_MEM_NAMED)  sync_UnixNamedMemReady(obj->MxMem);
+	}
+
+	if (obj->MxReaderSlots)
+	{
+		char *SlotsMem = sync_OpenUnixSideMem(&obj->MxSlotsMem, "/Sync_ReadWriteSlots", name, SYNC_G(shared_unnamed), sync_GetUnixReaderWriterSlotsSize(obj->MxReaderSlots));
+		if (SlotsMem == NULL)
+		{
+			zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Reader-Writer object could not be created", 0 TSRMLS_CC);
+
+			return;
+		}
+
+		sync_SetUnixReaderWriterSlots(&obj->MxPthreadReaderWriter, SlotsMem, obj->MxReaderSlots);
+	}
+
+	if (histograms)
+	{
+		obj->MxHistograms = sync_InitUnixHistograms(&obj->MxHistMem, "/Sync_ReadWriteHist", name, SYNC_G(shared_unnamed));
+		if (obj->MxHistograms == NULL)
+		{
+			zend_throw_exception(zend_exception_get_default(TSRMLS_C), "Reader-Writer histograms could not be created", 0 TSRMLS_CC);
 
-		if (obj->MxNamed)  sync_UnixNamedMemReady(obj->MxMem);
+			return;
+		}
 	}
 
 #endif
 }
 /* }}} */
 
-/* {{{ proto bool Sync_ReaderWriter::readlock([int $wait = -1])
-   Read locks a reader-writer object. */
-PHP_METHOD(sync_ReaderWriter, readlock)
+/* {{{ Read locks a reader-writer object.  A single deadline covers every stage. */
+int sync_ReaderWriter_readlock_internal(sync_ReaderWriter_object *obj, uint64_t Deadline, int Upgradeable)
 {
-	PORTABLE_ZPP_ARG_long wait = -1;
-	sync_ReaderWriter_object *obj;
-	uint32_t WaitAmt;
-	uint64_t StartTime, CurrTime;
 #if defined(PHP_WIN32)
 	DWORD Result;
 #endif
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|l", &wait) == FAILURE)  return;
+	sync_ReaderWriter_forget_forked(obj);
 
-	obj = (sync_ReaderWriter_object *)PORTABLE_zend_object_store_get_object();
-
-	WaitAmt = (uint32_t)(wait > -1 ? wait : INFINITE);
-
-	/* Get current time in milliseconds. */
-	StartTime = (WaitAmt == INFINITE ? 0 : sync_GetUnixMicrosecondTime() / 1000000);
+	/* Only one upgradeable read lock can be held at a time. */
+	if (Upgradeable && obj->MxUpgradeLock)  return 0;
 
 #if defined(PHP_WIN32)
 
 	/* Acquire the write lock mutex.  Guarantees that readers can't starve the writer. */
-	Result = WaitForSingleObject(obj->MxWinWWaitMutex, WaitAmt);
-	if (Result != WAIT_OBJECT_0)  RETURN_FALSE;
+	Result = WaitForSingleObject(obj->MxWinWWaitMutex, sync_GetWinWaitAmt(Deadline));
+	if (Result != WAIT_OBJECT_0)  return 0;
 
-	/* Acquire the semaphore mutex. */
-	CurrTime = (WaitAmt == INFINITE ? 0 : sync_GetUnixMicrosecondTime() / 1000000);
-	if (WaitAmt < CurrTime - StartTime)
+	if (!sync_ReaderWriter_AddWinReader(obj, Deadline))
 	{
 		ReleaseSemaphore(obj->MxWinWWaitMutex, 1, NULL);
 
-		RETURN_FALSE;
+		return 0;
+	}
+
+	/* Release the write lock mutex.  Upgradeable read locks keep it to lock out writers. */
+	if (!Upgradeable)  ReleaseSemaphore(obj->MxWinWWaitMutex, 1, NULL);
+
+#else
+
+	/* Only time the wait when the first attempt fails. */
+	uint64_t WaitStart = 0;
+	int Result = (Upgradeable ? sync_UpgradeLockUnixReaderWriter(&obj->MxPthreadReaderWriter, SYNC_DEADLINE_NOWAIT) : sync_ReadLockUnixReaderWriter(&obj->MxPthreadReaderWriter, SYNC_DEADLINE_NOWAIT));
+	if (!Result && Deadline != SYNC_DEADLINE_NOWAIT)
+	{
+		WaitStart = sync_StartUnixLockWait(obj->MxNameHash, SYNC_PROBE_READLOCK);
+		Result = (Upgradeable ? sync_UpgradeLockUnixReaderWriter(&obj->MxPthreadReaderWriter, Deadline) : sync_ReadLockUnixReaderWriter(&obj->MxPthreadReaderWriter, Deadline));
 	}
-	Result = WaitForSingleObject(obj->MxWinRSemMutex, WaitAmt - (DWORD)(CurrTime - StartTime));
+
+	if (!sync_EndUnixLockWait(obj->MxStats, obj->MxHistograms, obj->MxNameHash, SYNC_PROBE_READLOCK, WaitStart, Result))  return 0;
+	obj->MxAbandoned = (Result == SYNC_UNIX_LOCK_ABANDONED);
+
+	/* The hold time runs from the first lock this object acquires. */
+	if (!obj->MxHoldStart)  obj->MxHoldStart = sync_GetUnixHoldStart(obj->MxHistograms);
+
+#endif
+
+	obj->MxReadLocks++;
+	if (Upgradeable)  obj->MxUpgradeLock = 1;
+
+	return 1;
+}
+/* }}} */
+
+/* {{{ Write locks a reader-writer object.  A single deadline covers every stage. */
+int sync_ReaderWriter_writelock_internal(sync_ReaderWriter_object *obj, uint64_t Deadline)
+{
+	sync_ReaderWriter_forget_forked(obj);
+
+#if defined(PHP_WIN32)
+
+	DWORD Result;
+
+	/* Acquire the write lock mutex. */
+	Result = WaitForSingleObject(obj->MxWinWWaitMutex, sync_GetWinWaitAmt(Deadline));
+	if (Result != WAIT_OBJECT_0)  return 0;
+
+	/* Wait for readers to reach zero. */
+	Result = WaitForSingleObject(obj->MxWinRWaitEvent, sync_GetWinWaitAmt(Deadline));
 	if (Result != WAIT_OBJECT_0)
 	{
 		ReleaseSemaphore(obj->MxWinWWaitMutex, 1, NULL);
 
-		RETURN_FALSE;
+		return 0;
 	}
 
-	/* Acquire the semaphore. */
-	CurrTime = (WaitAmt == INFINITE ? 0 : sync_GetUnixMicrosecondTime() / 1000000);
-	if (WaitAmt < CurrTime - StartTime)
-	{
-		ReleaseSemaphore(obj->MxWinRSemMutex, 1, NULL);
-		ReleaseSemaphore(obj->MxWinWWaitMutex, 1, NULL);
+#else
 
-		RETURN_FALSE;
+	/* Only time the wait when the first attempt fails. */
+	uint64_t WaitStart = 0;
+	int Result = sync_WriteLockUnixReaderWriter(&obj->MxPthreadReaderWriter, SYNC_DEADLINE_NOWAIT);
+	if (!Result && Deadline != SYNC_DEADLINE_NOWAIT)
+	{
+		WaitStart = sync_StartUnixLockWait(obj->MxNameHash, SYNC_PROBE_WRITELOCK);
+		Result = sync_WriteLockUnixReaderWriter(&obj->MxPthreadReaderWriter, Deadline);
 	}
-	Result = WaitForSingleObject(obj->MxWinRSemaphore, WaitAmt - (DWORD)(CurrTime - StartTime));
+
+	if (!sync_EndUnixLockWait(obj->MxStats, obj->MxHistograms, obj->MxNameHash, SYNC_PROBE_WRITELOCK, WaitStart, Result))  return 0;
+	obj->MxAbandoned = (Result == SYNC_UNIX_LOCK_ABANDONED);
+
+	if (!obj->MxHoldStart)  obj->MxHoldStart = sync_GetUnixHoldStart(obj->MxHistograms);
+
+#endif
+
+	obj->MxWriteLock = 1;
+
+	return 1;
+}
+/* }}} */
+
+/* {{{ Converts an upgradeable read lock into a write lock without letting another writer in. */
+int sync_ReaderWriter_upgrade_internal(sync_ReaderWriter_object *obj, uint64_t Deadline)
+{
+#if defined(PHP_WIN32)
+	DWORD Result;
+#endif
+
+	sync_ReaderWriter_forget_forked(obj);
+
+	/* Other read locks held by this object would never drain. */
+	if (!obj->MxUpgradeLock || obj->MxReadLocks != 1 || obj->MxWriteLock)  return 0;
+
+#if defined(PHP_WIN32)
+
+	if (!sync_ReaderWriter_RemoveWinReader(obj))  return 0;
+
+	/* Wait for readers to reach zero. */
+	Result = WaitForSingleObject(obj->MxWinRWaitEvent, sync_GetWinWaitAmt(Deadline));
 	if (Result != WAIT_OBJECT_0)
 	{
-		ReleaseSemaphore(obj->MxWinRSemMutex, 1, NULL);
-		ReleaseSemaphore(obj->MxWinWWaitMutex, 1, NULL);
+		/* Stay an upgradeable reader. */
+		sync_ReaderWriter_AddWinReader(obj, SYNC_DEADLINE_INFINITE);
 
-		RETURN_FALSE;
+		return 0;
 	}
 
-	/* Update the event state. */
-	if (!ResetEvent(obj->MxWinRWaitEvent))
-	{
-		ReleaseSemaphore(obj->MxWinRSemaphore, 1, NULL);
-		ReleaseSemaphore(obj->MxWinRSemMutex, 1, NULL);
-		ReleaseSemaphore(obj->MxWinWWaitMutex, 1, NULL);
+#else
 
-		RETURN_FALSE;
+	/* Only time the wait when the first attempt fails.  The hold time keeps running from the read lock. */
+	uint64_t WaitStart = 0;
+	int Result = sync_UpgradeUnixReaderWriter(&obj->MxPthreadReaderWriter, SYNC_DEADLINE_NOWAIT);
+	if (!Result && Deadline != SYNC_DEADLINE_NOWAIT)
+	{
+		WaitStart = sync_StartUnixLockWait(obj->MxNameHash, SYNC_PROBE_WRITELOCK);
+		Result = sync_UpgradeUnixReaderWriter(&obj->MxPthreadReaderWriter, Deadline);
 	}
 
-	obj->MxReadLocks++;
+	if (!sync_EndUnixLockWait(obj->MxStats, obj->MxHistograms, obj->MxNameHash, SYNC_PROBE_WRITELOCK, WaitStart, Result))  return 0;
+	obj->MxAbandoned = (Result == SYNC_UNIX_LOCK_ABANDONED);
+
+#endif
+
+	obj->MxReadLocks = 0;
+	obj->MxUpgradeLock = 0;
+	obj->MxWriteLock = 1;
+
+	return 1;
+}
+/* }}} */
+
+/* {{{ Converts a write lock into a read lock without releasing the lock. */
+int sync_ReaderWriter_downgrade_internal(sync_ReaderWriter_object *obj)
+{
+	sync_ReaderWriter_forget_forked(obj);
+
+	if (!obj->MxWriteLock)  return 0;
+
+#if defined(PHP_WIN32)
+
+	if (!sync_ReaderWriter_AddWinReader(obj, SYNC_DEADLINE_INFINITE))  return 0;
 
-	/* Release the mutexes. */
-	ReleaseSemaphore(obj->MxWinRSemMutex, 1, NULL);
 	ReleaseSemaphore(obj->MxWinWWaitMutex, 1, NULL);
 
 #else
 
-	/* Acquire the write lock mutex.  Guarantees that readers can't starve the writer. */
-	if (!sync_WaitForUnixSemaphore(&obj->MxPthreadWWaitMutex, WaitAmt))  RETURN_FALSE;
+	if (!sync_DowngradeUnixReaderWriter(&obj->MxPthreadReaderWriter))  return 0;
 
-	/* Acquire the counter mutex. */
-	CurrTime = (WaitAmt == INFINITE ? 0 : sync_GetUnixMicrosecondTime() / 1000000);
-	if (WaitAmt < CurrTime - StartTime || !sync_WaitForUnixSemaphore(&obj->MxPthreadRCountMutex, WaitAmt - (CurrTime - StartTime)))
-	{
-		sync_ReleaseUnixSemaphore(&obj->MxPthreadWWaitMutex, NULL);
+#endif
 
-		RETURN_FALSE;
-	}
+	obj->MxWriteLock = 0;
+	obj->MxReadLocks++;
 
-	/* Update the event state. */
-	if (!sync_ResetUnixEvent(&obj->MxPthreadRWaitEvent))
-	{
-		sync_ReleaseUnixSemaphore(&obj->MxPthreadRCountMutex, NULL);
-		sync_ReleaseUnixSemaphore(&obj->MxPthreadWWaitMutex, NULL);
+	return 1;
+}
+/* }}} */
 
-		RETURN_FALSE;
-	}
+/* {{{ proto bool Sync_ReaderWriter::readlock([float $wait = -1, [bool $upgradeable = false]])
+   Read locks a reader-writer object.  An upgradeable read lock can later be upgraded to a write lock. */
+PHP_METHOD(sync_ReaderWriter, readlock)
+{
+	double wait = -1;
+	PORTABLE_ZPP_ARG_long upgradeable = 0;
+	sync_ReaderWriter_object *obj;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|dl", &wait, &upgradeable) == FAILURE)  return;
+
+	obj = (sync_ReaderWriter_object *)PORTABLE_zend_object_store_get_object();
+
+	if (!sync_ReaderWriter_readlock_internal(obj, sync_GetWaitDeadline(wait), (upgradeable ? 1 : 0)))  RETURN_FALSE;
+
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool Sync_ReaderWriter::readlockUntil(int $deadline, [bool $upgradeable = false])
+   Read locks a reader-writer object before an absolute hrtime() deadline in nanoseconds. */
+PHP_METHOD(sync_ReaderWriter, readlockUntil)
+{
+	double deadline;
+	PORTABLE_ZPP_ARG_long upgradeable = 0;
+	sync_ReaderWriter_object *obj;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "d|l", &deadline, &upgradeable) == FAILURE)  return;
+
+	obj = (sync_ReaderWriter_object *)PORTABLE_zend_object_store_get_object();
+
+	if (!sync_ReaderWriter_readlock_internal(obj, sync_GetUntilDeadline(deadline), (upgradeable ? 1 : 0)))  RETURN_FALSE;
+
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool Sync_ReaderWriter::writelock([float $wait = -1])
+   Write locks a reader-writer object. */
+PHP_METHOD(sync_ReaderWriter, writelock)
+{
+	double wait = -1;
+	sync_ReaderWriter_object *obj;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|d", &wait) == FAILURE)  return;
+
+	obj = (sync_ReaderWriter_object *)PORTABLE_zend_object_store_get_object();
+
+	if (!sync_ReaderWriter_writelock_internal(obj, sync_GetWaitDeadline(wait)))  RETURN_FALSE;
+
+	RETURN_TRUE;
+}
+/* }}} */
 
-	/* Increment the number of readers. */
-	obj->MxRCount[0]++;
+/* {{{ proto bool Sync_ReaderWriter::writelockUntil(int $deadline)
+   Write locks a reader-writer object before an absolute hrtime() deadline in nanoseconds. */
+PHP_METHOD(sync_ReaderWriter, writelockUntil)
+{
+	double deadline;
+	sync_ReaderWriter_object *obj;
 
-	obj->MxReadLocks++;
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "d", &deadline) == FAILURE)  return;
 
-	/* Release the mutexes. */
-	sync_ReleaseUnixSemaphore(&obj->MxPthreadRCountMutex, NULL);
-	sync_ReleaseUnixSemaphore(&obj->MxPthreadWWaitMutex, NULL);
+	obj = (sync_ReaderWriter_object *)PORTABLE_zend_object_store_get_object();
 
-#endif
+	if (!sync_ReaderWriter_writelock_internal(obj, sync_GetUntilDeadline(deadline)))  RETURN_FALSE;
 
 	RETURN_TRUE;
 }
 /* }}} */
 
-/* {{{ proto bool Sync_ReaderWriter::writelock([int $wait = -1])
-   Write locks a reader-writer object. */
-PHP_METHOD(sync_ReaderWriter, writelock)
+/* {{{ proto bool Sync_ReaderWriter::upgrade([float $wait = -1])
+   Upgrades an upgradeable read lock to a write lock.  No other writer can get in between. */
+PHP_METHOD(sync_ReaderWriter, upgrade)
 {
-	PORTABLE_ZPP_ARG_long wait = -1;
+	double wait = -1;
 	sync_ReaderWriter_object *obj;
-	uint32_t WaitAmt;
-	uint64_t StartTime, CurrTime;
-#if defined(PHP_WIN32)
-	DWORD Result;
-#else
-#endif
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|l", &wait) == FAILURE)  return;
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|d", &wait) == FAILURE)  return;
 
 	obj = (sync_ReaderWriter_object *)PORTABLE_zend_object_store_get_object();
 
-	WaitAmt = (uint32_t)(wait > -1 ? wait : INFINITE);
-
-	/* Get current time in milliseconds. */
-	StartTime = (WaitAmt == INFINITE ? 0 : sync_GetUnixMicrosecondTime() / 1000000);
-
-#if defined(PHP_WIN32)
+	if (!sync_ReaderWriter_upgrade_internal(obj, sync_GetWaitDeadline(wait)))  RETURN_FALSE;
 
-	/* Acquire the write lock mutex. */
-	Result = WaitForSingleObject(obj->MxWinWWaitMutex, WaitAmt);
-	if (Result != WAIT_OBJECT_0)  RETURN_FALSE;
+	RETURN_TRUE;
+}
+/* }}} */
 
-	/* Wait for readers to reach zero. */
-	CurrTime = (WaitAmt == INFINITE ? 0 : sync_GetUnixMicrosecondTime() / 1000000);
-	Result = WaitForSingleObject(obj->MxWinRWaitEvent, WaitAmt - (DWORD)(CurrTime - StartTime));
-	if (Result != WAIT_OBJECT_0)
-	{
-		ReleaseSemaphore(obj->MxWinWWaitMutex, 1, NULL);
+/* {{{ proto bool Sync_ReaderWriter::upgradeUntil(int $deadline)
+   Upgrades an upgradeable read lock to a write lock before an absolute hrtime() deadline in nanoseconds. */
+PHP_METHOD(sync_ReaderWriter, upgradeUntil)
+{
+	double deadline;
+	sync_ReaderWriter_object *obj;
 
-		RETURN_FALSE;
-	}
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "d", &deadline) == FAILURE)  return;
 
-#else
+	obj = (sync_ReaderWriter_object *)PORTABLE_zend_object_store_get_object();
 
-	/* Acquire the write lock mutex. */
-	if (!sync_WaitForUnixSemaphore(&obj->MxPthreadWWaitMutex, WaitAmt))  RETURN_FALSE;
+	if (!sync_ReaderWriter_upgrade_internal(obj, sync_GetUntilDeadline(deadline)))  RETURN_FALSE;
 
-	/* Wait for readers to reach zero. */
-	CurrTime = (WaitAmt == INFINITE ? 0 : sync_GetUnixMicrosecondTime() / 1000000);
-	if (WaitAmt < CurrTime - StartTime || !sync_WaitForUnixEvent(&obj->MxPthreadRWaitEvent, WaitAmt - (CurrTime - StartTime)))
-	{
-		sync_ReleaseUnixSemaphore(&obj->MxPthreadWWaitMutex, NULL);
+	RETURN_TRUE;
+}
+/* }}} */
 
-		RETURN_FALSE;
-	}
+/* {{{ proto bool Sync_ReaderWriter::downgrade()
+   Downgrades a write lock to a read lock without releasing the lock. */
+PHP_METHOD(sync_ReaderWriter, downgrade)
+{
+	sync_ReaderWriter_object *obj;
 
-#endif
+	obj = (sync_ReaderWriter_object *)PORTABLE_zend_object_store_get_object();
 
-	obj->MxWriteLock = 1;
+	if (!sync_ReaderWriter_downgrade_internal(obj))  RETURN_FALSE;
 
 	RETURN_TRUE;
 }
@@ -1955,32 +6322,128 @@ PHP_METHOD(sync_ReaderWriter, writeunlock)
 }
 /* }}} */
 
+/* {{{ proto bool Sync_ReaderWriter::abandoned()
+   Returns whether the last lock took the writer gate over from a process that died while holding it.  Always false on Windows. */
+PHP_METHOD(sync_ReaderWriter, abandoned)
+{
+	sync_ReaderWriter_object *obj;
+
+	obj = (sync_ReaderWriter_object *)PORTABLE_zend_object_store_get_object();
+
+	RETURN_BOOL(obj->MxAbandoned);
+}
+/* }}} */
+
+/* {{{ proto array Sync_ReaderWriter::getStats()
+   Returns contention statistics for the reader-writer object.  Named objects aggregate across all processes. */
+PHP_METHOD(sync_ReaderWriter, getStats)
+{
+	sync_ReaderWriter_object *obj;
+
+	obj = (sync_ReaderWriter_object *)PORTABLE_zend_object_store_get_object();
+
+#if defined(PHP_WIN32)
+
+	RETURN_FALSE;
+
+#else
+
+	if (obj->MxStats == NULL)  RETURN_FALSE;
+
+	sync_GetUnixStatsArray(obj->MxStats, return_value);
+
+#endif
+}
+/* }}} */
+
+/* {{{ proto array Sync_ReaderWriter::getPercentiles()
+   Returns wait and hold time percentiles for the reader-writer object.  Requires $histograms at construction. */
+PHP_METHOD(sync_ReaderWriter, getPercentiles)
+{
+	sync_ReaderWriter_object *obj;
+
+	obj = (sync_ReaderWriter_object *)PORTABLE_zend_object_store_get_object();
+
+#if defined(PHP_WIN32)
+
+	RETURN_FALSE;
+
+#else
+
+	if (obj->MxHistograms == NULL)  RETURN_FALSE;
+
+	sync_GetUnixHistogramsArray(obj->MxHistograms, return_value);
+
+#endif
+}
+/* }}} */
+
 
 ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_readerwriter___construct, 0, 0, 0)
 	ZEND_ARG_INFO(0, name)
 	ZEND_ARG_INFO(0, autounlock)
+	ZEND_ARG_INFO(0, readerslots)
+	ZEND_ARG_INFO(0, histograms)
 ZEND_END_ARG_INFO()
 
 ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_readerwriter_readlock, 0, 0, 0)
 	ZEND_ARG_INFO(0, wait)
+	ZEND_ARG_INFO(0, upgradeable)
 ZEND_END_ARG_INFO()
 
 ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_readerwriter_writelock, 0, 0, 0)
 	ZEND_ARG_INFO(0, wait)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_readerwriter_readlockuntil, 0, 0, 1)
+	ZEND_ARG_INFO(0, deadline)
+	ZEND_ARG_INFO(0, upgradeable)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_readerwriter_writelockuntil, 0, 0, 1)
+	ZEND_ARG_INFO(0, deadline)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_readerwriter_upgrade, 0, 0, 0)
+	ZEND_ARG_INFO(0, wait)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_readerwriter_upgradeuntil, 0, 0, 1)
+	ZEND_ARG_INFO(0, deadline)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_readerwriter_downgrade, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
 ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_readerwriter_readunlock, 0, 0, 0)
 ZEND_END_ARG_INFO()
 
 ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_readerwriter_writeunlock, 0, 0, 0)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_readerwriter_abandoned, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_readerwriter_getstats, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_readerwriter_getpercentiles, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
 static const zend_function_entry sync_ReaderWriter_methods[] = {
 	PHP_ME(sync_ReaderWriter, __construct, arginfo_sync_readerwriter___construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
 	PHP_ME(sync_ReaderWriter, readlock, arginfo_sync_readerwriter_readlock, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_ReaderWriter, readlockUntil, arginfo_sync_readerwriter_readlockuntil, ZEND_ACC_PUBLIC)
 	PHP_ME(sync_ReaderWriter, writelock, arginfo_sync_readerwriter_writelock, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_ReaderWriter, writelockUntil, arginfo_sync_readerwriter_writelockuntil, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_ReaderWriter, upgrade, arginfo_sync_readerwriter_upgrade, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_ReaderWriter, upgradeUntil, arginfo_sync_readerwriter_upgradeuntil, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_ReaderWriter, downgrade, arginfo_sync_readerwriter_downgrade, ZEND_ACC_PUBLIC)
 	PHP_ME(sync_ReaderWriter, readunlock, arginfo_sync_readerwriter_readunlock, ZEND_ACC_PUBLIC)
 	PHP_ME(sync_ReaderWriter, writeunlock, arginfo_sync_readerwriter_writeunlock, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_ReaderWriter, abandoned, arginfo_sync_readerwriter_abandoned, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_ReaderWriter, getStats, arginfo_sync_readerwriter_getstats, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_ReaderWriter, getPercentiles, arginfo_sync_readerwriter_getpercentiles, ZEND_ACC_PUBLIC)
 	PHP_FE_END
 };
 
@@ -1992,6 +6455,173 @@ static zend_object_handlers sync_SharedMemory_object_handlers;
 
 PORTABLE_free_zend_object_func(sync_SharedMemory_free_object);
 
+/* Sequence lock.  Writers make the sequence odd while copying data and even again afterwards. */
+/* Readers copy optimistically and retry if the sequence was odd or changed, so they never write to shared memory. */
+#define SYNC_SEQLOCK_HEADER_SIZE   64
+
+#if defined(PHP_WIN32)
+
+void sync_BeginSeqLockWrite(volatile uint32_t *Seq)
+{
+	LONG Val;
+
+	for (;;)
+	{
+		Val = (LONG)Seq[0];
+		if (!(Val & 1) && InterlockedCompareExchange((volatile LONG *)Seq, Val + 1, Val) == Val)  break;
+
+		SwitchToThread();
+	}
+
+	MemoryBarrier();
+}
+
+void sync_EndSeqLockWrite(volatile uint32_t *Seq)
+{
+	InterlockedIncrement((volatile LONG *)Seq);
+}
+
+uint32_t sync_BeginSeqLockRead(volatile uint32_t *Seq)
+{
+	uint32_t Val;
+
+	while ((Val = Seq[0]) & 1)  SwitchToThread();
+
+	MemoryBarrier();
+
+	return Val;
+}
+
+int sync_RetrySeqLockRead(volatile uint32_t *Seq, uint32_t Val)
+{
+	MemoryBarrier();
+
+	return (Seq[0] != Val);
+}
+
+/* Writes aren't ended on behalf of a writer that died on Windows. */
+uint32_t sync_GetSeqLockRecoveries(volatile uint32_t *Seq)
+{
+	return 0;
+}
+
+#else
+
+/* The sequence is the low half of a 64-bit word.  The writer's process ID is in the high half while the sequence is odd. */
+/* Since both change together, whoever finds a writer that died can end its write without racing a live writer.  The data it was writing may be partly written. */
+/* The second word holds the rest of the writer's identity, its start time, next to the odd sequence it was stored for, so a stale value from an earlier write is never used. */
+/* The third word counts the writes that were ended this way. */
+#define SYNC_SEQLOCK_WRITER_MASK   0xFFFFFFFF00000000ULL
+
+static int sync_RecoverUnixSeqLock(volatile uint64_t *Seq, uint64_t Val)
+{
+	uint64_t Owner, Writer = __atomic_load_n(Seq + 1, __ATOMIC_ACQUIRE);
+
+	/* A writer that died before storing its start time can only be checked by process ID. */
+	Owner = Val & SYNC_SEQLOCK_WRITER_MASK;
+	if ((uint32_t)Writer == (uint32_t)Val)  Owner |= Writer >> 32;
+
+	if (sync_IsUnixOwnerAlive(Owner))  return 0;
+
+	/* Counted first, so anyone who sees the ended write also sees the count. */
+	__atomic_fetch_add(Seq + 2, 1, __ATOMIC_RELEASE);
+
+	return __atomic_compare_exchange_n(Seq, &Val, (uint64_t)(uint32_t)((uint32_t)Val + 1), 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+/* Waits for an even sequence.  Writers are rare and brief, so this spins briefly, yields for a while, then backs off up to 2 ms and checks on the writer now and then. */
+static uint64_t sync_WaitForUnixSeqLock(volatile uint64_t *Seq)
+{
+	uint64_t Val, LastCheck = 0, CurrTime;
+	uint32_t x = 0, Delay = 50;
+
+	while ((Val = __atomic_load_n(Seq, __ATOMIC_ACQUIRE)) & 1)
+	{
+		if (++x < 100)
+		{
+			sync_UnixCpuRelax();
+
+			continue;
+		}
+
+		if (x < 1000)  sched_yield();
+		else
+		{
+			usleep(Delay);
+
+			if (Delay < 2000)  Delay *= 2;
+		}
+
+		if (x < 1000 && x % 64)  continue;
+
+		CurrTime = sync_GetMonotonicTime();
+		if (!LastCheck)  LastCheck = CurrTime;
+		else if (CurrTime - LastCheck >= SYNC_UNIX_OWNER_CHECK_INTERVAL)
+		{
+			sync_RecoverUnixSeqLock(Seq, Val);
+
+			LastCheck = CurrTime;
+		}
+	}
+
+	return Val;
+}
+
+void sync_BeginSeqLockWrite(volatile uint64_t *Seq)
+{
+	uint64_t Val, Owner = sync_GetUnixProcessOwner();
+	uint32_t NextSeq;
+
+	for (;;)
+	{
+		Val = sync_WaitForUnixSeqLock(Seq);
+		NextSeq = (uint32_t)Val + 1;
+		if (__atomic_compare_exchange_n(Seq, &Val, (Owner & SYNC_SEQLOCK_WRITER_MASK) | (uint64_t)NextSeq, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))  break;
+	}
+
+	__atomic_store_n(Seq + 1, (Owner << 32) | (uint64_t)NextSeq, __ATOMIC_RELAXED);
+
+	/* The odd sequence has to be visible before any of the data changes. */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void sync_EndSeqLockWrite(volatile uint64_t *Seq)
+{
+	uint64_t Val = __atomic_load_n(Seq, __ATOMIC_RELAXED);
+
+	__atomic_store_n(Seq, (uint64_t)(uint32_t)((uint32_t)Val + 1), __ATOMIC_RELEASE);
+}
+
+uint32_t sync_BeginSeqLockRead(volatile uint64_t *Seq)
+{
+	return (uint32_t)sync_WaitForUnixSeqLock(Seq);
+}
+
+int sync_RetrySeqLockRead(volatile uint64_t *Seq, uint32_t Val)
+{
+	/* The data reads have to finish before the sequence is checked again. */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return ((uint32_t)__atomic_load_n(Seq, __ATOMIC_RELAXED) != Val);
+}
+
+/* Returns the number of writes ended after their writer died. */
+uint32_t sync_GetSeqLockRecoveries(volatile uint64_t *Seq)
+{
+	return (uint32_t)__atomic_load_n(Seq + 2, __ATOMIC_ACQUIRE);
+}
+
+#endif
+
+/* Notes whether a write was ended for a writer that died since the last read() or write(). */
+static void sync_SharedMemory_CheckAbandoned(sync_SharedMemory_object *obj)
+{
+	uint32_t Recoveries = sync_GetSeqLockRecoveries(obj->MxSeq);
+
+	obj->MxAbandoned = (Recoveries != obj->MxRecoveries);
+	obj->MxRecoveries = Recoveries;
+}
+
 /* {{{ Initialize internal Shared Memory structure. */
 PORTABLE_new_zend_object_func(sync_SharedMemory_create_object)
 {
@@ -2007,12 +6637,16 @@ PORTABLE_new_zend_object_func(sync_SharedMemory_create_object)
 #if defined(PHP_WIN32)
 	obj->MxFile = NULL;
 #else
+	obj->MxMemType = SYNC_UNIX_MEM_PRIVATE;
 	obj->MxMemInternal = NULL;
 #endif
 
 	obj->MxFirst = 0;
 	obj->MxSize = 0;
 	obj->MxMem = NULL;
+	obj->MxSeq = NULL;
+	obj->MxRecoveries = 0;
+	obj->MxAbandoned = 0;
 
 	PORTABLE_new_zend_object_return(&obj->std);
 }
@@ -2024,24 +6658,32 @@ PORTABLE_free_zend_object_func(sync_SharedMemory_free_object)
 	sync_SharedMemory_object *obj = (sync_SharedMemory_object *)PORTABLE_free_zend_object_get_object(object);
 
 #if defined(PHP_WIN32)
-	if (obj->MxMem != NULL)  UnmapViewOfFile(obj->MxMem);
+	if (obj->MxSeq != NULL)  UnmapViewOfFile((LPCVOID)obj->MxSeq);
+	else if (obj->MxMem != NULL)  UnmapViewOfFile(obj->MxMem);
 	if (obj->MxFile != NULL)  CloseHandle(obj->MxFile);
 #else
-	if (obj->MxMemInternal != NULL)  sync_UnmapUnixNamedMem(obj->MxMemInternal, obj->MxSize);
+	if (obj->MxMemInternal != NULL)
+	{
+		if (obj->MxMemType == SYNC_UNIX_MEM_SHARED)  sync_FreeUnixSharedMem(obj->MxMemInternal, obj->MxSize + (obj->MxSeq != NULL ? SYNC_SEQLOCK_HEADER_SIZE : 0));
+		else  sync_UnmapUnixNamedMem(obj->MxMemInternal, obj->MxSize + (obj->MxSeq != NULL ? SYNC_SEQLOCK_HEADER_SIZE : 0));
+	}
 #endif
 
 	PORTABLE_free_zend_object_free_object(obj);
 }
 /* }}} */
 
-/* {{{ proto void Sync_SharedMemory::__construct(string $name, int $size)
-   Constructs a named shared memory object. */
+/* {{{ proto void Sync_SharedMemory::__construct(string $name, int $size, [bool $seqlock = false])
+   Constructs a named or unnamed shared memory object.  In sequence lock mode, read() and write() are consistent without a separate lock.
+   Unnamed shared memory is only shared with processes forked after it was created. */
 PHP_METHOD(sync_SharedMemory, __construct)
 {
 	char *name;
 	PORTABLE_ZPP_ARG_size name_len;
 	PORTABLE_ZPP_ARG_long size;
+	PORTABLE_ZPP_ARG_long seqlock = 0;
 	sync_SharedMemory_object *obj;
+	size_t HeaderSize;
 #if defined(PHP_WIN32)
 	char *name2;
 	SECURITY_ATTRIBUTES SecAttr;
@@ -2049,31 +6691,33 @@ PHP_METHOD(sync_SharedMemory, __construct)
 	size_t Pos, TempSize;
 #endif
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sl", &name, &name_len, &size) == FAILURE)  return;
-
-	if (name_len < 1)
-	{
-		zend_throw_exception(zend_exception_get_default(TSRMLS_C), "An invalid name was passed", 0 TSRMLS_CC);
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "s!l|l", &name, &name_len, &size, &seqlock) == FAILURE)  return;
 
-		return;
-	}
+	if (name_len < 1)  name = NULL;
 
 	obj = (sync_SharedMemory_object *)PORTABLE_zend_object_store_get_object();
 
+	HeaderSize = (seqlock ? SYNC_SEQLOCK_HEADER_SIZE : 0);
+
 #if defined(PHP_WIN32)
 
-	name2 = emalloc(name_len + 30);
+	if (name == NULL)  name2 = NULL;
+	else
+	{
+		name2 = emalloc(name_len + 30);
+
+		sprintf(name2, (seqlock ? "%s-%u-Sync_SeqMem" : "%s-%u-Sync_SharedMem"), name, (unsigned int)size);
+	}
 
 	SecAttr.nLength = sizeof(SecAttr);
 	SecAttr.lpSecurityDescriptor = NULL;
 	SecAttr.bInheritHandle = TRUE;
 
-	/* Create the file mapping object backed by the system page file. */
-	sprintf(name2, "%s-%u-Sync_SharedMem", name, (unsigned int)size);
-	obj->MxFile = CreateFileMappingA(INVALID_HANDLE_VALUE, &SecAttr, PAGE_READWRITE, 0, (DWORD)size, name2);
+	/* Create the file mapping object backed by the system page file.  Unnamed mappings are always new. */
+	obj->MxFile = CreateFileMappingA(INVALID_HANDLE_VALUE, &SecAttr, PAGE_READWRITE, 0, (DWORD)(HeaderSize + size), name2);
 	if (obj->MxFile == NULL)
 	{
-		obj->MxFile = OpenFileMappingA(FILE_MAP_ALL_ACCESS, TRUE, name2);
+		if (name2 != NULL)  obj->MxFile = OpenFileMappingA(FILE_MAP_ALL_ACCESS, TRUE, name2);
 
 		if (obj->MxFile == NULL)
 		{
@@ -2087,9 +6731,9 @@ PHP_METHOD(sync_SharedMemory, __construct)
 		obj->MxFirst = 1;
 	}
 
-	efree(name2);
+	if (name2 != NULL)  efree(name2);
 
-	obj->MxMem = (char *)MapViewOfFile(obj->MxFile, FILE_MAP_ALL_ACCESS, 0, 0, (DWORD)size);
+	obj->MxMem = (char *)MapViewOfFile(obj->MxFile, FILE_MAP_ALL_ACCESS, 0, 0, (DWORD)(HeaderSize + size));
 
 	if (obj->MxMem == NULL)
 	{
@@ -2098,12 +6742,31 @@ PHP_METHOD(sync_SharedMemory, __construct)
 		return;
 	}
 
+	if (seqlock)
+	{
+		obj->MxSeq = (volatile uint32_t *)obj->MxMem;
+		obj->MxMem += HeaderSize;
+		obj->MxRecoveries = sync_GetSeqLockRecoveries(obj->MxSeq);
+	}
+
 	obj->MxSize = (size_t)size;
 
 #else
 
-	TempSize = (size_t)size;
-	int Result = sync_InitUnixNamedMem(&obj->MxMemInternal, &Pos, "/Sync_SharedMem", name, TempSize);
+	TempSize = HeaderSize + (size_t)size;
+	int Result;
+
+	/* Unnamed shared memory has to be shared, even without sync.shared_unnamed, since private memory couldn't be. */
+	if (name == NULL)
+	{
+		obj->MxMemType = SYNC_UNIX_MEM_SHARED;
+		Result = sync_InitUnixSharedMem(&obj->MxMemInternal, &Pos, TempSize);
+	}
+	else
+	{
+		obj->MxMemType = SYNC_UNIX_MEM_NAMED;
+		Result = sync_InitUnixNamedMem(&obj->MxMemInternal, &Pos, (seqlock ? "/Sync_SeqMem" : "/Sync_SharedMem"), name, TempSize);
+	}
 
 	if (Result < 0)
 	{
@@ -2112,14 +6775,19 @@ PHP_METHOD(sync_SharedMemory, __construct)
 		return;
 	}
 
-	/* Load the pointers. */
-	obj->MxMem = obj->MxMemInternal + Pos;
+	/* Load the pointers.  New segments are zeroed, so the sequence starts out even. */
+	if (seqlock)
+	{
+		obj->MxSeq = (volatile uint64_t *)(obj->MxMemInternal + Pos);
+		obj->MxRecoveries = sync_GetSeqLockRecoveries(obj->MxSeq);
+	}
+	obj->MxMem = obj->MxMemInternal + Pos + HeaderSize;
 	obj->MxSize = (size_t)size;
 
 	/* Handle the first time this named memory has been opened. */
 	if (Result == 0)
 	{
-		sync_UnixNamedMemReady(obj->MxMemInternal);
+		if (obj->MxMemType == SYNC_UNIX_MEM_NAMED)  sync_UnixNamedMemReady(obj->MxMemInternal);
 
 		obj->MxFirst = 1;
 	}
@@ -2172,8 +6840,17 @@ PHP_METHOD(sync_SharedMemory, write)
 
 	if (start + str_len > maxval)  str_len = maxval - start;
 
+	if (obj->MxSeq != NULL)  sync_BeginSeqLockWrite(obj->MxSeq);
+
 	memcpy(obj->MxMem + (size_t)start, str, str_len);
 
+	if (obj->MxSeq != NULL)
+	{
+		sync_EndSeqLockWrite(obj->MxSeq);
+
+		sync_SharedMemory_CheckAbandoned(obj);
+	}
+
 	RETURN_LONG((PORTABLE_ZPP_ARG_long)str_len);
 }
 /* }}} */
@@ -2200,14 +6877,47 @@ PHP_METHOD(sync_SharedMemory, read)
 	if (length < 0)  length = 0;
 	if (start + length > maxval)  length = maxval - start;
 
+	if (obj->MxSeq != NULL)
+	{
+		char *Buffer = (char *)emalloc(length + 1);
+		uint32_t Seq;
+
+		/* Copy until no writer was active during the copy. */
+		do
+		{
+			Seq = sync_BeginSeqLockRead(obj->MxSeq);
+			memcpy(Buffer, obj->MxMem + start, length);
+		} while (sync_RetrySeqLockRead(obj->MxSeq, Seq));
+
+		sync_SharedMemory_CheckAbandoned(obj);
+
+		PORTABLE_RETVAL_STRINGL(Buffer, length);
+		efree(Buffer);
+
+		return;
+	}
+
 	PORTABLE_RETURN_STRINGL(obj->MxMem + start, length);
 }
 /* }}} */
 
+/* {{{ proto bool Sync_SharedMemory::abandoned()
+   Returns whether or not the last read() or write() came after a write that was ended for a writer that died, so the data may be partly written. */
+PHP_METHOD(sync_SharedMemory, abandoned)
+{
+	sync_SharedMemory_object *obj;
+
+	obj = (sync_SharedMemory_object *)PORTABLE_zend_object_store_get_object();
+
+	RETURN_BOOL(obj->MxAbandoned);
+}
+/* }}} */
+
 
 ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_sharedmemory___construct, 0, 0, 2)
 	ZEND_ARG_INFO(0, name)
 	ZEND_ARG_INFO(0, size)
+	ZEND_ARG_INFO(0, seqlock)
 ZEND_END_ARG_INFO()
 
 ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_sharedmemory_first, 0, 0, 0)
@@ -2226,22 +6936,48 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_sharedmemory_read, 0, 0, 0)
 	ZEND_ARG_INFO(0, length)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_INFO_EX(arginfo_sync_sharedmemory_abandoned, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
 static const zend_function_entry sync_SharedMemory_methods[] = {
 	PHP_ME(sync_SharedMemory, __construct, arginfo_sync_sharedmemory___construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
 	PHP_ME(sync_SharedMemory, first, arginfo_sync_sharedmemory_first, ZEND_ACC_PUBLIC)
 	PHP_ME(sync_SharedMemory, size, arginfo_sync_sharedmemory_size, ZEND_ACC_PUBLIC)
 	PHP_ME(sync_SharedMemory, write, arginfo_sync_sharedmemory_write, ZEND_ACC_PUBLIC)
 	PHP_ME(sync_SharedMemory, read, arginfo_sync_sharedmemory_read, ZEND_ACC_PUBLIC)
+	PHP_ME(sync_SharedMemory, abandoned, arginfo_sync_sharedmemory_abandoned, ZEND_ACC_PUBLIC)
 	PHP_FE_END
 };
 
 
 /* {{{ PHP_MINIT_FUNCTION(sync)
  */
+static void php_sync_init_globals(zend_sync_globals *sync_globals)
+{
+	sync_globals->spin_limit = 100;
+	sync_globals->cache_size = 0;
+	sync_globals->cache_ttl = 0;
+	sync_globals->shared_unnamed = 0;
+}
+
 PHP_MINIT_FUNCTION(sync)
 {
 	zend_class_entry ce;
 
+	ZEND_INIT_MODULE_GLOBALS(sync, php_sync_init_globals, NULL);
+	REGISTER_INI_ENTRIES();
+
+#if !defined(PHP_WIN32) && defined(_SC_NPROCESSORS_ONLN)
+	sync_MultiCPU = (sysconf(_SC_NPROCESSORS_ONLN) > 1);
+#endif
+
+#if !defined(PHP_WIN32)
+	/* The named memory cache is process-wide, so its settings are only read at startup. */
+	sync_InitUnixNamedMemCache((SYNC_G(cache_size) > 0 ? (uint32_t)(SYNC_G(cache_size) < 65536 ? SYNC_G(cache_size) : 65536) : 0), (SYNC_G(cache_ttl) > 0 ? (uint64_t)SYNC_G(cache_ttl) * 1000000000 : 0));
+
+	sync_InitUnixForkGeneration();
+#endif
+
 	/* Mutex */
 	memcpy(&sync_Mutex_object_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
 	sync_Mutex_object_handlers.clone_obj = NULL;
@@ -2255,6 +6991,19 @@ PHP_MINIT_FUNCTION(sync)
 	sync_Mutex_ce = zend_register_internal_class(&ce TSRMLS_CC);
 
 
+	/* Striped Mutex */
+	memcpy(&sync_StripedMutex_object_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+	sync_StripedMutex_object_handlers.clone_obj = NULL;
+#if PHP_MAJOR_VERSION >= 7
+	sync_StripedMutex_object_handlers.offset = XtOffsetOf(sync_StripedMutex_object, PORTABLE_default_zend_object_name);
+	sync_StripedMutex_object_handlers.free_obj = sync_StripedMutex_free_object;
+#endif
+
+	INIT_CLASS_ENTRY(ce, "SyncStripedMutex", sync_StripedMutex_methods);
+	ce.create_object = sync_StripedMutex_create_object;
+	sync_StripedMutex_ce = zend_register_internal_class(&ce TSRMLS_CC);
+
+
 	/* Semaphore */
 	memcpy(&sync_Semaphore_object_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
 	sync_Semaphore_object_handlers.clone_obj = NULL;
@@ -2314,6 +7063,13 @@ PHP_MINIT_FUNCTION(sync)
  */
 PHP_MSHUTDOWN_FUNCTION(sync)
 {
+#if !defined(PHP_WIN32)
+	sync_FreeUnixNamedMemCache();
+	sync_FreeUnixEventBell();
+#endif
+
+	UNREGISTER_INI_ENTRIES();
+
 	return SUCCESS;
 }
 /* }}} */
@@ -2325,6 +7081,8 @@ PHP_MINFO_FUNCTION(sync)
 	php_info_print_table_start();
 	php_info_print_table_header(2, "sync support", "enabled");
 	php_info_print_table_end();
+
+	DISPLAY_INI_ENTRIES();
 }
 /* }}} */
 
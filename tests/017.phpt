@@ -0,0 +1,27 @@
+--TEST--
+SyncMutex - spin limit INI setting.
+--SKIPIF--
+<?php if (!extension_loaded("sync"))  echo "skip"; ?>
+--INI--
+sync.spin_limit=0
+--FILE--
+<?php
+	var_dump(ini_get("sync.spin_limit"));
+
+	$mutex = new SyncMutex("Awesome_spin_" . PHP_INT_SIZE);
+	var_dump($mutex->lock(0));
+	var_dump($mutex->unlock());
+
+	ini_set("sync.spin_limit", "1000");
+	$mutex2 = new SyncMutex("Awesome_spin_" . PHP_INT_SIZE);
+	var_dump($mutex2->lock(0));
+	var_dump($mutex->lock(5));
+	var_dump($mutex2->unlock());
+?>
+--EXPECT--
+string(1) "0"
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
@@ -0,0 +1,36 @@
+--TEST--
+SyncMutex - sub-millisecond and hrtime() deadline timed waits.
+--SKIPIF--
+<?php if (!extension_loaded("sync") || !function_exists("hrtime"))  echo "skip"; ?>
+--FILE--
+<?php
+	$mutex = new SyncMutex("Awesome_deadline_" . PHP_INT_SIZE);
+	$mutex2 = new SyncMutex("Awesome_deadline_" . PHP_INT_SIZE);
+
+	var_dump($mutex->lock(0));
+
+	$ts = hrtime(true);
+	var_dump($mutex2->lock(0.5));
+	$diff = hrtime(true) - $ts;
+	var_dump($diff >= 500000 && $diff < 250000000);
+
+	$ts = hrtime(true);
+	var_dump($mutex2->lockUntil($ts + 2000000));
+	$diff = hrtime(true) - $ts;
+	var_dump($diff >= 2000000 && $diff < 250000000);
+
+	var_dump($mutex2->lockUntil(hrtime(true) - 1000));
+	var_dump($mutex->unlock());
+	var_dump($mutex2->lockUntil(hrtime(true) + 1000000));
+	var_dump($mutex2->unlock());
+?>
+--EXPECT--
+bool(true)
+bool(false)
+bool(true)
+bool(false)
+bool(true)
+bool(false)
+bool(true)
+bool(true)
+bool(true)
@@ -0,0 +1,39 @@
+--TEST--
+SyncReaderWriter - timed read and write locks honor the wait budget.
+--SKIPIF--
+<?php if (!extension_loaded("sync") || !function_exists("hrtime"))  echo "skip"; ?>
+--FILE--
+<?php
+	$readwrite = new SyncReaderWriter("Awesome_budget_" . PHP_INT_SIZE);
+	$readwrite2 = new SyncReaderWriter("Awesome_budget_" . PHP_INT_SIZE);
+
+	// Writer blocked by a reader.
+	var_dump($readwrite->readlock(0));
+	$ts = hrtime(true);
+	var_dump($readwrite2->writelock(50));
+	$diff = (hrtime(true) - $ts) / 1000000;
+	var_dump($diff >= 49 && $diff < 150);
+	var_dump($readwrite->readunlock());
+
+	// Reader blocked by a writer.
+	var_dump($readwrite->writelock(0));
+	$ts = hrtime(true);
+	var_dump($readwrite2->readlockUntil(hrtime(true) + 50000000));
+	$diff = (hrtime(true) - $ts) / 1000000;
+	var_dump($diff >= 49 && $diff < 150);
+	var_dump($readwrite->writeunlock());
+
+	var_dump($readwrite2->readlock(0.5));
+	var_dump($readwrite2->readunlock());
+?>
+--EXPECT--
+bool(true)
+bool(false)
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
@@ -0,0 +1,43 @@
+--TEST--
+SyncReaderWriter - multi-stage write lock stays within the wait budget under contention.
+--SKIPIF--
+<?php if (!extension_loaded("sync") || !function_exists("hrtime") || !function_exists("pcntl_fork"))  echo "skip"; ?>
+--FILE--
+<?php
+	$name = "Awesome_stages_" . PHP_INT_SIZE;
+	$readwrite = new SyncReaderWriter($name);
+	$ready = new SyncEvent($name, true);
+	$ready->reset();
+
+	$pid = pcntl_fork();
+	if (!$pid)
+	{
+		// Holds the writer mutex for 200ms while waiting for readers to drain.
+		$readwrite2 = new SyncReaderWriter($name);
+		$ready->wait(1000);
+		$readwrite2->writelock(200);
+
+		exit();
+	}
+
+	// Keep a read lock so that writers always wait for readers.
+	var_dump($readwrite->readlock(0));
+	$ready->fire();
+	usleep(20000);
+
+	// Stage one waits for the other writer to give up, stage two waits for readers.  Both share one 300ms budget.
+	$readwrite3 = new SyncReaderWriter($name);
+	$ts = hrtime(true);
+	var_dump($readwrite3->writelock(300));
+	$diff = (hrtime(true) - $ts) / 1000000;
+	var_dump($diff >= 299 && $diff < 420);
+
+	pcntl_waitpid($pid, $status);
+
+	var_dump($readwrite->readunlock());
+?>
+--EXPECT--
+bool(true)
+bool(false)
+bool(true)
+bool(true)
@@ -0,0 +1,56 @@
+--TEST--
+SyncReaderWriter - big-reader mode allocation, locking, and unlocking.
+--SKIPIF--
+<?php if (!extension_loaded("sync"))  echo "skip"; ?>
+--FILE--
+<?php
+	$readwrite = new SyncReaderWriter(null, true, 4);
+
+	var_dump($readwrite->readlock(0));
+	var_dump($readwrite->readlock(0));
+	var_dump($readwrite->readunlock());
+	var_dump($readwrite->writelock(0));
+	var_dump($readwrite->readunlock());
+	var_dump($readwrite->readunlock());
+	var_dump($readwrite->writelock(0));
+	var_dump($readwrite->writelock(0));
+	var_dump($readwrite->readlock(0));
+	var_dump($readwrite->writeunlock());
+
+	// Readers on one object block writers on another object with the same name.
+	$name = "Test_BigReader_" . getmypid();
+	$readwrite = new SyncReaderWriter($name, true, 8);
+	$readwrite2 = new SyncReaderWriter($name, true, 8);
+
+	var_dump($readwrite->readlock(0));
+	var_dump($readwrite2->readlock(0));
+	var_dump($readwrite2->writelock(0));
+	var_dump($readwrite->readunlock());
+	var_dump($readwrite2->readunlock());
+	var_dump($readwrite2->writelock(0));
+	var_dump($readwrite->readlock(0));
+	var_dump($readwrite2->writeunlock());
+	var_dump($readwrite->readlock(0));
+	var_dump($readwrite->readunlock());
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
+bool(false)
+bool(true)
+bool(false)
+bool(false)
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
+bool(true)
+bool(true)
@@ -0,0 +1,71 @@
+--TEST--
+SyncReaderWriter - upgradeable read locks, upgrade, and downgrade.
+--SKIPIF--
+<?php if (!extension_loaded("sync") || !function_exists("hrtime"))  echo "skip"; ?>
+--FILE--
+<?php
+	$readwrite = new SyncReaderWriter();
+
+	var_dump($readwrite->readlock(0, true));
+	var_dump($readwrite->readlock(0, true));
+	var_dump($readwrite->upgrade(0));
+	var_dump($readwrite->readlock(0));
+	var_dump($readwrite->downgrade());
+	var_dump($readwrite->writelock(0));
+	var_dump($readwrite->readunlock());
+	var_dump($readwrite->writelock(0));
+	var_dump($readwrite->upgrade(0));
+	var_dump($readwrite->writeunlock());
+	var_dump($readwrite->downgrade());
+
+	// Upgradeable read locks exclude writers and other upgradeable readers.
+	$name = "Test_Upgrade_" . getmypid();
+	$readwrite = new SyncReaderWriter($name);
+	$readwrite2 = new SyncReaderWriter($name);
+
+	var_dump($readwrite->readlock(0, true));
+	var_dump($readwrite2->writelock(0));
+	var_dump($readwrite2->readlock(0, true));
+	var_dump($readwrite->upgrade(0));
+	var_dump($readwrite2->readlock(0));
+	var_dump($readwrite->writeunlock());
+	var_dump($readwrite2->readlock(0));
+	var_dump($readwrite->readlockUntil(hrtime(true), true));
+	var_dump($readwrite->upgrade(0));
+	var_dump($readwrite2->readunlock());
+	var_dump($readwrite->upgradeUntil(hrtime(true) + 1000000));
+	var_dump($readwrite->writeunlock());
+
+	// Destroying the object releases an upgradeable read lock.
+	var_dump($readwrite->readlock(0, true));
+	unset($readwrite);
+	var_dump($readwrite2->writelock(0));
+	var_dump($readwrite2->writeunlock());
+?>
+--EXPECT--
+bool(true)
+bool(false)
+bool(true)
+bool(false)
+bool(true)
+bool(false)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
+bool(false)
+bool(true)
+bool(false)
+bool(false)
+bool(true)
+bool(false)
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
@@ -0,0 +1,42 @@
+--TEST--
+SyncSharedMemory - sequence lock mode.
+--SKIPIF--
+<?php if (!extension_loaded("sync"))  echo "skip"; ?>
+--FILE--
+<?php
+	$name = "SeqLock_" . getmypid();
+	$shm = new SyncSharedMemory($name, 64, true);
+
+	var_dump($shm->first());
+	var_dump($shm->size());
+	var_dump($shm->write("Everything is awesome.", 1));
+	var_dump($shm->read(1, 22));
+
+	// Sequence lock segments are separate from regular segments with the same name.
+	$shm2 = new SyncSharedMemory($name, 64);
+	var_dump($shm2->first());
+	var_dump($shm2->read(1, 22) === str_repeat("\0", 22));
+
+	$shm3 = new SyncSharedMemory($name, 64, true);
+	var_dump($shm3->first());
+	var_dump($shm3->read(1, 22));
+	var_dump($shm3->write(str_repeat("x", 100), -10));
+	var_dump($shm->read(-10));
+
+	// No writer died in the middle of a write.
+	var_dump($shm->abandoned());
+	var_dump($shm2->abandoned());
+?>
+--EXPECT--
+bool(true)
+int(64)
+int(22)
+string(22) "Everything is awesome."
+bool(true)
+bool(true)
+bool(false)
+string(22) "Everything is awesome."
+int(10)
+string(10) "xxxxxxxxxx"
+bool(false)
+bool(false)
@@ -0,0 +1,96 @@
+--TEST--
+Sync objects - contention statistics.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (substr(PHP_OS, 0, 3) == "WIN")  echo "skip getStats() is not available on Windows";
+?>
+--FILE--
+<?php
+	// Named objects share statistics across every object (and process) that opens the name.
+	$name = "Test_Stats_" . getmypid();
+	$mutex = new SyncMutex($name);
+	$mutex2 = new SyncMutex($name);
+
+	var_dump($mutex->lock());
+	var_dump($mutex2->lock(0));
+	var_dump($mutex2->lock(1));
+	var_dump($mutex->unlock());
+	var_dump($mutex2->lock(0));
+	var_dump($mutex2->unlock());
+
+	$stats = $mutex->getStats();
+	var_dump(array_keys($stats));
+	var_dump($stats["acquisitions"], $stats["contended"], $stats["timeouts"]);
+	var_dump($stats["wait_ns"] > 500000);
+	var_dump($stats["max_wait_ns"] == $stats["wait_ns"]);
+	var_dump($stats === $mutex2->getStats());
+
+	$semaphore = new SyncSemaphore(null, 1);
+	var_dump($semaphore->lock(0));
+	var_dump($semaphore->lock(0));
+	var_dump($semaphore->unlock());
+	$stats = $semaphore->getStats();
+	var_dump($stats["acquisitions"], $stats["timeouts"]);
+
+	$event = new SyncEvent();
+	var_dump($event->wait(0));
+	var_dump($event->fire());
+	var_dump($event->wait(0));
+	$stats = $event->getStats();
+	var_dump($stats["acquisitions"], $stats["timeouts"]);
+
+	$readwrite = new SyncReaderWriter();
+	var_dump($readwrite->readlock(0));
+	var_dump($readwrite->writelock(0));
+	var_dump($readwrite->readunlock());
+	var_dump($readwrite->writelock(0));
+	var_dump($readwrite->writeunlock());
+	$stats = $readwrite->getStats();
+	var_dump($stats["acquisitions"], $stats["contended"], $stats["timeouts"]);
+?>
+--EXPECT--
+bool(true)
+bool(false)
+bool(false)
+bool(true)
+bool(true)
+bool(true)
+array(6) {
+  [0]=>
+  string(12) "acquisitions"
+  [1]=>
+  string(9) "contended"
+  [2]=>
+  string(8) "timeouts"
+  [3]=>
+  string(7) "wait_ns"
+  [4]=>
+  string(11) "max_wait_ns"
+  [5]=>
+  string(11) "max_hold_ns"
+}
+int(2)
+int(0)
+int(2)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
+int(1)
+int(1)
+bool(false)
+bool(true)
+bool(true)
+int(1)
+int(1)
+bool(true)
+bool(false)
+bool(true)
+bool(true)
+bool(true)
+int(2)
+int(0)
+int(1)
@@ -0,0 +1,103 @@
+--TEST--
+Sync objects - wait and hold time histograms.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (substr(PHP_OS, 0, 3) == "WIN")  echo "skip getPercentiles() is not available on Windows";
+?>
+--FILE--
+<?php
+	$mutex = new SyncMutex();
+	var_dump($mutex->getPercentiles());
+
+	$mutex = new SyncMutex(null, true);
+	var_dump($mutex->lock());
+	usleep(20000);
+	var_dump($mutex->unlock());
+
+	$result = $mutex->getPercentiles();
+	var_dump(array_keys($result));
+	var_dump($result["wait_count"], $result["hold_count"]);
+	var_dump($result["wait_p50"] == 0);
+	var_dump($result["hold_p50"] >= 20000000 && $result["hold_p50"] == $result["hold_max"]);
+
+	// Named histograms are shared.  Objects without histograms still share the mutex.
+	$name = "Test_Histogram_" . getmypid();
+	$mutex = new SyncMutex($name, true);
+	$mutex2 = new SyncMutex($name, true);
+	$mutex3 = new SyncMutex($name);
+	var_dump($mutex->lock());
+	var_dump($mutex3->lock(0));
+	var_dump($mutex2->lock(0));
+	var_dump($mutex->unlock());
+	$result = $mutex2->getPercentiles();
+	var_dump($result["wait_count"], $result["hold_count"]);
+
+	$semaphore = new SyncSemaphore(null, 2, true, true);
+	var_dump($semaphore->lock());
+	var_dump($semaphore->unlock());
+	$result = $semaphore->getPercentiles();
+	var_dump($result["wait_count"], $result["hold_count"]);
+
+	$readwrite = new SyncReaderWriter(null, true, 0, true);
+	var_dump($readwrite->readlock());
+	var_dump($readwrite->readlock());
+	var_dump($readwrite->readunlock());
+	var_dump($readwrite->readunlock());
+	var_dump($readwrite->writelock());
+	var_dump($readwrite->writeunlock());
+	$result = $readwrite->getPercentiles();
+	var_dump($result["wait_count"], $result["hold_count"]);
+?>
+--EXPECT--
+bool(false)
+bool(true)
+bool(true)
+array(12) {
+  [0]=>
+  string(10) "wait_count"
+  [1]=>
+  string(8) "wait_p50"
+  [2]=>
+  string(8) "wait_p90"
+  [3]=>
+  string(8) "wait_p99"
+  [4]=>
+  string(10) "wait_p99.9"
+  [5]=>
+  string(8) "wait_max"
+  [6]=>
+  string(10) "hold_count"
+  [7]=>
+  string(8) "hold_p50"
+  [8]=>
+  string(8) "hold_p90"
+  [9]=>
+  string(8) "hold_p99"
+  [10]=>
+  string(10) "hold_p99.9"
+  [11]=>
+  string(8) "hold_max"
+}
+int(1)
+int(1)
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+bool(false)
+bool(true)
+int(2)
+int(1)
+bool(true)
+bool(true)
+int(1)
+int(1)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+int(3)
+int(2)
@@ -0,0 +1,67 @@
+--TEST--
+Sync objects - named memory cache INI settings.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (substr(PHP_OS, 0, 3) == "WIN")  echo "skip The named memory cache is not available on Windows";
+?>
+--INI--
+sync.cache_size=2
+--FILE--
+<?php
+	var_dump(ini_get("sync.cache_size"));
+	var_dump(ini_set("sync.cache_size", "10"));
+
+	// Cached objects keep their state after the last object using the name goes away.
+	$name = "Test_Cache_" . getmypid();
+	$event = new SyncEvent($name, true);
+	var_dump($event->fire());
+	unset($event);
+
+	$event = new SyncEvent($name, true);
+	var_dump($event->wait(0));
+	unset($event);
+
+	// Objects sharing cached memory still exclude each other.
+	$mutex = new SyncMutex($name);
+	$mutex2 = new SyncMutex($name);
+	var_dump($mutex->lock(0));
+	var_dump($mutex2->lock(0));
+	var_dump($mutex->unlock());
+	var_dump($mutex2->lock(0));
+	var_dump($mutex2->unlock());
+
+	// More names than the cache holds.
+	$objs = array();
+	for ($x = 0; $x < 4; $x++)
+	{
+		$objs[$x] = new SyncSemaphore($name . "_" . $x, 1);
+		var_dump($objs[$x]->lock(0));
+	}
+	for ($x = 0; $x < 4; $x++)  var_dump($objs[$x]->unlock());
+	unset($objs);
+
+	$semaphore = new SyncSemaphore($name . "_0", 1);
+	var_dump($semaphore->lock(0));
+	var_dump($semaphore->unlock());
+?>
+--EXPECT--
+string(1) "2"
+bool(false)
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
@@ -0,0 +1,60 @@
+--TEST--
+SyncStripedMutex - named striped mutex allocation, key mapping, locking, and unlocking.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (substr(PHP_OS, 0, 3) == "WIN")  echo "skip Windows mutexes can be locked again by the thread that owns them";
+?>
+--FILE--
+<?php
+	$name = "Test_StripedMutex_" . getmypid();
+	$mutex = new SyncStripedMutex($name, 16);
+	$mutex2 = new SyncStripedMutex($name, 16);
+
+	// Integer keys map to the same stripe as their decimal strings.
+	$stripe = $mutex->getStripe(42);
+	var_dump($stripe >= 0 && $stripe < 16);
+	var_dump($stripe === $mutex->getStripe("42"));
+	var_dump($stripe === $mutex2->getStripe(42));
+
+	// Find a key on another stripe.
+	for ($x = 0; $mutex->getStripe("key" . $x) === $stripe; $x++);
+	$key = "key" . $x;
+
+	var_dump($mutex->lock(42, 0));
+	var_dump($mutex->lock("42", 0));
+	var_dump($mutex2->lock(42, 0));
+	var_dump($mutex2->lock($key, 0));
+	var_dump($mutex->unlock(42));
+	var_dump($mutex2->lock(42, 0));
+	var_dump($mutex->unlock(42));
+	var_dump($mutex->unlock(42));
+	var_dump($mutex2->lock(42, 0));
+	var_dump($mutex2->unlock(42));
+	var_dump($mutex2->unlock($key));
+
+	try
+	{
+		$mutex3 = new SyncStripedMutex($name, 0);
+	}
+	catch (Exception $e)
+	{
+		echo $e->getMessage() . "\n";
+	}
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
+bool(false)
+bool(true)
+bool(true)
+bool(true)
+An invalid number of stripes was passed
@@ -0,0 +1,71 @@
+--TEST--
+Sync objects - unnamed objects shared with forked children.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (substr(PHP_OS, 0, 3) == "WIN")  echo "skip Unnamed objects can't be shared across processes on Windows";
+	else if (!function_exists("pcntl_fork"))  echo "skip The pcntl extension is required";
+?>
+--INI--
+sync.shared_unnamed=1
+--FILE--
+<?php
+	$mutex = new SyncMutex();
+	$semaphore = new SyncSemaphore(null, 2);
+	$event = new SyncEvent(null, true);
+	$mem = new SyncSharedMemory(null, 16);
+	var_dump($mem->first());
+	var_dump($mem->size());
+
+	var_dump($mutex->lock(0));
+	var_dump($semaphore->lock(0));
+
+	// The child doesn't own the parent's locks and has to wait for them like any other process.
+	$pid = pcntl_fork();
+	if (!$pid)
+	{
+		$result = ($mutex->unlock() ? "1" : "0");
+		$result .= ($mutex->lock(0) ? "1" : "0");
+		$result .= ($semaphore->lock(0) ? "1" : "0");
+		$result .= ($semaphore->lock(0) ? "1" : "0");
+		$result .= ($semaphore->unlock() ? "1" : "0");
+		$mem->write($result);
+		$event->fire();
+
+		exit(0);
+	}
+
+	var_dump($event->wait(5000));
+	pcntl_waitpid($pid, $status);
+	var_dump($mem->read(0, 5));
+
+	var_dump($mutex->unlock());
+	var_dump($semaphore->unlock());
+
+	$pid = pcntl_fork();
+	if (!$pid)
+	{
+		$result = ($mutex->lock(0) ? "1" : "0");
+		$result .= ($mutex->unlock() ? "1" : "0");
+		$mem->write($result, 8);
+
+		exit(0);
+	}
+
+	pcntl_waitpid($pid, $status);
+	var_dump($mem->read(8, 2));
+	var_dump($mutex->lock(0));
+	var_dump($mutex->unlock());
+?>
+--EXPECT--
+bool(true)
+int(16)
+bool(true)
+bool(true)
+bool(true)
+string(5) "00101"
+bool(true)
+bool(true)
+string(2) "11"
+bool(true)
+bool(true)
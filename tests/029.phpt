@@ -0,0 +1,65 @@
+--TEST--
+Sync objects - take over locks held by a process that died.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (substr(PHP_OS, 0, 3) == "WIN")  echo "skip Requires fork";
+	else if (!function_exists("pcntl_fork") || !function_exists("posix_kill"))  echo "skip The pcntl and posix extensions are required";
+?>
+--INI--
+sync.shared_unnamed=1
+--FILE--
+<?php
+	$mutex = new SyncMutex();
+	$striped = new SyncStripedMutex(null, 4);
+	$readwrite = new SyncReaderWriter();
+
+	// The child dies holding every lock without unlocking anything.
+	$pid = pcntl_fork();
+	if (!$pid)
+	{
+		$mutex->lock();
+		$striped->lock("key");
+		$readwrite->writelock();
+
+		posix_kill(getmypid(), SIGKILL);
+	}
+
+	pcntl_waitpid($pid, $status);
+
+	var_dump($mutex->lock(0));
+	var_dump($mutex->lock(5000));
+	var_dump($mutex->abandoned());
+	var_dump($mutex->unlock());
+	var_dump($mutex->lock(0));
+	var_dump($mutex->abandoned());
+	var_dump($mutex->unlock());
+
+	var_dump($striped->lock("key", 5000));
+	var_dump($striped->abandoned());
+	var_dump($striped->unlock("key"));
+
+	var_dump($readwrite->writelock(5000));
+	var_dump($readwrite->abandoned());
+	var_dump($readwrite->writeunlock());
+	var_dump($readwrite->readlock(0));
+	var_dump($readwrite->abandoned());
+	var_dump($readwrite->readunlock());
+?>
+--EXPECT--
+bool(false)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
@@ -0,0 +1,73 @@
+--TEST--
+SyncSemaphore - reclaim units held by processes that died.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (substr(PHP_OS, 0, 3) == "WIN")  echo "skip Holder tables aren't supported on Windows";
+	else if (!function_exists("pcntl_fork") || !function_exists("posix_kill"))  echo "skip The pcntl and posix extensions are required";
+?>
+--INI--
+sync.shared_unnamed=1
+--FILE--
+<?php
+	$semaphore = new SyncSemaphore(null, 3, true, false, true);
+	var_dump($semaphore->lock(0));
+
+	// The child dies holding two units.
+	$pid = pcntl_fork();
+	if (!$pid)
+	{
+		$semaphore->lock(0);
+		$semaphore->lock(0);
+
+		posix_kill(getmypid(), SIGKILL);
+	}
+
+	pcntl_waitpid($pid, $status);
+
+	var_dump($semaphore->lock(0));
+	var_dump($semaphore->lock(5000));
+	var_dump($semaphore->lock(0));
+	var_dump($semaphore->lock(0));
+	var_dump($semaphore->unlock());
+	var_dump($semaphore->unlock());
+	var_dump($semaphore->unlock());
+
+	$pid = pcntl_fork();
+	if (!$pid)
+	{
+		$semaphore->lock(0);
+
+		posix_kill(getmypid(), SIGKILL);
+	}
+
+	pcntl_waitpid($pid, $status);
+
+	var_dump($semaphore->reclaim());
+	var_dump($semaphore->reclaim());
+
+	$semaphore2 = new SyncSemaphore(null, 3);
+	var_dump($semaphore2->reclaim());
+
+	try
+	{
+		$semaphore3 = new SyncSemaphore(null, 0, true, false, true);
+	}
+	catch (Exception $e)
+	{
+		echo $e->getMessage() . "\n";
+	}
+?>
+--EXPECT--
+bool(true)
+bool(false)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
+bool(true)
+bool(true)
+int(1)
+int(0)
+bool(false)
+Semaphore holder tables support 1 to 65536 units
@@ -0,0 +1,63 @@
+--TEST--
+SyncSemaphore - lock and unlock several units at once.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync") || !function_exists("hrtime"))  echo "skip";
+?>
+--FILE--
+<?php
+	$semaphore = new SyncSemaphore(null, 4);
+
+	var_dump($semaphore->lock(0, 3));
+	var_dump($semaphore->lock(0, 2));
+	var_dump($semaphore->lock(0, 1));
+	var_dump($semaphore->lock(0));
+
+	$prevcount = -1;
+	var_dump($semaphore->unlock($prevcount, 4));
+	var_dump($prevcount);
+
+	// More units than the semaphore has never succeed.
+	var_dump($semaphore->lock(0, 5));
+	var_dump($semaphore->lock(10, 4));
+	var_dump($semaphore->unlock($prevcount, 2));
+	var_dump($prevcount);
+	var_dump($semaphore->lockUntil(hrtime(true) + 10000000, 3));
+	var_dump($semaphore->lockUntil(hrtime(true) + 10000000, 2));
+	var_dump($semaphore->unlock($prevcount, 3));
+
+	try
+	{
+		$semaphore->lock(0, 0);
+	}
+	catch (Exception $e)
+	{
+		echo $e->getMessage() . "\n";
+	}
+
+	// An object releases all of the units it still holds at once.
+	$semaphore2 = new SyncSemaphore("031_Sem" . getmypid(), 3);
+	$semaphore3 = new SyncSemaphore("031_Sem" . getmypid(), 3);
+	var_dump($semaphore2->lock(0, 3));
+	var_dump($semaphore3->lock(0));
+	unset($semaphore2);
+	var_dump($semaphore3->lock(0, 3));
+?>
+--EXPECT--
+bool(true)
+bool(false)
+bool(true)
+bool(false)
+bool(true)
+int(0)
+bool(false)
+bool(true)
+bool(true)
+int(0)
+bool(false)
+bool(true)
+bool(true)
+An invalid number of units was passed
+bool(true)
+bool(false)
+bool(true)
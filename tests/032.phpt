@@ -0,0 +1,81 @@
+--TEST--
+SyncSemaphore - change the capacity at runtime.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (substr(PHP_OS, 0, 3) == "WIN")  echo "skip Capacity can't be changed on Windows";
+?>
+--FILE--
+<?php
+	$semaphore = new SyncSemaphore(null, 4);
+	$semaphore2 = new SyncSemaphore(null, 8);
+	var_dump($semaphore->getCapacity());
+	var_dump($semaphore->getValue());
+
+	var_dump($semaphore->lock(0, 3));
+	var_dump($semaphore->getValue());
+
+	// Units in use are taken away as they are unlocked.
+	var_dump($semaphore->setCapacity(2));
+	var_dump($semaphore->getCapacity());
+	var_dump($semaphore->getValue());
+	var_dump($semaphore->unlock($prevcount, 1));
+	var_dump($semaphore->getValue());
+	var_dump($semaphore->unlock($prevcount, 2));
+	var_dump($semaphore->getValue());
+
+	var_dump($semaphore->setCapacity(6));
+	var_dump($semaphore->getValue());
+	var_dump($semaphore->lock(0, 6));
+	var_dump($semaphore->unlock($prevcount, 6));
+
+	// Holds over the target cut the capacity.
+	var_dump($semaphore2->setAdaptive(1, 2, 10));
+	var_dump($semaphore2->lock(0));
+	usleep(20000);
+	var_dump($semaphore2->unlock());
+	var_dump($semaphore2->getCapacity());
+
+	// Holds under the target grow it back.
+	var_dump($semaphore2->setAdaptive(1000, 2, 10));
+	for ($x = 0; $x < 7; $x++)
+	{
+		$semaphore2->lock(0);
+		$semaphore2->unlock();
+	}
+	var_dump($semaphore2->getCapacity());
+	var_dump($semaphore2->setAdaptive(0));
+
+	try
+	{
+		$semaphore->setCapacity(0);
+	}
+	catch (Exception $e)
+	{
+		echo $e->getMessage() . "\n";
+	}
+?>
+--EXPECT--
+int(4)
+int(4)
+bool(true)
+int(1)
+bool(true)
+int(2)
+int(0)
+bool(true)
+int(0)
+bool(true)
+int(2)
+bool(true)
+int(6)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+int(7)
+bool(true)
+int(8)
+bool(true)
+An invalid capacity was passed
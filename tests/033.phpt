@@ -0,0 +1,103 @@
+--TEST--
+Sync objects - fair mode hands locks to waiters in the order they arrived.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (substr(PHP_OS, 0, 3) == "WIN")  echo "skip Fair mode isn't supported on Windows";
+	else if (!function_exists("pcntl_fork"))  echo "skip The pcntl extension is required";
+?>
+--INI--
+sync.shared_unnamed=1
+--FILE--
+<?php
+	// Records the order in which children get in.  Only called while holding the lock.
+	function AppendOrder($mem, $id)
+	{
+		$pos = ord($mem->read(0, 1));
+		$mem->write($id, 1 + $pos);
+		$mem->write(chr($pos + 1), 0);
+	}
+
+	$mutex = new SyncMutex(null, false, true);
+	$mem = new SyncSharedMemory(null, 16);
+	var_dump($mutex->lock(0));
+
+	$pids = array();
+	foreach (array("1", "2") as $id)
+	{
+		$pid = pcntl_fork();
+		if (!$pid)
+		{
+			if ($mutex->lock(5000))
+			{
+				AppendOrder($mem, $id);
+				usleep(100000);
+				$mutex->unlock();
+			}
+
+			exit(0);
+		}
+
+		$pids[] = $pid;
+		usleep(200000);
+	}
+
+	// The mutex goes straight to the first child.  It can't be locked again in between.
+	var_dump($mutex->unlock());
+	var_dump($mutex->lock(0));
+	var_dump($mutex->lock(5000));
+	var_dump($mem->read(1, 2));
+	var_dump($mutex->unlock());
+
+	foreach ($pids as $pid)  pcntl_waitpid($pid, $status);
+
+	$semaphore = new SyncSemaphore(null, 2, true, false, false, true);
+	$mem2 = new SyncSharedMemory(null, 16);
+	var_dump($semaphore->lock(0, 2));
+
+	// The first child wants both units and holds up the second child, which only wants one.
+	$pids = array();
+	foreach (array("A" => 2, "B" => 1) as $id => $count)
+	{
+		$pid = pcntl_fork();
+		if (!$pid)
+		{
+			if ($semaphore->lock(5000, $count))
+			{
+				AppendOrder($mem2, $id);
+				usleep(100000);
+				$semaphore->unlock($prevcount, $count);
+			}
+
+			exit(0);
+		}
+
+		$pids[] = $pid;
+		usleep(200000);
+	}
+
+	var_dump($semaphore->unlock());
+	usleep(100000);
+	var_dump($semaphore->getValue());
+	var_dump($semaphore->lock(0));
+	var_dump($semaphore->unlock());
+
+	foreach ($pids as $pid)  pcntl_waitpid($pid, $status);
+
+	var_dump($mem2->read(1, 2));
+	var_dump($semaphore->getValue());
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(false)
+bool(true)
+string(2) "12"
+bool(true)
+bool(true)
+bool(true)
+int(1)
+bool(false)
+bool(true)
+string(2) "AB"
+int(2)
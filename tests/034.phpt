@@ -0,0 +1,67 @@
+--TEST--
+Sync objects - priority inheritance mutexes lock and unlock like other mutexes.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (!function_exists("pcntl_fork"))  echo "skip The pcntl extension is required";
+?>
+--FILE--
+<?php
+	$name = "Test_" . getmypid() . "_PI";
+	$mutex = new SyncMutex($name, false, false, true);
+	var_dump($mutex->lock(0));
+	var_dump($mutex->lock(0));
+	var_dump($mutex->unlock());
+
+	// The parent still holds the mutex, so the child's timed lock runs out.
+	$pid = pcntl_fork();
+	if (!$pid)
+	{
+		$mutex2 = new SyncMutex($name, false, false, true);
+		$start = microtime(true);
+		$result = $mutex2->lock(200);
+		$diff = microtime(true) - $start;
+		echo ($result === false && $diff > 0.15 ? "Timed out\n" : "Unexpected result\n");
+
+		exit(0);
+	}
+
+	pcntl_waitpid($pid, $status);
+
+	var_dump($mutex->unlock());
+	var_dump($mutex->unlock());
+
+	$pid = pcntl_fork();
+	if (!$pid)
+	{
+		$mutex2 = new SyncMutex($name, false, false, true);
+		var_dump($mutex2->lock(1000));
+		var_dump($mutex2->abandoned());
+		var_dump($mutex2->unlock());
+
+		exit(0);
+	}
+
+	pcntl_waitpid($pid, $status);
+
+	try
+	{
+		$mutex3 = new SyncMutex(null, false, true, true);
+		echo "No exception\n";
+	}
+	catch (Exception $e)
+	{
+		echo $e->getMessage() . "\n";
+	}
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+Timed out
+bool(true)
+bool(false)
+bool(true)
+bool(false)
+bool(true)
+Mutex can't be both fair and priority inheriting
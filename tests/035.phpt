@@ -0,0 +1,83 @@
+--TEST--
+Sync objects - wait for any or all of several events.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (!function_exists("pcntl_fork"))  echo "skip The pcntl extension is required";
+?>
+--FILE--
+<?php
+	$prefix = "Test_" . getmypid() . "_";
+	$events = array(
+		"reload" => new SyncEvent($prefix . "reload"),
+		"shutdown" => new SyncEvent($prefix . "shutdown"),
+		"job" => new SyncEvent($prefix . "job", true)
+	);
+
+	var_dump(SyncEvent::waitAny($events, 0));
+	var_dump(SyncEvent::waitAny(array(), 0));
+
+	$pid = pcntl_fork();
+	if (!$pid)
+	{
+		$event = new SyncEvent($prefix . "shutdown");
+		usleep(100000);
+		$event->fire();
+
+		exit(0);
+	}
+
+	var_dump(SyncEvent::waitAny($events, 5000));
+	pcntl_waitpid($pid, $status);
+
+	// The auto event was reset.  The manual event stays fired.
+	var_dump($events["shutdown"]->wait(0));
+	$events["job"]->fire();
+	var_dump(SyncEvent::waitAny(array(5 => $events["reload"], 7 => $events["job"]), 0));
+	var_dump(SyncEvent::waitAny($events, 0));
+	$events["job"]->reset();
+
+	$pid = pcntl_fork();
+	if (!$pid)
+	{
+		$event = new SyncEvent($prefix . "reload");
+		$event2 = new SyncEvent($prefix . "shutdown");
+		usleep(50000);
+		$event->fire();
+		usleep(50000);
+		$event2->fire();
+
+		exit(0);
+	}
+
+	var_dump(SyncEvent::waitAll(array($events["reload"], $events["shutdown"]), 5000));
+	pcntl_waitpid($pid, $status);
+
+	// Taken auto events are fired again when waiting for all of them times out.
+	$events["reload"]->fire();
+	var_dump(SyncEvent::waitAll(array($events["reload"], $events["shutdown"]), 100));
+	var_dump($events["reload"]->wait(0));
+	var_dump($events["shutdown"]->wait(0));
+
+	try
+	{
+		SyncEvent::waitAny(array($events["reload"], new SyncMutex()), 0);
+		echo "No exception\n";
+	}
+	catch (Exception $e)
+	{
+		echo $e->getMessage() . "\n";
+	}
+?>
+--EXPECT--
+bool(false)
+bool(false)
+string(8) "shutdown"
+bool(false)
+int(7)
+string(3) "job"
+bool(true)
+bool(false)
+bool(true)
+bool(false)
+Events must be an array of SyncEvent objects
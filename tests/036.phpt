@@ -0,0 +1,43 @@
+--TEST--
+SyncSemaphore - back to back unlocks wake every waiting process.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (!function_exists("pcntl_fork"))  echo "skip The pcntl extension is required";
+?>
+--INI--
+sync.shared_unnamed=1
+--FILE--
+<?php
+	$failed = 0;
+	for ($round = 0; $round < 20; $round++)
+	{
+		$semaphore = new SyncSemaphore(null, 2, false);
+		$semaphore->lock(0);
+		$semaphore->lock(0);
+
+		$pids = array();
+		for ($x = 0; $x < 2; $x++)
+		{
+			$pid = pcntl_fork();
+			if (!$pid)  exit($semaphore->lock(3000) ? 0 : 1);
+
+			$pids[] = $pid;
+		}
+
+		// Let both children go to sleep before releasing both units without a pause.
+		usleep(20000);
+		$semaphore->unlock();
+		$semaphore->unlock();
+
+		foreach ($pids as $pid)
+		{
+			pcntl_waitpid($pid, $status);
+			if (pcntl_wexitstatus($status) != 0)  $failed++;
+		}
+	}
+
+	var_dump($failed);
+?>
+--EXPECT--
+int(0)
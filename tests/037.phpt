@@ -0,0 +1,58 @@
+--TEST--
+SyncSemaphore - unlocking several units at once wakes every waiting process they satisfy.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (!function_exists("pcntl_fork"))  echo "skip The pcntl extension is required";
+?>
+--INI--
+sync.shared_unnamed=1
+--FILE--
+<?php
+	// Each child waits for the given number of units.  The parent releases all of them with one unlock() and then with back to back unlock() calls.
+	function RunRound($counts, $batch)
+	{
+		$total = array_sum($counts);
+		$semaphore = new SyncSemaphore(null, $total, false);
+		$semaphore->lock(0, $total);
+
+		$pids = array();
+		foreach ($counts as $count)
+		{
+			$pid = pcntl_fork();
+			if (!$pid)  exit($semaphore->lock(3000, $count) ? 0 : 1);
+
+			$pids[] = $pid;
+		}
+
+		usleep(20000);
+		if ($batch)  $semaphore->unlock($prevcount, $total);
+		else
+		{
+			$semaphore->unlock($prevcount, 2);
+			$semaphore->unlock($prevcount, $total - 2);
+		}
+
+		$failed = 0;
+		foreach ($pids as $pid)
+		{
+			pcntl_waitpid($pid, $status);
+			if (pcntl_wexitstatus($status) != 0)  $failed++;
+		}
+
+		return $failed;
+	}
+
+	$failed = 0;
+	for ($round = 0; $round < 10; $round++)
+	{
+		$failed += RunRound(array(1, 1, 1), true);
+		$failed += RunRound(array(2, 1, 1), true);
+		$failed += RunRound(array(1, 1, 1), false);
+		$failed += RunRound(array(2, 1, 1), false);
+	}
+
+	var_dump($failed);
+?>
+--EXPECT--
+int(0)
@@ -0,0 +1,48 @@
+--TEST--
+Sync objects - a named fair mode object can't be opened without fair mode.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (substr(PHP_OS, 0, 3) == "WIN")  echo "skip Fair mode is ignored on Windows";
+?>
+--FILE--
+<?php
+	$name = "Test_" . getmypid() . "_Fair";
+	$mutex = new SyncMutex($name, false, true);
+	$mutex2 = new SyncMutex($name, false, true);
+	var_dump($mutex->lock(0));
+	var_dump($mutex2->lock(0));
+
+	try
+	{
+		$mutex3 = new SyncMutex($name);
+		echo "No exception\n";
+	}
+	catch (Exception $e)
+	{
+		echo $e->getMessage() . "\n";
+	}
+
+	var_dump($mutex->unlock());
+
+	$semaphore = new SyncSemaphore($name, 2, true, false, false, false);
+
+	try
+	{
+		$semaphore2 = new SyncSemaphore($name, 2, true, false, false, true);
+		echo "No exception\n";
+	}
+	catch (Exception $e)
+	{
+		echo $e->getMessage() . "\n";
+	}
+
+	var_dump($semaphore->lock(0));
+?>
+--EXPECT--
+bool(true)
+bool(false)
+Mutex already exists with different options
+bool(true)
+Semaphore already exists with different options
+bool(true)
@@ -0,0 +1,40 @@
+--TEST--
+SyncSemaphore - a named semaphore with a holder table can't be opened with a different table.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (substr(PHP_OS, 0, 3) == "WIN")  echo "skip Holder tables are ignored on Windows";
+?>
+--FILE--
+<?php
+	$name = "Test_" . getmypid() . "_Holders";
+	$semaphore = new SyncSemaphore($name, 3, true, false, true);
+	$semaphore2 = new SyncSemaphore($name, 3, true, false, true);
+	var_dump($semaphore->lock(0, 2));
+	var_dump($semaphore2->lock(0, 2));
+	var_dump($semaphore2->lock(0));
+
+	foreach (array(array(3, false), array(4, true)) as $args)
+	{
+		try
+		{
+			$semaphore3 = new SyncSemaphore($name, $args[0], true, false, $args[1]);
+			echo "No exception\n";
+		}
+		catch (Exception $e)
+		{
+			echo $e->getMessage() . "\n";
+		}
+	}
+
+	var_dump($semaphore->unlock($prevcount, 2));
+	var_dump($prevcount);
+?>
+--EXPECT--
+bool(true)
+bool(false)
+bool(true)
+Semaphore already exists with different options
+Semaphore already exists with different options
+bool(true)
+int(0)
@@ -0,0 +1,41 @@
+--TEST--
+SyncReaderWriter - a named big-reader object can't be opened with a different number of reader slots.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (PHP_OS != "Linux")  echo "skip Big-reader mode needs Linux";
+?>
+--FILE--
+<?php
+	$name = "Test_" . getmypid() . "_Slots";
+	$readwrite = new SyncReaderWriter($name, true, 4);
+	$readwrite2 = new SyncReaderWriter($name, true, 4);
+
+	// A reader through one object keeps out a writer through the other.
+	var_dump($readwrite2->readlock(0));
+	var_dump($readwrite->writelock(0));
+	var_dump($readwrite2->readunlock());
+	var_dump($readwrite->writelock(0));
+	var_dump($readwrite->writeunlock());
+
+	foreach (array(0, 8) as $slots)
+	{
+		try
+		{
+			$readwrite3 = new SyncReaderWriter($name, true, $slots);
+			echo "No exception\n";
+		}
+		catch (Exception $e)
+		{
+			echo $e->getMessage() . "\n";
+		}
+	}
+?>
+--EXPECT--
+bool(true)
+bool(false)
+bool(true)
+bool(true)
+bool(true)
+Reader-Writer object already exists with different options
+Reader-Writer object already exists with different options
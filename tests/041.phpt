@@ -0,0 +1,43 @@
+--TEST--
+SyncMutex - a named priority inheritance mutex can't be opened without priority inheritance.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (PHP_OS != "Linux")  echo "skip Priority inheritance may be unavailable";
+?>
+--FILE--
+<?php
+	$name = "Test_" . getmypid() . "_PIOptions";
+	$mutex = new SyncMutex($name, false, false, true);
+	var_dump($mutex->lock(0));
+
+	try
+	{
+		$mutex2 = new SyncMutex($name);
+		echo "No exception\n";
+	}
+	catch (Exception $e)
+	{
+		echo $e->getMessage() . "\n";
+	}
+
+	var_dump($mutex->unlock());
+
+	$name2 = "Test_" . getmypid() . "_PIOptions2";
+	$mutex3 = new SyncMutex($name2);
+
+	try
+	{
+		$mutex4 = new SyncMutex($name2, false, false, true);
+		echo "No exception\n";
+	}
+	catch (Exception $e)
+	{
+		echo $e->getMessage() . "\n";
+	}
+?>
+--EXPECT--
+bool(true)
+Mutex already exists with different options
+bool(true)
+Mutex already exists with different options
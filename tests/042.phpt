@@ -0,0 +1,36 @@
+--TEST--
+SyncStripedMutex - a named striped mutex can't be opened with a different number of stripes.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (substr(PHP_OS, 0, 3) == "WIN")  echo "skip Stripes are separate Windows mutexes";
+?>
+--FILE--
+<?php
+	$name = "Test_" . getmypid() . "_Stripes";
+	$mutex = new SyncStripedMutex($name, 16);
+	$mutex2 = new SyncStripedMutex($name, 16);
+	var_dump($mutex->lock("key", 0));
+	var_dump($mutex2->lock("key", 0));
+
+	try
+	{
+		$mutex3 = new SyncStripedMutex($name, 64);
+		echo "No exception\n";
+	}
+	catch (Exception $e)
+	{
+		echo $e->getMessage() . "\n";
+	}
+
+	var_dump($mutex->unlock("key"));
+	var_dump($mutex2->lock("key", 0));
+	var_dump($mutex2->unlock("key"));
+?>
+--EXPECT--
+bool(true)
+bool(false)
+Striped mutex already exists with different options
+bool(true)
+bool(true)
+bool(true)
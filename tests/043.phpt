@@ -0,0 +1,49 @@
+--TEST--
+Sync objects - a NAN wait is infinite, the same as a negative wait.
+--SKIPIF--
+<?php
+	if (!extension_loaded("sync"))  echo "skip";
+	else if (!function_exists("pcntl_fork"))  echo "skip The pcntl extension is required";
+?>
+--FILE--
+<?php
+	$name = "Test_" . getmypid() . "_NAN";
+	$mutex = new SyncMutex($name);
+	var_dump($mutex->lock(NAN));
+	var_dump($mutex->unlock());
+
+	// The child holds the mutex for a while.  A NAN wait has to outlast it instead of timing out right away.
+	$event = new SyncEvent($name, true);
+	$pid = pcntl_fork();
+	if (!$pid)
+	{
+		$mutex2 = new SyncMutex($name);
+		$mutex2->lock();
+		$event->fire();
+		usleep(300000);
+		$mutex2->unlock();
+
+		exit(0);
+	}
+
+	var_dump($event->wait(5000));
+	$start = microtime(true);
+	var_dump($mutex->lock(NAN));
+	var_dump(microtime(true) - $start > 0.1);
+	var_dump($mutex->unlock());
+
+	pcntl_waitpid($pid, $status);
+
+	$semaphore = new SyncSemaphore($name, 1);
+	var_dump($semaphore->lock(NAN));
+	var_dump($semaphore->unlock());
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)